@@ -0,0 +1,164 @@
+/* bfloat16 version of MMult_4x4_vecreg_subblock_cache.c.
+   A and B hold bf16 values (the upper 16 bits of a float, stored as
+   unsigned short) and C is float: the products are accumulated in fp32.
+
+   Pairs of consecutive values of k are packed next to each other, which
+   is the operand layout of the AVX512-BF16 vdpbf16ps instruction (dot
+   products of 2 bf16 pairs into each fp32 lane). Without it the same
+   layout is widened to fp32 in registers, which for bf16 is just a shift
+   or a mask of every 32-bit lane, and multiplied with AVX. */
+
+#include <stdlib.h>
+#include <immintrin.h>
+
+/* Create macros so that the matrices are stored in column-major order */
+
+#define A(i,j) a[ (j)*lda + (i) ]
+#define B(i,j) b[ (j)*ldb + (i) ]
+#define C(i,j) c[ (j)*ldc + (i) ]
+
+/* Block sizes, kc is a multiple of 2 */
+#define mc 256
+#define kc 256
+
+#define min( i, j ) ( (i)<(j) ? (i): (j) )
+
+typedef unsigned short bf16_t;
+
+/* Routine for computing C = A * B + C */
+
+void AddDot8x4_b( int, bf16_t *, bf16_t *, float *, int, int, int );
+void PackMatrixA_b( int, int, bf16_t *, int, bf16_t * );
+void PackMatrixB_b( int, int, bf16_t *, int, bf16_t * );
+void InnerKernel_b( int, int, int, bf16_t *, int, bf16_t *, int, float *, int,
+                    bf16_t *, bf16_t *, int );
+
+void MY_BMMult( int m, int n, int k, bf16_t *a, int lda,
+                                     bf16_t *b, int ldb,
+                                     float *c, int ldc )
+{
+  int i, p, pb, ib;
+  bf16_t
+    *packedA, *packedB;
+
+  if ( posix_memalign( (void **) &packedA, 32, mc * kc * sizeof( bf16_t ) ) ||
+       posix_memalign( (void **) &packedB, 32, kc * ( n+3 ) * sizeof( bf16_t ) ) )
+    abort();
+
+  for ( p=0; p<k; p+=kc ){
+    pb = min( k-p, kc );
+    for ( i=0; i<m; i+=mc ){
+      ib = min( m-i, mc );
+      InnerKernel_b( ib, n, pb, &A( i,p ), lda, &B( p,0 ), ldb, &C( i,0 ), ldc,
+                     packedA, packedB, i==0 );
+    }
+  }
+
+  free( packedA );
+  free( packedB );
+}
+
+void InnerKernel_b( int m, int n, int k, bf16_t *a, int lda,
+                                         bf16_t *b, int ldb,
+                                         float *c, int ldc,
+                    bf16_t *packedA, bf16_t *packedB, int first_time )
+{
+  int i, j;
+  int k2 = ( k+1 ) / 2 * 2;      /* k rounded up to whole pairs */
+
+  for ( j=0; j<n; j+=4 ){        /* Loop over the columns of C, unrolled by 4 */
+    if ( first_time )
+      PackMatrixB_b( k, min( n-j, 4 ), &B( 0,j ), ldb, &packedB[ j*k2 ] );
+    for ( i=0; i<m; i+=8 ){        /* Loop over the rows of C, unrolled by 8 */
+      if ( j == 0 )
+        PackMatrixA_b( k, min( m-i, 8 ), &A( i,0 ), lda, &packedA[ i*k2 ] );
+      AddDot8x4_b( k, &packedA[ i*k2 ], &packedB[ j*k2 ], &C( i,j ), ldc,
+                   min( m-i, 8 ), min( n-j, 4 ) );
+    }
+  }
+}
+
+void PackMatrixA_b( int k, int mr, bf16_t *a, int lda, bf16_t *a_to )
+{
+  /* Packs an 8 x k panel of A as pairs of columns, A( r,p:p+1 ) being the
+     two halves of 32-bit lane r */
+  int p, r, t;
+
+  for( p=0; p<k; p+=2 )
+    for ( r=0; r<8; r++ )
+      for ( t=0; t<2; t++ )
+        *a_to++ = ( r < mr && p+t < k ? A( r,p+t ) : 0 );
+}
+
+void PackMatrixB_b( int k, int nr, bf16_t *b, int ldb, bf16_t *b_to )
+{
+  /* Packs a k x 4 panel of B as pairs of rows, B( p:p+1,j ) being two
+     consecutive values */
+  int p, j, t;
+
+  for( p=0; p<k; p+=2 )
+    for ( j=0; j<4; j++ )
+      for ( t=0; t<2; t++ )
+        *b_to++ = ( j < nr && p+t < k ? B( p+t,j ) : 0 );
+}
+
+typedef union
+{
+  __m256 v;
+  float f[8];
+} v8sf_t;
+
+#if defined(__AVX512BF16__) && defined(__AVX512VL__)
+#define DOT2( acc, a, b ) \
+  acc = _mm256_dpbf16_ps( acc, (__m256bh) (a), (__m256bh) (b) )
+#elif defined(__AVX2__)
+/* The bf16 in the low half of a lane becomes a float when shifted up,
+   the one in the high half when the low half is masked off */
+#define DOT2( acc, a, b ) \
+  acc += _mm256_castsi256_ps( _mm256_slli_epi32( a, 16 ) ) \
+           * _mm256_castsi256_ps( _mm256_slli_epi32( b, 16 ) ) \
+       + _mm256_castsi256_ps( _mm256_and_si256( a, mask_hi_epi32 ) ) \
+           * _mm256_castsi256_ps( _mm256_and_si256( b, mask_hi_epi32 ) )
+#else
+#error "BMMult needs AVX2 (compile with -mavx2, and -mavx512bf16 -mavx512vl where available)"
+#endif
+
+void AddDot8x4_b( int k, bf16_t *a, bf16_t *b, float *c, int ldc, int mr, int nr )
+{
+  /* So, this routine computes an 8x4 block of matrix C in fp32, of which
+     only the first mr rows and nr columns are written back to c */
+
+  int p, i;
+  v8sf_t
+    c_0_vreg, c_1_vreg, c_2_vreg, c_3_vreg;
+  __m256i
+    a_p_vreg;
+#if !( defined(__AVX512BF16__) && defined(__AVX512VL__) )
+  __m256i
+    mask_hi_epi32 = _mm256_set1_epi32( 0xffff0000 );
+#endif
+
+  c_0_vreg.v = _mm256_setzero_ps();
+  c_1_vreg.v = _mm256_setzero_ps();
+  c_2_vreg.v = _mm256_setzero_ps();
+  c_3_vreg.v = _mm256_setzero_ps();
+
+  for ( p=0; p<k; p+=2 ){
+    a_p_vreg = _mm256_load_si256( (__m256i *) a );   /* 8 rows x 2 values of k */
+    a += 16;
+
+    /* broadcast B( p:p+1,j ) to every lane */
+    DOT2( c_0_vreg.v, a_p_vreg, _mm256_broadcastd_epi32( _mm_loadu_si32( b ) ) );
+    DOT2( c_1_vreg.v, a_p_vreg, _mm256_broadcastd_epi32( _mm_loadu_si32( b+2 ) ) );
+    DOT2( c_2_vreg.v, a_p_vreg, _mm256_broadcastd_epi32( _mm_loadu_si32( b+4 ) ) );
+    DOT2( c_3_vreg.v, a_p_vreg, _mm256_broadcastd_epi32( _mm_loadu_si32( b+6 ) ) );
+    b += 8;
+  }
+
+  for ( i=0; i<mr; i++ ){
+    C( i, 0 ) += c_0_vreg.f[ i ];
+    if ( nr > 1 ) C( i, 1 ) += c_1_vreg.f[ i ];
+    if ( nr > 2 ) C( i, 2 ) += c_2_vreg.f[ i ];
+    if ( nr > 3 ) C( i, 3 ) += c_3_vreg.f[ i ];
+  }
+}
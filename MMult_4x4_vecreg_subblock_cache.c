@@ -1,3 +1,16 @@
+#include <stdlib.h>
+#include <pthread.h>
+
+#include <mmintrin.h>
+#include <xmmintrin.h>  // SSE
+#include <pmmintrin.h>  // SSE2
+#include <emmintrin.h>  // SSE3
+
+#include "epilogue.h"
+#include "conv.h"
+#include "threads.h"
+#include "trace.h"
+
 /* Create macros so that the matrices are stored in column-major order */
 
 #define A(i,j) a[ (j)*lda + (i) ]
@@ -7,22 +20,73 @@
 /* Block sizes */
 #define mc 256
 #define kc 128
-#define nb 20000
+
+/* Blocks with at least this many elements to pack are packed by
+   PACK_THREADS threads (1 if unset, at most PACK_MAX_THREADS) before the
+   multiply starts, as many as the budget of threads.h grants */
+#define PACK_PARALLEL_MIN ( 64 * 1024 )
+#define PACK_MAX_THREADS 64
 
 #define min( i, j ) ( (i)<(j) ? (i): (j) )
 
 /* Routine for computing C = A * B + C */
 
-void AddDot4x4( int, double *, int, double *, int, double *, int );
+void AddDot4x4( int, double *, int, double *, int, double *, int,
+                const Epilogue *, int, int );
 void PackMatrixA( int, double *, int, double * );
 void PackMatrixB( int, double *, int, double * );
-void InnerKernel( int, int, int, double *, int, double *, int, double *, int, int );
+void PackMatrixBConv( int, int, int, const ConvShape *, int, int, double *, double * );
+void InnerKernel( int, int, int, double *, int, double *, int, double *, int,
+                  double *, int, const Epilogue *, int, int );
+void PackPanels( int, int, int, double *, int, double *, int,
+                 double *, double *, int, int );
+
+/* PACK_THREADS, read once per call rather than per block, and clamped
+   to 1..PACK_MAX_THREADS as it sizes the thread arrays of PackPanels */
+
+static int PackThreads( void )
+{
+  char *env = getenv( "PACK_THREADS" );
+  int threads = env ? atoi( env ) : 1;
+
+  return threads < 1 ? 1 : min( threads, PACK_MAX_THREADS );
+}
 
 void MY_MMult( int m, int n, int k, double *a, int lda,
                                     double *b, int ldb,
                                     double *c, int ldc )
 {
-  int i, p, pb, ib;
+  MY_MMult_ep( m, n, k, a, lda, b, ldb, c, ldc, NULL );
+}
+
+/* Routine for computing C = act( C + A * B + bias ) + residual, see
+   epilogue.h. The epilogue is applied by AddDot4x4 to the registers of the
+   last kc block, so it takes no extra pass over C */
+
+void MY_MMult_ep( int m, int n, int k, double *a, int lda,
+                                       double *b, int ldb,
+                                       double *c, int ldc, const Epilogue *ep )
+{
+  int i, j, p, pb, ib, threads;
+  double
+    *packedB;
+
+  /* With k = 0 there is no last kc block to carry the epilogue: apply it
+     to C alone, the 4x4 kernel adding an empty product */
+  if ( k == 0 ){
+    if ( ep )
+      for ( j=0; j<n; j+=4 )
+        for ( i=0; i<m; i+=4 )
+          AddDot4x4( 0, NULL, 4, NULL, 0, &C( i,j ), ldc, ep, i, j );
+    return;
+  }
+
+  /* The packed B is allocated per call rather than kept in a static
+     buffer, so that several threads can multiply at the same time */
+  if ( posix_memalign( (void **) &packedB, 16, kc * n * sizeof( double ) ) )
+    abort();
+
+  threads = threads_acquire( PackThreads() );
 
   /* This time, we compute a mc x n block of C by a call to the InnerKernel */
 
@@ -30,34 +94,217 @@ void MY_MMult( int m, int n, int k, double *a, int lda,
     pb = min( k-p, kc );
     for ( i=0; i<m; i+=mc ){
       ib = min( m-i, mc );
-      InnerKernel( ib, n, pb, &A( i,p ), lda, &B(p, 0 ), ldb, &C( i,0 ), ldc, i==0 );
+      TRACE_BEGIN( t_block );
+      InnerKernel( ib, n, pb, &A( i,p ), lda, &B(p, 0 ), ldb, &C( i,0 ), ldc,
+                   packedB, i==0, ( p+pb == k ? ep : NULL ), i, threads );
+      TRACE_END( t_block, "InnerKernel", "row", i );
+    }
+  }
+
+  free( packedB );
+  threads_release();
+}
+
+/* Routine for computing C = A * B + C with A and B already packed, laid
+   out as the kc blocks of PackMatrixA and PackMatrixB panels that
+   InnerKernel would produce (see the MATFILE_PACKED_* layouts in
+   matfile.c). The packed panel of A starting at A( i,p ) is found at
+   packed_a[ p*m + i*pb ] and that of B starting at B( p,j ) at
+   packed_b[ p*n + j*pb ] */
+
+void MY_MMult_packed( int m, int n, int k, double *packed_a, double *packed_b,
+                                           double *c, int ldc )
+{
+  int i, j, p, pb, ii, ib;
+
+  for ( p=0; p<k; p+=kc ){
+    pb = min( k-p, kc );
+    for ( ii=0; ii<m; ii+=mc ){
+      ib = min( m-ii, mc );
+      for ( j=0; j<n; j+=4 )
+        for ( i=ii; i<ii+ib; i+=4 )
+          AddDot4x4( pb, &packed_a[ p*m + i*pb ], 4, &packed_b[ p*n + j*pb ], pb, &C( i,j ), ldc,
+                     NULL, i, j );
     }
   }
 }
 
+/* Routine for computing out = out + conv( in, filter ), see conv.h.
+
+   As a GEMM, C is the output with a row per filter and a column per
+   output pixel: NHWC makes it column-major with ldc = filters. A is the
+   HWIO filter, filters x ( kh*kw*channels ) with lda = filters, used
+   where it is. B is the im2col matrix of the input, a row per tap of the
+   filter and channel, which is kh*kw times larger than the input: it is
+   never formed, PackMatrixBConv gathers each kc x 4 panel straight from
+   the input, and InnerKernel and AddDot4x4 run on the packed panels as
+   for MY_MMult. The last pixels, if their number is not a multiple of 4,
+   go through a buffer of 4 columns, and the last filters, if theirs is
+   not, through a copy of their rows of A and C padded with zeros to 4
+   rows */
+
+void MY_Conv2d( const ConvShape *s, double *in, double *filter, double *out )
+{
+  int i, j, p, pb, ib, out_h, out_w, pixels, n4, rest, threads,
+    m = s->filters, k = s->kh * s->kw * s->channels, m4 = m & ~3, mrest = m - m4;
+  double
+    *a = filter, *c = out, *packedB, *tail, *a_tail = NULL, *c_tail = NULL;
+  int lda = m, ldc = m;
+
+  threads = threads_acquire( PackThreads() );
+  out_h = CONV_OUT_SIZE( s->height, s->kh, s->stride, s->pad, s->dilation );
+  out_w = CONV_OUT_SIZE( s->width, s->kw, s->stride, s->pad, s->dilation );
+  pixels = s->batch * out_h * out_w;
+  n4 = pixels & ~3;
+  rest = pixels - n4;
+
+  if ( posix_memalign( (void **) &packedB, 16, kc * ( n4+4 ) * sizeof( double ) ) ||
+       posix_memalign( (void **) &tail, 16, m * 4 * sizeof( double ) ) )
+    abort();
+
+  for ( j=0; j<4; j++ )
+    for ( i=0; i<m4; i++ )
+      tail[ j*m + i ] = j < rest ? C( i,n4+j ) : 0.0;
+
+  /* The last filters: 4 x k of A and 4 x ( n4+4 ) of C, leading
+     dimension 4, the tail pixels included */
+  if ( mrest ){
+    if ( posix_memalign( (void **) &a_tail, 16, 4 * k * sizeof( double ) ) ||
+         posix_memalign( (void **) &c_tail, 16, 4 * ( n4+4 ) * sizeof( double ) ) )
+      abort();
+    for ( p=0; p<k; p++ )
+      for ( i=0; i<4; i++ )
+        a_tail[ p*4 + i ] = i < mrest ? A( m4+i,p ) : 0.0;
+    for ( j=0; j<n4+4; j++ )
+      for ( i=0; i<4; i++ )
+        c_tail[ j*4 + i ] = i < mrest && j < pixels ? C( m4+i,j ) : 0.0;
+  }
+
+  for ( p=0; p<k; p+=kc ){
+    pb = min( k-p, kc );
+    for ( j=0; j<n4+( rest ? 4 : 0 ); j+=4 ){
+      TRACE_BEGIN( t_pack );
+      PackMatrixBConv( pb, p, j, s, out_h, out_w, in, &packedB[ j*pb ] );
+      TRACE_END( t_pack, "PackMatrixBConv", "col", j );
+    }
+    for ( i=0; i<m4; i+=mc ){
+      ib = min( m4-i, mc );
+      TRACE_BEGIN( t_block );
+      if ( n4 )
+        InnerKernel( ib, n4, pb, &A( i,p ), lda, NULL, 0, &C( i,0 ), ldc,
+                     packedB, 0, NULL, i, threads );
+      if ( rest )
+        InnerKernel( ib, 4, pb, &A( i,p ), lda, NULL, 0, &tail[ i ], m,
+                     &packedB[ n4*pb ], 0, NULL, i, threads );
+      TRACE_END( t_block, "InnerKernel", "row", i );
+    }
+    if ( mrest ){
+      TRACE_BEGIN( t_block );
+      InnerKernel( 4, n4+( rest ? 4 : 0 ), pb, &a_tail[ p*4 ], 4, NULL, 0, c_tail, 4,
+                   packedB, 0, NULL, m4, threads );
+      TRACE_END( t_block, "InnerKernel", "row", m4 );
+    }
+  }
+
+  for ( j=0; j<rest; j++ )
+    for ( i=0; i<m4; i++ )
+      C( i,n4+j ) = tail[ j*m + i ];
+  for ( j=0; j<pixels; j++ )
+    for ( i=0; i<mrest; i++ )
+      C( m4+i,j ) = c_tail[ j*4 + i ];
+
+  free( packedB );
+  free( tail );
+  free( a_tail );
+  free( c_tail );
+  threads_release();
+}
+
 void InnerKernel( int m, int n, int k, double *a, int lda,
                                        double *b, int ldb,
-                                       double *c, int ldc, int first_time )
+                                       double *c, int ldc,
+                  double *packedB, int first_time, const Epilogue *ep, int row,
+                  int threads )
 {
-  int i, j;
+  int i, j, packed = 0;
   double
-    packedA[ m * k ];
-  static double
-    packedB[ kc*nb ];    /* Note: using a static buffer is not thread safe... */
+    packedA[ m * k ] __attribute__(( aligned( 16 ) ));
+
+  /* Packing is O( mk + nk ) against O( mnk ) for the multiply, but it runs
+     on one thread while the caller may have many. Large blocks are packed
+     up front, spread over the threads */
+  if ( threads > 1 &&
+       m * k + ( first_time ? n * k : 0 ) >= PACK_PARALLEL_MIN ){
+    PackPanels( m, n, k, a, lda, b, ldb, packedA, packedB, first_time, threads );
+    packed = 1;
+  }
 
   for ( j=0; j<n; j+=4 ){        /* Loop over the columns of C, unrolled by 4 */
-    if ( first_time )
+    if ( first_time && !packed ){
+      TRACE_BEGIN( t_pack );
       PackMatrixB( k, &B( 0, j ), ldb, &packedB[ j*k ] );
+      TRACE_END( t_pack, "PackMatrixB", "col", j );
+    }
     for ( i=0; i<m; i+=4 ){        /* Loop over the rows of C */
       /* Update C( i,j ), C( i,j+1 ), C( i,j+2 ), and C( i,j+3 ) in
 	 one routine (four inner products) */
-      if ( j == 0 )
+      if ( j == 0 && !packed ){
+	TRACE_BEGIN( t_pack );
 	PackMatrixA( k, &A( i, 0 ), lda, &packedA[ i*k ] );
-      AddDot4x4( k, &packedA[ i*k ], 4, &packedB[ j*k ], k, &C( i,j ), ldc );
+	TRACE_END( t_pack, "PackMatrixA", "row", row+i );
+      }
+      AddDot4x4( k, &packedA[ i*k ], 4, &packedB[ j*k ], k, &C( i,j ), ldc,
+                 ep, row+i, j );
     }
   }
 }
 
+typedef struct {
+  int m, n, k, lda, ldb, first_time, threads, id;
+  double *a, *b, *packedA, *packedB;
+} PackTask;
+
+void *PackTaskPanels( void *arg )
+{
+  /* Thread id packs every threads-th panel of A and, the first time, of B,
+     so each thread gets an even share of both */
+  PackTask *t = arg;
+  int i, j, m = t->m, n = t->n, k = t->k, lda = t->lda, ldb = t->ldb;
+  double *a = t->a, *b = t->b;
+  TRACE_BEGIN( t_pack );
+
+  for ( i=4*t->id; i<m; i+=4*t->threads )
+    PackMatrixA( k, &A( i, 0 ), lda, &t->packedA[ i*k ] );
+  if ( t->first_time )
+    for ( j=4*t->id; j<n; j+=4*t->threads )
+      PackMatrixB( k, &B( 0, j ), ldb, &t->packedB[ j*k ] );
+
+  TRACE_END( t_pack, "PackPanels", "thread", t->id );
+  return NULL;
+}
+
+void PackPanels( int m, int n, int k, double *a, int lda, double *b, int ldb,
+                 double *packedA, double *packedB, int first_time, int threads )
+{
+  int t;
+  pthread_t
+    thread[ threads ];
+  PackTask
+    task[ threads ];
+
+  for ( t=0; t<threads; t++ ){
+    PackTask task_t = { m, n, k, lda, ldb, first_time, threads, t,
+                        a, b, packedA, packedB };
+    task[ t ] = task_t;
+    /* The calling thread takes panel set 0 itself */
+    if ( t > 0 && pthread_create( &thread[ t ], NULL, PackTaskPanels, &task[ t ] ) )
+      abort();
+  }
+  PackTaskPanels( &task[ 0 ] );
+  for ( t=1; t<threads; t++ )
+    pthread_join( thread[ t ], NULL );
+}
+
 void PackMatrixA( int k, double *a, int lda, double *a_to )
 {
   int j;
@@ -66,10 +313,9 @@ void PackMatrixA( int k, double *a, int lda, double *a_to )
     double
       *a_ij_pntr = &A( 0, j );
 
-    *a_to     = *a_ij_pntr;
-    *(a_to+1) = *(a_ij_pntr+1);
-    *(a_to+2) = *(a_ij_pntr+2);
-    *(a_to+3) = *(a_ij_pntr+3);
+    /* Four rows of a column are contiguous: two vector copies */
+    _mm_storeu_pd( a_to,   _mm_loadu_pd( a_ij_pntr ) );
+    _mm_storeu_pd( a_to+2, _mm_loadu_pd( a_ij_pntr+2 ) );
 
     a_to += 4;
   }
@@ -81,19 +327,91 @@ void PackMatrixB( int k, double *b, int ldb, double *b_to )
   double
     *b_i0_pntr = &B( 0, 0 ), *b_i1_pntr = &B( 0, 1 ),
     *b_i2_pntr = &B( 0, 2 ), *b_i3_pntr = &B( 0, 3 );
+  __m128d
+    b_0, b_1, b_2, b_3;
 
-  for( i=0; i<k; i++){  /* loop over rows of B */
-    *b_to++ = *b_i0_pntr++;
-    *b_to++ = *b_i1_pntr++;
-    *b_to++ = *b_i2_pntr++;
-    *b_to++ = *b_i3_pntr++;
+  /* Two rows at a time: load two elements of each column and transpose
+     them into the two rows of the panel */
+  for( i=0; i+1<k; i+=2 ){  /* loop over rows of B */
+    b_0 = _mm_loadu_pd( b_i0_pntr );  b_i0_pntr += 2;
+    b_1 = _mm_loadu_pd( b_i1_pntr );  b_i1_pntr += 2;
+    b_2 = _mm_loadu_pd( b_i2_pntr );  b_i2_pntr += 2;
+    b_3 = _mm_loadu_pd( b_i3_pntr );  b_i3_pntr += 2;
+
+    _mm_storeu_pd( b_to,   _mm_unpacklo_pd( b_0, b_1 ) );
+    _mm_storeu_pd( b_to+2, _mm_unpacklo_pd( b_2, b_3 ) );
+    _mm_storeu_pd( b_to+4, _mm_unpackhi_pd( b_0, b_1 ) );
+    _mm_storeu_pd( b_to+6, _mm_unpackhi_pd( b_2, b_3 ) );
+    b_to += 8;
+  }
+  if ( i < k ){  /* odd k: the last row */
+    *b_to++ = *b_i0_pntr;
+    *b_to++ = *b_i1_pntr;
+    *b_to++ = *b_i2_pntr;
+    *b_to++ = *b_i3_pntr;
   }
 }
 
-#include <mmintrin.h>
-#include <xmmintrin.h>  // SSE
-#include <pmmintrin.h>  // SSE2
-#include <emmintrin.h>  // SSE3
+void PackMatrixBConv( int k, int p, int j, const ConvShape *s, int out_h, int out_w,
+                      double *in, double *b_to )
+{
+  /* Rows p..p+k-1 of columns j..j+3 of the im2col matrix, laid out as by
+     PackMatrixB. Row r is tap ( kh,kw ) of the filter and channel ci, with
+     r = ( kh*kw_size + kw )*channels + ci, so the rows come in runs of
+     channels that are contiguous in the NHWC input. A column that falls
+     in the padding or past the last pixel reads a zero that does not move */
+  static double
+    zero = 0.0;
+  int c, i, r, run, pixel, ci, kw, kh, ih, iw, ow, oh,
+    channels = s->channels, ih0[ 4 ], iw0[ 4 ], img[ 4 ], step[ 4 ];
+  double
+    *src[ 4 ];
+
+  for ( c=0; c<4; c++ ){
+    pixel = j+c;
+    img[ c ] = pixel < s->batch * out_h * out_w ? pixel / ( out_h*out_w ) : -1;
+    oh = pixel / out_w % out_h;
+    ow = pixel % out_w;
+    ih0[ c ] = oh * s->stride - s->pad;
+    iw0[ c ] = ow * s->stride - s->pad;
+  }
+
+  ci = p % channels;
+  kw = p / channels % s->kw;
+  kh = p / channels / s->kw;
+
+  for ( i=0; i<k; i+=run ){
+    run = min( k-i, channels-ci );
+
+    for ( c=0; c<4; c++ ){
+      ih = ih0[ c ] + kh * s->dilation;
+      iw = iw0[ c ] + kw * s->dilation;
+      if ( img[ c ] >= 0 && ih >= 0 && ih < s->height && iw >= 0 && iw < s->width ){
+        src[ c ] = &in[ ( ( (long) img[ c ] * s->height + ih ) * s->width + iw ) * channels + ci ];
+        step[ c ] = 1;
+      } else {
+        src[ c ] = &zero;
+        step[ c ] = 0;
+      }
+    }
+
+    for ( r=0; r<run; r++ ){
+      *b_to++ = src[ 0 ][ r*step[ 0 ] ];
+      *b_to++ = src[ 1 ][ r*step[ 1 ] ];
+      *b_to++ = src[ 2 ][ r*step[ 2 ] ];
+      *b_to++ = src[ 3 ][ r*step[ 3 ] ];
+    }
+
+    ci += run;
+    if ( ci == channels ){
+      ci = 0;
+      if ( ++kw == s->kw ){
+        kw = 0;
+        kh++;
+      }
+    }
+  }
+}
 
 typedef union
 {
@@ -101,7 +419,10 @@ typedef union
   double d[2];
 } v2df_t;
 
-void AddDot4x4( int k, double *a, int lda,  double *b, int ldb, double *c, int ldc )
+void EpilogueColumn( v2df_t *, v2df_t *, double *, const Epilogue *, int, int );
+
+void AddDot4x4( int k, double *a, int lda,  double *b, int ldb, double *c, int ldc,
+                const Epilogue *ep, int row, int col )
 {
   /* So, this routine computes a 4x4 block of matrix A
            C( 0, 0 ), C( 0, 1 ), C( 0, 2 ), C( 0, 3 ).
@@ -116,7 +437,9 @@ void AddDot4x4( int k, double *a, int lda,  double *b, int ldb, double *c, int l
            C( i+3, j ), C( i+3, j+1 ), C( i+3, j+2 ), C( i+3, j+3 )
 
      in the original matrix C
-     And now we use vector registers and instructions */
+     And now we use vector registers and instructions.
+     If ep is not NULL the block is finished here: row and col give its
+     position in the whole C for the bias and residual */
 
   int p;
   v2df_t
@@ -160,6 +483,14 @@ void AddDot4x4( int k, double *a, int lda,  double *b, int ldb, double *c, int l
     c_23_c_33_vreg.v += a_2p_a_3p_vreg.v * b_p3_vreg.v;
   }
 
+  if ( ep ){
+    EpilogueColumn( &c_00_c_10_vreg, &c_20_c_30_vreg, &C( 0, 0 ), ep, row, col );
+    EpilogueColumn( &c_01_c_11_vreg, &c_21_c_31_vreg, &C( 0, 1 ), ep, row, col+1 );
+    EpilogueColumn( &c_02_c_12_vreg, &c_22_c_32_vreg, &C( 0, 2 ), ep, row, col+2 );
+    EpilogueColumn( &c_03_c_13_vreg, &c_23_c_33_vreg, &C( 0, 3 ), ep, row, col+3 );
+    return;
+  }
+
   C( 0, 0 ) += c_00_c_10_vreg.d[0];  C( 0, 1 ) += c_01_c_11_vreg.d[0];
   C( 0, 2 ) += c_02_c_12_vreg.d[0];  C( 0, 3 ) += c_03_c_13_vreg.d[0];
 
@@ -172,3 +503,43 @@ void AddDot4x4( int k, double *a, int lda,  double *b, int ldb, double *c, int l
   C( 3, 0 ) += c_20_c_30_vreg.d[1];  C( 3, 1 ) += c_21_c_31_vreg.d[1];
   C( 3, 2 ) += c_22_c_32_vreg.d[1];  C( 3, 3 ) += c_23_c_33_vreg.d[1];
 }
+
+#include <math.h>
+
+void EpilogueColumn( v2df_t *c_01_vreg, v2df_t *c_23_vreg, double *c,
+                     const Epilogue *ep, int row, int col )
+{
+  /* Adds one column of the 4x4 block of A * B to c = C( row:row+3, col )
+     and applies the epilogue before storing it */
+
+  int i;
+
+  c_01_vreg->v += _mm_loadu_pd( c );
+  c_23_vreg->v += _mm_loadu_pd( c+2 );
+
+  if ( ep->bias ){
+    c_01_vreg->v += _mm_loadu_pd( &ep->bias[ row ] );
+    c_23_vreg->v += _mm_loadu_pd( &ep->bias[ row+2 ] );
+  }
+
+  switch ( ep->activation ){
+  case EPILOGUE_RELU:
+    c_01_vreg->v = _mm_max_pd( c_01_vreg->v, _mm_setzero_pd() );
+    c_23_vreg->v = _mm_max_pd( c_23_vreg->v, _mm_setzero_pd() );
+    break;
+  case EPILOGUE_GELU:
+    for ( i=0; i<2; i++ ){
+      c_01_vreg->d[i] *= 0.5 * ( 1.0 + erf( c_01_vreg->d[i] * M_SQRT1_2 ) );
+      c_23_vreg->d[i] *= 0.5 * ( 1.0 + erf( c_23_vreg->d[i] * M_SQRT1_2 ) );
+    }
+    break;
+  }
+
+  if ( ep->residual ){
+    c_01_vreg->v += _mm_loadu_pd( &ep->residual[ col*ep->ldr + row ] );
+    c_23_vreg->v += _mm_loadu_pd( &ep->residual[ col*ep->ldr + row+2 ] );
+  }
+
+  _mm_storeu_pd( c, c_01_vreg->v );
+  _mm_storeu_pd( c+2, c_23_vreg->v );
+}
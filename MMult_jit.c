@@ -0,0 +1,148 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "jit.h"
+
+/* Create macros so that the matrices are stored in column-major order */
+
+#define A(i,j) a[ (j)*lda + (i) ]
+#define B(i,j) b[ (j)*ldb + (i) ]
+#define C(i,j) c[ (j)*ldc + (i) ]
+
+/* Block sizes */
+#define mc 192
+#define kc 256
+
+/* Largest register tile, for the buffer of the edges of C: 32 vector
+   registers hold at most 256 doubles of accumulators */
+#define MAX_TILE 256
+
+#define min( i, j ) ( (i)<(j) ? (i): (j) )
+
+/* Routine for computing C = A * B + C
+
+   This is the blocked engine of MMult_4x4_vecreg_subblock_cache with its
+   4x4 AddDot4x4 replaced by a micro-kernel generated for the host by
+   jit.c: the register tile is mr x nr (16 x 12 with AVX-512, 8 x 6 with
+   AVX2) and the panels of A and B are packed to those widths. Sizes do
+   not need to be multiples of the tile: the packed panels are padded
+   with zeros and the edges of C go through a small buffer */
+
+void AddDotTile( long, const double *, const double *, double *, long );
+void PackPanelA( int, int, int, double *, int, double * );
+void PackPanelB( int, int, int, double *, int, double * );
+
+static int mr = 4, nr = 4;
+static JitKernel kernel = AddDotTile;
+static pthread_once_t kernel_once = PTHREAD_ONCE_INIT;
+
+static void PickKernel()
+{
+  JitConfig cfg = jit_host_config();
+  JitKernel generated = jit_kernel( &cfg );
+
+  /* Without a generator for this host, the compiled 4x4 kernel */
+  if ( generated ){
+    mr = cfg.mr;
+    nr = cfg.nr;
+    kernel = generated;
+  }
+}
+
+void MY_MMult( int m, int n, int k, double *a, int lda,
+                                    double *b, int ldb,
+                                    double *c, int ldc )
+{
+  int i, j, p, pb, ib, ii, jb;
+  double
+    *packedA, *packedB,
+    tile[ MAX_TILE ];
+
+  pthread_once( &kernel_once, PickKernel );
+
+  /* The panels are padded up to whole tiles */
+  if ( posix_memalign( (void **) &packedA, 64, ( min( m, mc ) + mr ) * min( k, kc ) * sizeof( double ) ) ||
+       posix_memalign( (void **) &packedB, 64, ( n + nr ) * min( k, kc ) * sizeof( double ) ) )
+    abort();
+
+  for ( p=0; p<k; p+=kc ){
+    pb = min( k-p, kc );
+    for ( j=0; j<n; j+=nr )
+      PackPanelB( pb, min( n-j, nr ), nr, &B( p,j ), ldb, &packedB[ j*pb ] );
+
+    for ( ii=0; ii<m; ii+=mc ){
+      ib = min( m-ii, mc );
+      for ( i=0; i<ib; i+=mr )
+        PackPanelA( pb, min( ib-i, mr ), mr, &A( ii+i,p ), lda, &packedA[ i*pb ] );
+
+      for ( j=0; j<n; j+=nr ){
+        jb = min( n-j, nr );
+        for ( i=0; i<ib; i+=mr ){
+          if ( ib-i >= mr && jb == nr ){
+            kernel( pb, &packedA[ i*pb ], &packedB[ j*pb ], &C( ii+i,j ), ldc );
+          } else {
+            /* An edge of C: compute the whole tile aside, keep what is in C */
+            int r, s, rb = min( ib-i, mr );
+
+            memset( tile, 0, mr * nr * sizeof( double ) );
+            kernel( pb, &packedA[ i*pb ], &packedB[ j*pb ], tile, mr );
+            for ( s=0; s<jb; s++ )
+              for ( r=0; r<rb; r++ )
+                C( ii+i+r,j+s ) += tile[ s*mr + r ];
+          }
+        }
+      }
+    }
+  }
+
+  free( packedA );
+  free( packedB );
+}
+
+void PackPanelA( int k, int rows, int width, double *a, int lda, double *a_to )
+{
+  /* width rows of A, column after column, zero below row rows */
+  int i, j;
+
+  for ( j=0; j<k; j++ ){
+    for ( i=0; i<rows; i++ )
+      *a_to++ = A( i,j );
+    for ( ; i<width; i++ )
+      *a_to++ = 0.0;
+  }
+}
+
+void PackPanelB( int k, int cols, int width, double *b, int ldb, double *b_to )
+{
+  /* width columns of B, row after row, zero right of column cols */
+  int i, j;
+
+  for ( i=0; i<k; i++ ){
+    for ( j=0; j<cols; j++ )
+      *b_to++ = B( i,j );
+    for ( ; j<width; j++ )
+      *b_to++ = 0.0;
+  }
+}
+
+void AddDotTile( long k, const double *a, const double *b, double *c, long ldc )
+{
+  /* The 4x4 tile in plain C, for hosts the generator does not know */
+  int i, j;
+  long p;
+  double
+    c_tile[ 4 ][ 4 ] = {{ 0.0 }};
+
+  for ( p=0; p<k; p++ ){
+    for ( j=0; j<4; j++ )
+      for ( i=0; i<4; i++ )
+        c_tile[ j ][ i ] += a[ i ] * b[ j ];
+    a += 4;
+    b += 4;
+  }
+
+  for ( j=0; j<4; j++ )
+    for ( i=0; i<4; i++ )
+      C( i,j ) += c_tile[ j ][ i ];
+}
@@ -0,0 +1,228 @@
+/* SYRK, SYMM and TRMM on top of MMult_4x4_vecreg_subblock_cache.c.
+   They use the same kc x mc blocking and call its PackMatrixA,
+   PackMatrixB and AddDot4x4, and differ from MY_MMult in which panels
+   are packed and which 4x4 blocks are computed:
+     - SYRK only computes the blocks of one triangle of C
+     - SYMM packs the panels of A from the stored triangle
+     - TRMM skips the zero blocks of A and shortens the inner products
+       of the panels that cross its diagonal */
+
+#include <stdlib.h>
+
+#include "epilogue.h"
+#include "MMult_structured.h"
+
+/* Create macros so that the matrices are stored in column-major order */
+
+#define A(i,j) a[ (j)*lda + (i) ]
+#define B(i,j) b[ (j)*ldb + (i) ]
+#define C(i,j) c[ (j)*ldc + (i) ]
+
+/* Block sizes, as in MMult_4x4_vecreg_subblock_cache.c */
+#define mc 256
+#define kc 128
+
+#define min( i, j ) ( (i)<(j) ? (i): (j) )
+#define max( i, j ) ( (i)>(j) ? (i): (j) )
+
+/* In the stored triangle: on or below the diagonal for MMULT_LOWER */
+#define in_triangle( uplo, i, j ) ( (uplo) == MMULT_LOWER ? (i) >= (j) : (i) <= (j) )
+
+/* From MMult_4x4_vecreg_subblock_cache.c */
+void AddDot4x4( int, double *, int, double *, int, double *, int,
+                const Epilogue *, int, int );
+void PackMatrixA( int, double *, int, double * );
+void PackMatrixB( int, double *, int, double * );
+
+void AddDot4x4_tri( int, int, double *, double *, double *, int );
+void PackMatrixA_symm( int, int, int, int, double *, int, double * );
+void PackMatrixA_tri( int, int, int, int, int, double *, int, double * );
+
+double *alloc_packed( int size )
+{
+  double *p;
+
+  if ( posix_memalign( (void **) &p, 16, size * sizeof( double ) ) )
+    abort();
+  return p;
+}
+
+/* Routine for computing C = A * A^T + C ( trans == MMULT_NOTRANS, A is
+   n x k ) or C = A^T * A + C ( trans == MMULT_TRANS, A is k x n ),
+   updating only the uplo triangle of C. The other triangle is filled in
+   from it afterwards if mirror is set */
+
+void MY_SYRK( int uplo, int trans, int n, int k, double *a, int lda,
+              double *c, int ldc, int mirror )
+{
+  int i, j, p, pb, ii, ib;
+  double
+    *packed = alloc_packed( kc * n );
+
+  for ( p=0; p<k; p+=kc ){
+    pb = min( k-p, kc );
+
+    /* Both operands are the same matrix, so the panels of the block are
+       packed once and used as the packed A and the packed B */
+    for ( j=0; j<n; j+=4 )
+      if ( trans == MMULT_TRANS )
+        PackMatrixB( pb, &A( p,j ), lda, &packed[ j*pb ] );
+      else
+        PackMatrixA( pb, &A( j,p ), lda, &packed[ j*pb ] );
+
+    for ( ii=0; ii<n; ii+=mc ){
+      ib = min( n-ii, mc );
+      for ( j=0; j<n; j+=4 )
+        for ( i=max( ii, uplo == MMULT_LOWER ? j : 0 );
+              i<( uplo == MMULT_LOWER ? ii+ib : min( ii+ib, j+4 ) ); i+=4 ){
+          if ( i == j )
+            AddDot4x4_tri( uplo, pb, &packed[ i*pb ], &packed[ j*pb ], &C( i,j ), ldc );
+          else
+            AddDot4x4( pb, &packed[ i*pb ], 4, &packed[ j*pb ], pb, &C( i,j ), ldc, NULL, i, j );
+        }
+    }
+  }
+
+  free( packed );
+
+  if ( mirror )
+    symmetrize_matrix( uplo, n, c, ldc );
+}
+
+/* Routine for computing C = A * B + C with A m x m symmetric, of which
+   only the uplo triangle is read */
+
+void MY_SYMM( int uplo, int m, int n, double *a, int lda,
+                                      double *b, int ldb,
+                                      double *c, int ldc )
+{
+  int i, j, p, pb, ii, ib;
+  double
+    *packedA = alloc_packed( mc * kc ),
+    *packedB = alloc_packed( kc * n );
+
+  for ( p=0; p<m; p+=kc ){
+    pb = min( m-p, kc );
+    for ( j=0; j<n; j+=4 )
+      PackMatrixB( pb, &B( p,j ), ldb, &packedB[ j*pb ] );
+
+    for ( ii=0; ii<m; ii+=mc ){
+      ib = min( m-ii, mc );
+      for ( i=0; i<ib; i+=4 )
+        PackMatrixA_symm( uplo, pb, ii+i, p, a, lda, &packedA[ i*pb ] );
+
+      for ( j=0; j<n; j+=4 )
+        for ( i=0; i<ib; i+=4 )
+          AddDot4x4( pb, &packedA[ i*pb ], 4, &packedB[ j*pb ], pb, &C( ii+i,j ), ldc,
+                     NULL, ii+i, j );
+    }
+  }
+
+  free( packedA );
+  free( packedB );
+}
+
+/* Routine for computing C = A * B + C with A m x m triangular, stored in
+   its uplo triangle, with a unit diagonal if diag is MMULT_UNIT */
+
+void MY_TRMM( int uplo, int diag, int m, int n, double *a, int lda,
+                                              double *b, int ldb,
+                                              double *c, int ldc )
+{
+  int i, j, p, pb, ii, ib, first, last;
+  double
+    *packedA = alloc_packed( mc * kc ),
+    *packedB = alloc_packed( kc * n );
+
+  for ( p=0; p<m; p+=kc ){
+    pb = min( m-p, kc );
+    for ( j=0; j<n; j+=4 )
+      PackMatrixB( pb, &B( p,j ), ldb, &packedB[ j*pb ] );
+
+    for ( ii=0; ii<m; ii+=mc ){
+      ib = min( m-ii, mc );
+
+      /* Skip the blocks of A that are entirely zero */
+      if ( uplo == MMULT_LOWER ? ii+ib <= p : ii >= p+pb )
+        continue;
+
+      for ( i=0; i<ib; i+=4 )
+        PackMatrixA_tri( uplo, diag, pb, ii+i, p, a, lda, &packedA[ i*pb ] );
+
+      for ( j=0; j<n; j+=4 )
+        for ( i=0; i<ib; i+=4 ){
+          /* Only columns first..last-1 of the block are nonzero in rows
+             ii+i..ii+i+3 of A */
+          first = ( uplo == MMULT_LOWER ? 0 : max( ii+i-p, 0 ) );
+          last = ( uplo == MMULT_LOWER ? min( ii+i+4-p, pb ) : pb );
+          if ( first < last )
+            AddDot4x4( last-first, &packedA[ i*pb + 4*first ], 4, &packedB[ j*pb + 4*first ], pb,
+                       &C( ii+i,j ), ldc, NULL, ii+i, j );
+        }
+    }
+  }
+
+  free( packedA );
+  free( packedB );
+}
+
+void PackMatrixA_symm( int uplo, int k, int i, int p, double *a, int lda, double *a_to )
+{
+  /* Packs A( i:i+3, p:p+k-1 ) of a symmetric A, reading the elements
+     outside the stored triangle from their mirror image */
+  int q, r;
+
+  if ( in_triangle( uplo, i, p+k-1 ) && in_triangle( uplo, i+3, p ) )
+    PackMatrixA( k, &A( i,p ), lda, a_to );          /* all stored */
+  else if ( !in_triangle( uplo, i, p+k-1 ) && !in_triangle( uplo, i+3, p ) )
+    PackMatrixB( k, &A( p,i ), lda, a_to );          /* all mirrored */
+  else
+    for ( q=0; q<k; q++ )
+      for ( r=0; r<4; r++ )
+        *a_to++ = ( in_triangle( uplo, i+r, p+q ) ? A( i+r,p+q ) : A( p+q,i+r ) );
+}
+
+void PackMatrixA_tri( int uplo, int diag, int k, int i, int p, double *a, int lda, double *a_to )
+{
+  /* Packs A( i:i+3, p:p+k-1 ) of a triangular A, with zeros outside the
+     stored triangle */
+  int q, r;
+
+  if ( in_triangle( uplo, i, p+k-1 ) && in_triangle( uplo, i+3, p ) &&
+       ( diag == MMULT_NONUNIT || i > p+k-1 || i+3 < p ) )
+    PackMatrixA( k, &A( i,p ), lda, a_to );
+  else
+    for ( q=0; q<k; q++ )
+      for ( r=0; r<4; r++ )
+        *a_to++ = ( i+r == p+q && diag == MMULT_UNIT ? 1.0 :
+                    in_triangle( uplo, i+r, p+q ) ? A( i+r,p+q ) : 0.0 );
+}
+
+void AddDot4x4_tri( int uplo, int k, double *a, double *b, double *c, int ldc )
+{
+  /* A 4x4 block on the diagonal of C: compute all of it in a buffer and
+     add only its uplo triangle */
+  int i, j;
+  double
+    t[ 16 ] = { 0.0 };
+
+  AddDot4x4( k, a, 4, b, k, t, 4, NULL, 0, 0 );
+
+  for ( j=0; j<4; j++ )
+    for ( i=0; i<4; i++ )
+      if ( in_triangle( uplo, i, j ) )
+        C( i,j ) += t[ j*4 + i ];
+}
+
+void symmetrize_matrix( int uplo, int n, double *c, int ldc )
+{
+  /* Copies the uplo triangle of the n x n matrix C to the other one */
+  int i, j;
+
+  for ( j=0; j<n; j++ )
+    for ( i=j+1; i<n; i++ )
+      if ( uplo == MMULT_LOWER )
+        C( j,i ) = C( i,j );
+      else
+        C( i,j ) = C( j,i );
+}
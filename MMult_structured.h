@@ -0,0 +1,20 @@
+/* Products with symmetric and triangular matrices, built on the packing
+   and micro-kernel of MMult_4x4_vecreg_subblock_cache.c. Matrices are
+   column-major and all sizes must be multiples of 4 */
+
+/* Which triangle of a symmetric or triangular matrix is stored */
+#define MMULT_LOWER 0
+#define MMULT_UPPER 1
+
+/* SYRK operand */
+#define MMULT_NOTRANS 0             /* C += A * A^T */
+#define MMULT_TRANS   1             /* C += A^T * A */
+
+/* TRMM diagonal */
+#define MMULT_NONUNIT 0
+#define MMULT_UNIT    1             /* diagonal of A is 1 and not read */
+
+void MY_SYRK(int, int, int, int, double *, int, double *, int, int);
+void MY_SYMM(int, int, int, double *, int, double *, int, double *, int);
+void MY_TRMM(int, int, int, int, double *, int, double *, int, double *, int);
+void symmetrize_matrix(int, int, double *, int);
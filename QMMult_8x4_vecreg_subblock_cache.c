@@ -0,0 +1,218 @@
+/* Quantized int8 version of MMult_4x4_vecreg_subblock_cache.c.
+   A holds unsigned 8-bit and B signed 8-bit values, each with a scale and
+   a zero point: the real values are
+           scale_a[ i ] * ( A( i,p ) - zero_a[ i ] )     (per row of A)
+           scale_b[ j ] * ( B( p,j ) - zero_b[ j ] )     (per column of B)
+   The products are accumulated exactly in 32-bit integers and dequantized
+   to float only when the 8x4 block is added into C, using
+     sum_p ( a - za )( b - zb ) = sum_p a b - zb sum_p a - za sum_p b + k za zb
+   where the row sums of A and column sums of B are collected while packing.
+
+   Four consecutive values of k are packed next to each other, which is
+   the operand layout of the AVX-VNNI vpdpbusd instruction (u8 x s8 dot
+   products of 4 pairs into each 32-bit lane). Without VNNI the same
+   layout is multiplied with vpmaddwd after widening the bytes to 16 bits;
+   vpmaddubsw is not used because its 16-bit sums of two u8 x s8 products
+   saturate. */
+
+#include <stdlib.h>
+#include <immintrin.h>
+
+/* Create macros so that the matrices are stored in column-major order */
+
+#define A(i,j) a[ (j)*lda + (i) ]
+#define B(i,j) b[ (j)*ldb + (i) ]
+#define C(i,j) c[ (j)*ldc + (i) ]
+
+/* Block sizes, kc is a multiple of 4 */
+#define mc 256
+#define kc 512
+
+#define min( i, j ) ( (i)<(j) ? (i): (j) )
+
+typedef unsigned char u8_t;
+typedef signed char s8_t;
+
+typedef struct {
+  float *scale_a, *scale_b;
+  int *zero_a, *zero_b;
+} Quantization;
+
+/* Routine for computing C = dequant( A ) * dequant( B ) + C */
+
+void AddDot8x4_q( int, u8_t *, s8_t *, float *, int, int, int,
+                  int *, int *, Quantization *, int, int );
+void PackMatrixA_q( int, int, u8_t *, int, u8_t *, int * );
+void PackMatrixB_q( int, int, s8_t *, int, s8_t *, int * );
+void InnerKernel_q( int, int, int, u8_t *, int, s8_t *, int, float *, int,
+                    u8_t *, s8_t *, int *, int *, Quantization *, int, int );
+
+void MY_QMMult( int m, int n, int k, u8_t *a, int lda,
+                                     s8_t *b, int ldb,
+                                     float *c, int ldc,
+                float *scale_a, int *zero_a, float *scale_b, int *zero_b )
+{
+  int i, p, pb, ib;
+  u8_t
+    *packedA;
+  s8_t
+    *packedB;
+  int
+    *sumA, *sumB;
+  Quantization
+    q = { scale_a, scale_b, zero_a, zero_b };
+
+  if ( posix_memalign( (void **) &packedA, 32, mc * kc ) ||
+       posix_memalign( (void **) &packedB, 32, kc * ( n+3 ) ) )
+    abort();
+  sumA = (int *) malloc( ( mc+8 ) * sizeof( int ) );
+  sumB = (int *) malloc( ( n+4 ) * sizeof( int ) );
+
+  for ( p=0; p<k; p+=kc ){
+    pb = min( k-p, kc );
+    for ( i=0; i<m; i+=mc ){
+      ib = min( m-i, mc );
+      InnerKernel_q( ib, n, pb, &A( i,p ), lda, &B( p,0 ), ldb, &C( i,0 ), ldc,
+                     packedA, packedB, sumA, sumB, &q, i, i==0 );
+    }
+  }
+
+  free( packedA );
+  free( packedB );
+  free( sumA );
+  free( sumB );
+}
+
+void InnerKernel_q( int m, int n, int k, u8_t *a, int lda,
+                                         s8_t *b, int ldb,
+                                         float *c, int ldc,
+                    u8_t *packedA, s8_t *packedB, int *sumA, int *sumB,
+                    Quantization *q, int row, int first_time )
+{
+  int i, j;
+  int k4 = ( k+3 ) / 4 * 4;      /* k rounded up to whole groups of 4 */
+
+  for ( j=0; j<n; j+=4 ){        /* Loop over the columns of C, unrolled by 4 */
+    if ( first_time )
+      PackMatrixB_q( k, min( n-j, 4 ), &B( 0,j ), ldb, &packedB[ j*k4 ], &sumB[ j ] );
+    for ( i=0; i<m; i+=8 ){        /* Loop over the rows of C, unrolled by 8 */
+      if ( j == 0 )
+        PackMatrixA_q( k, min( m-i, 8 ), &A( i,0 ), lda, &packedA[ i*k4 ], &sumA[ i ] );
+      AddDot8x4_q( k, &packedA[ i*k4 ], &packedB[ j*k4 ], &C( i,j ), ldc,
+                   min( m-i, 8 ), min( n-j, 4 ), &sumA[ i ], &sumB[ j ], q, row+i, j );
+    }
+  }
+}
+
+void PackMatrixA_q( int k, int mr, u8_t *a, int lda, u8_t *a_to, int *sum )
+{
+  /* Packs an 8 x k panel of A as groups of 4 columns, A( r,p:p+3 ) being
+     the 4 bytes of 32-bit lane r. Also returns the row sums of the panel */
+  int p, r, t;
+
+  for ( r=0; r<8; r++ )
+    sum[ r ] = 0;
+
+  for( p=0; p<k; p+=4 ){
+    for ( r=0; r<8; r++ )
+      for ( t=0; t<4; t++ ){
+        u8_t
+          a_rp = ( r < mr && p+t < k ? A( r,p+t ) : 0 );
+        *a_to++ = a_rp;
+        sum[ r ] += a_rp;
+      }
+  }
+}
+
+void PackMatrixB_q( int k, int nr, s8_t *b, int ldb, s8_t *b_to, int *sum )
+{
+  /* Packs a k x 4 panel of B as groups of 4 rows, B( p:p+3,j ) being 4
+     consecutive bytes. Also returns the column sums of the panel */
+  int p, j, t;
+
+  for ( j=0; j<4; j++ )
+    sum[ j ] = 0;
+
+  for( p=0; p<k; p+=4 ){
+    for ( j=0; j<4; j++ )
+      for ( t=0; t<4; t++ ){
+        s8_t
+          b_pj = ( j < nr && p+t < k ? B( p+t,j ) : 0 );
+        *b_to++ = b_pj;
+        sum[ j ] += b_pj;
+      }
+  }
+}
+
+typedef union
+{
+  __m256i v;
+  int i[8];
+} v8si_t;
+
+#if defined(__AVXVNNI__)
+#define DOT4( acc, a, b ) acc = _mm256_dpbusd_avx_epi32( acc, a, b )
+#elif defined(__AVX512VNNI__) && defined(__AVX512VL__)
+#define DOT4( acc, a, b ) acc = _mm256_dpbusd_epi32( acc, a, b )
+#elif defined(__AVX2__)
+/* Widen the even and odd bytes of every 16-bit lane and use vpmaddwd on
+   both halves: exact for any u8 x s8 inputs */
+#define DOT4( acc, a, b ) \
+  acc = _mm256_add_epi32( acc, _mm256_add_epi32( \
+    _mm256_madd_epi16( _mm256_and_si256( a, mask_lo_epi16 ), \
+                       _mm256_srai_epi16( _mm256_slli_epi16( b, 8 ), 8 ) ), \
+    _mm256_madd_epi16( _mm256_srli_epi16( a, 8 ), _mm256_srai_epi16( b, 8 ) ) ) )
+#else
+#error "QMMult needs AVX2 (compile with -mavx2, and -mavxvnni where available)"
+#endif
+
+void AddDot8x4_q( int k, u8_t *a, s8_t *b, float *c, int ldc, int mr, int nr,
+                  int *sumA, int *sumB, Quantization *q, int row, int col )
+{
+  /* So, this routine computes an 8x4 block of A * B in 32-bit integers
+     and adds the dequantized first mr rows and nr columns into c.
+     row and col are the position of the block in the whole C */
+
+  int p, i, j;
+  v8si_t
+    c_0_vreg, c_1_vreg, c_2_vreg, c_3_vreg;
+  __m256i
+    a_p_vreg;
+#if !defined(__AVXVNNI__) && !( defined(__AVX512VNNI__) && defined(__AVX512VL__) )
+  __m256i
+    mask_lo_epi16 = _mm256_set1_epi16( 0x00ff );
+#endif
+
+  c_0_vreg.v = _mm256_setzero_si256();
+  c_1_vreg.v = _mm256_setzero_si256();
+  c_2_vreg.v = _mm256_setzero_si256();
+  c_3_vreg.v = _mm256_setzero_si256();
+
+  for ( p=0; p<k; p+=4 ){
+    a_p_vreg = _mm256_load_si256( (__m256i *) a );   /* 8 rows x 4 values of k */
+    a += 32;
+
+    /* broadcast B( p:p+3,j ) to every lane */
+    DOT4( c_0_vreg.v, a_p_vreg, _mm256_broadcastd_epi32( _mm_loadu_si32( b ) ) );
+    DOT4( c_1_vreg.v, a_p_vreg, _mm256_broadcastd_epi32( _mm_loadu_si32( b+4 ) ) );
+    DOT4( c_2_vreg.v, a_p_vreg, _mm256_broadcastd_epi32( _mm_loadu_si32( b+8 ) ) );
+    DOT4( c_3_vreg.v, a_p_vreg, _mm256_broadcastd_epi32( _mm_loadu_si32( b+12 ) ) );
+    b += 16;
+  }
+
+  for ( j=0; j<nr; j++ ){
+    int
+      *c_j = ( j == 0 ? c_0_vreg.i : j == 1 ? c_1_vreg.i : j == 2 ? c_2_vreg.i : c_3_vreg.i );
+    int
+      zb = ( q->zero_b ? q->zero_b[ col+j ] : 0 );
+
+    for ( i=0; i<mr; i++ ){
+      int
+        za = ( q->zero_a ? q->zero_a[ row+i ] : 0 );
+      long
+        acc = (long) c_j[ i ] - (long) zb * sumA[ i ] - (long) za * sumB[ j ] + (long) k * za * zb;
+
+      C( i,j ) += q->scale_a[ row+i ] * q->scale_b[ col+j ] * (float) acc;
+    }
+  }
+}
@@ -0,0 +1,190 @@
+/* Single-precision version of MMult_4x4_vecreg_subblock_cache.c.
+   A float register holds twice as many elements as a double one, so the
+   micro-kernel computes an 8x4 block of C: with AVX one __m256 per column,
+   otherwise two __m128 per column. The edges of C are handled by zero
+   padding the packed panels and only writing back the valid part. */
+
+#include <stdlib.h>
+
+/* Create macros so that the matrices are stored in column-major order */
+
+#define A(i,j) a[ (j)*lda + (i) ]
+#define B(i,j) b[ (j)*ldb + (i) ]
+#define C(i,j) c[ (j)*ldc + (i) ]
+
+/* Block sizes */
+#define mc 256
+#define kc 256
+
+#define min( i, j ) ( (i)<(j) ? (i): (j) )
+
+/* Routine for computing C = A * B + C */
+
+void AddDot8x4_s( int, float *, float *, float *, int, int, int );
+void PackMatrixA_s( int, int, float *, int, float * );
+void PackMatrixB_s( int, int, float *, int, float * );
+void InnerKernel_s( int, int, int, float *, int, float *, int, float *, int,
+                    float *, float *, int );
+
+void MY_SMMult( int m, int n, int k, float *a, int lda,
+                                     float *b, int ldb,
+                                     float *c, int ldc )
+{
+  int i, p, pb, ib;
+  float
+    *packedA, *packedB;
+
+  /* Heap buffers, aligned for the vector loads of the packed A panels */
+  if ( posix_memalign( (void **) &packedA, 32, mc * kc * sizeof( float ) ) ||
+       posix_memalign( (void **) &packedB, 32, kc * ( n+3 ) * sizeof( float ) ) )
+    abort();
+
+  for ( p=0; p<k; p+=kc ){
+    pb = min( k-p, kc );
+    for ( i=0; i<m; i+=mc ){
+      ib = min( m-i, mc );
+      InnerKernel_s( ib, n, pb, &A( i,p ), lda, &B(p, 0 ), ldb, &C( i,0 ), ldc,
+                     packedA, packedB, i==0 );
+    }
+  }
+
+  free( packedA );
+  free( packedB );
+}
+
+void InnerKernel_s( int m, int n, int k, float *a, int lda,
+                                         float *b, int ldb,
+                                         float *c, int ldc,
+                    float *packedA, float *packedB, int first_time )
+{
+  int i, j;
+
+  for ( j=0; j<n; j+=4 ){        /* Loop over the columns of C, unrolled by 4 */
+    if ( first_time )
+      PackMatrixB_s( k, min( n-j, 4 ), &B( 0, j ), ldb, &packedB[ j*k ] );
+    for ( i=0; i<m; i+=8 ){        /* Loop over the rows of C, unrolled by 8 */
+      if ( j == 0 )
+        PackMatrixA_s( k, min( m-i, 8 ), &A( i, 0 ), lda, &packedA[ i*k ] );
+      AddDot8x4_s( k, &packedA[ i*k ], &packedB[ j*k ], &C( i,j ), ldc,
+                   min( m-i, 8 ), min( n-j, 4 ) );
+    }
+  }
+}
+
+void PackMatrixA_s( int k, int mr, float *a, int lda, float *a_to )
+{
+  int i, j;
+
+  for( j=0; j<k; j++){  /* loop over columns of A */
+    float
+      *a_ij_pntr = &A( 0, j );
+
+    for ( i=0; i<8; i++ )
+      *a_to++ = ( i < mr ? a_ij_pntr[ i ] : 0.0f );
+  }
+}
+
+void PackMatrixB_s( int k, int nr, float *b, int ldb, float *b_to )
+{
+  int i, j;
+
+  for( i=0; i<k; i++){  /* loop over rows of B */
+    for ( j=0; j<4; j++ )
+      *b_to++ = ( j < nr ? B( i, j ) : 0.0f );
+  }
+}
+
+#include <immintrin.h>
+
+#ifdef __AVX__
+typedef union
+{
+  __m256 v;
+  float f[8];
+} v8sf_t;
+#else
+typedef union
+{
+  __m128 v;
+  float f[4];
+} v4sf_t;
+#endif
+
+void AddDot8x4_s( int k, float *a, float *b, float *c, int ldc, int mr, int nr )
+{
+  /* So, this routine computes an 8x4 block of matrix C, of which only the
+     first mr rows and nr columns are written back to c.
+     a points to a packed 8 x k panel of A and b to a packed k x 4 panel of B */
+
+  int p, i;
+
+#ifdef __AVX__
+  v8sf_t
+    c_0_vreg, c_1_vreg, c_2_vreg, c_3_vreg,
+    a_p_vreg;
+
+  c_0_vreg.v = _mm256_setzero_ps();
+  c_1_vreg.v = _mm256_setzero_ps();
+  c_2_vreg.v = _mm256_setzero_ps();
+  c_3_vreg.v = _mm256_setzero_ps();
+
+  for ( p=0; p<k; p++ ){
+    a_p_vreg.v = _mm256_load_ps( a );
+    a += 8;
+
+    c_0_vreg.v += a_p_vreg.v * _mm256_broadcast_ss( b );     /* broadcast b( p,0 ) */
+    c_1_vreg.v += a_p_vreg.v * _mm256_broadcast_ss( b+1 );   /* broadcast b( p,1 ) */
+    c_2_vreg.v += a_p_vreg.v * _mm256_broadcast_ss( b+2 );   /* broadcast b( p,2 ) */
+    c_3_vreg.v += a_p_vreg.v * _mm256_broadcast_ss( b+3 );   /* broadcast b( p,3 ) */
+    b += 4;
+  }
+
+  for ( i=0; i<mr; i++ ){
+    C( i, 0 ) += c_0_vreg.f[ i ];
+    if ( nr > 1 ) C( i, 1 ) += c_1_vreg.f[ i ];
+    if ( nr > 2 ) C( i, 2 ) += c_2_vreg.f[ i ];
+    if ( nr > 3 ) C( i, 3 ) += c_3_vreg.f[ i ];
+  }
+#else
+  v4sf_t
+    c_0_hi_vreg, c_1_hi_vreg, c_2_hi_vreg, c_3_hi_vreg,
+    c_0_lo_vreg, c_1_lo_vreg, c_2_lo_vreg, c_3_lo_vreg,
+    a_p_hi_vreg, a_p_lo_vreg,
+    b_p_vreg;
+
+  c_0_hi_vreg.v = _mm_setzero_ps();  c_0_lo_vreg.v = _mm_setzero_ps();
+  c_1_hi_vreg.v = _mm_setzero_ps();  c_1_lo_vreg.v = _mm_setzero_ps();
+  c_2_hi_vreg.v = _mm_setzero_ps();  c_2_lo_vreg.v = _mm_setzero_ps();
+  c_3_hi_vreg.v = _mm_setzero_ps();  c_3_lo_vreg.v = _mm_setzero_ps();
+
+  for ( p=0; p<k; p++ ){
+    a_p_hi_vreg.v = _mm_load_ps( a );     /* rows 0-3 */
+    a_p_lo_vreg.v = _mm_load_ps( a+4 );   /* rows 4-7 */
+    a += 8;
+
+    b_p_vreg.v = _mm_load1_ps( b );       /* load and duplicate */
+    c_0_hi_vreg.v += a_p_hi_vreg.v * b_p_vreg.v;
+    c_0_lo_vreg.v += a_p_lo_vreg.v * b_p_vreg.v;
+
+    b_p_vreg.v = _mm_load1_ps( b+1 );
+    c_1_hi_vreg.v += a_p_hi_vreg.v * b_p_vreg.v;
+    c_1_lo_vreg.v += a_p_lo_vreg.v * b_p_vreg.v;
+
+    b_p_vreg.v = _mm_load1_ps( b+2 );
+    c_2_hi_vreg.v += a_p_hi_vreg.v * b_p_vreg.v;
+    c_2_lo_vreg.v += a_p_lo_vreg.v * b_p_vreg.v;
+
+    b_p_vreg.v = _mm_load1_ps( b+3 );
+    c_3_hi_vreg.v += a_p_hi_vreg.v * b_p_vreg.v;
+    c_3_lo_vreg.v += a_p_lo_vreg.v * b_p_vreg.v;
+    b += 4;
+  }
+
+  for ( i=0; i<mr; i++ ){
+    C( i, 0 ) += ( i < 4 ? c_0_hi_vreg.f[ i ] : c_0_lo_vreg.f[ i-4 ] );
+    if ( nr > 1 ) C( i, 1 ) += ( i < 4 ? c_1_hi_vreg.f[ i ] : c_1_lo_vreg.f[ i-4 ] );
+    if ( nr > 2 ) C( i, 2 ) += ( i < 4 ? c_2_hi_vreg.f[ i ] : c_2_lo_vreg.f[ i-4 ] );
+    if ( nr > 3 ) C( i, 3 ) += ( i < 4 ? c_3_hi_vreg.f[ i ] : c_3_lo_vreg.f[ i-4 ] );
+  }
+#endif
+}
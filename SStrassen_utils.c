@@ -0,0 +1,249 @@
+/**
+ * Single-precision versions of the Strassen_utils.c routines,
+ * used by the SGEMM Strassen engine in SStrassen.c.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+
+/* Create macros so that the matrices are stored in column-major order */
+#define A(i, j) a->arr[ (i)*a->size + (j) ]
+#define B(i, j) b->arr[ (i)*b->size + (j) ]
+#define C(i, j) c->arr[ (i)*c->size + (j) ]
+#define D(i, j) d->arr[ (i)*d->size + (j) ]
+#define R(i, j) r->arr[ (i)*r->size + (j) ]
+
+extern const int MIN_SIZE;    /* shared with Strassen_utils.c */
+
+typedef struct {
+    float *arr;
+    int size;
+} SMatrix;
+
+/**
+ * Allocate space for a new matrix
+ * @param size: size of the matrix
+ * @return: a newly allocated matrix
+ */
+SMatrix *make_smatrix(int size) {
+    SMatrix *new = malloc(sizeof(SMatrix));
+    new->size = size;
+    new->arr = (float *) malloc(size * size * sizeof(float));
+    return new;
+}
+
+/**
+ * Convert array to SMatrix struct
+ * @param a: 1D array that represents a 2D matrix
+ * @param size: size of the matrix
+ * @return: a newly allocated matrix
+ */
+SMatrix *to_smatrix(float *a, int size) {
+    SMatrix *new = malloc(sizeof(SMatrix));
+    new->size = size;
+    new->arr = a;
+    return new;
+}
+
+/**
+ * Free matrix array and struct
+ * @param a: input matrix
+ */
+void free_smatrix(SMatrix *a) {
+    free(a->arr);
+    free(a);
+}
+
+/**
+ * Print elements of matrix
+ * @param a: input matrix
+ */
+void print_smat(SMatrix *a) {
+    for (int i = 0; i < a->size; i++) {
+        for (int j = 0; j < a->size; j++) {
+            printf("%f\t", A(i, j));
+        }
+        printf("\n");
+    }
+    printf("\n");
+}
+
+/**
+ * Element-wise summation of SMatrix a and b
+ * @param a: input matrix a
+ * @param b: input matrix b
+ * @return: a newly allocated matrix
+ */
+SMatrix *sum_smatrix(SMatrix *a, SMatrix *b) {
+    SMatrix *c = make_smatrix(a->size);
+
+    for (int i = 0; i < c->size; i++) {
+        for (int j = 0; j < c->size; j++) {
+            C(i, j) = A(i, j) + B(i, j);
+        }
+    }
+
+    return c;
+}
+
+/**
+ * Element-wise subtract SMatrix b from a
+ * @param a: input matrix a
+ * @param b: input matrix b
+ * @return: a newly allocated matrix
+ */
+SMatrix *subtract_smatrix(SMatrix *a, SMatrix *b) {
+    SMatrix *c = make_smatrix(a->size);
+
+    for (int i = 0; i < c->size; i++) {
+        for (int j = 0; j < c->size; j++) {
+            C(i, j) = A(i, j) - B(i, j);
+        }
+    }
+
+    return c;
+}
+
+/**
+ * Multiply SMatrix a and b
+ *  Only used for matrices of small size
+ * @param a: input matrix a
+ * @param b: input matrix b
+ * @return: a newly allocated matrix
+ */
+SMatrix *mult_smatrix(SMatrix *a, SMatrix *b) {
+    SMatrix *c = make_smatrix(a->size);
+
+    for (int i = 0; i < c->size; i++) {
+        for (int j = 0; j < c->size; j++) {
+            C(i, j) = 0.0;
+            for (int p = 0; p < c->size; p++) {
+                C(i, j) += A(i, p) * B(p, j);
+            }
+        }
+    }
+
+    return c;
+}
+
+/**
+ * According to Strassen algorithm, compute C11 block with SMatrix a, b, c, d
+ *  C11 = A + B - C + D
+ * @param a: input matrix a
+ * @param b: input matrix b
+ * @param c: input matrix c
+ * @param d: input matrix d
+ * @return: a newly allocated matrix
+ */
+SMatrix *compute_sc11(SMatrix *a, SMatrix *b, SMatrix *c, SMatrix *d) {
+    SMatrix *r = make_smatrix(a->size);
+
+    for (int i = 0; i < c->size; i++) {
+        for (int j = 0; j < c->size; j++) {
+            R(i, j) = A(i, j) + B(i, j) - C(i, j) + D(i, j);
+        }
+    }
+
+    return r;
+}
+
+/**
+ * According to Strassen algorithm, compute C22 block with SMatrix a, b, c, d
+ *  C22 = A - B + C + D
+ * @param a: input matrix a
+ * @param b: input matrix b
+ * @param c: input matrix c
+ * @param d: input matrix d
+ * @return: a newly allocated matrix
+ */
+SMatrix *compute_sc22(SMatrix *a, SMatrix *b, SMatrix *c, SMatrix *d) {
+    SMatrix *r = make_smatrix(a->size);
+
+    for (int i = 0; i < c->size; i++) {
+        for (int j = 0; j < c->size; j++) {
+            R(i, j) = A(i, j) - B(i, j) + C(i, j) + D(i, j);
+        }
+    }
+
+    return r;
+}
+
+/**
+ * Divide input matrix by half from start_row and start_col.
+ * Returns the divided matrix.
+ * @param a: input matrix a
+ * @param start_row: the index of the start row
+ * @param start_col: the index of the start column
+ * @return: a newly allocated matrix
+ */
+SMatrix *subdivide_s(SMatrix *a, int start_row, int start_col) {
+    int size = a->size / 2;
+
+    if (size < MIN_SIZE) {
+        printf("Trying to divide matrix smaller than MIN_SIZE = %d\n", MIN_SIZE);
+        exit(1);
+    }
+
+    SMatrix *new = malloc(sizeof(SMatrix));
+    new->size = size;
+    new->arr = (float *) malloc(size * size * sizeof(float));
+
+    int end_row = start_row + size;
+    int end_col = start_col + size;
+    int new_index = 0;
+    for (int i = start_row; i < end_row; i++) {
+        for (int j = start_col; j < end_col; j++) {
+            new->arr[new_index++] = A(i, j);
+        }
+    }
+    return new;
+}
+
+/**
+ * Merge four small matrices into a full matrix
+ * @param a: input matrix a
+ * @param b: input matrix b
+ * @param c: input matrix c
+ * @param d: input matrix d
+ * @return: a newly allocated merged matrix
+ */
+SMatrix *merge_s(SMatrix *a, SMatrix *b, SMatrix *c, SMatrix *d) {
+    int size = a->size * 2;
+    int half_size = size / 2;
+    SMatrix *r = malloc(sizeof(SMatrix));
+    r->size = size;
+    r->arr = (float *) malloc(size * size * sizeof(float));
+
+    // c11
+    int index = 0;
+    for (int i = 0; i < half_size; i++) {
+        for (int j = 0; j < half_size; j++) {
+            R(i, j) = a->arr[index++];
+        }
+    }
+
+    // c12
+    index = 0;
+    for (int i = 0; i < half_size; i++) {
+        for (int j = half_size; j < size; j++) {
+            R(i, j) = b->arr[index++];
+        }
+    }
+
+    // c21
+    index = 0;
+    for (int i = half_size; i < size; i++) {
+        for (int j = 0; j < half_size; j++) {
+            R(i, j) = c->arr[index++];
+        }
+    }
+
+    // c22
+    index = 0;
+    for (int i = half_size; i < size; i++) {
+        for (int j = half_size; j < size; j++) {
+            R(i, j) = d->arr[index++];
+        }
+    }
+
+    return r;
+}
\ No newline at end of file
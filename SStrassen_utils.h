@@ -0,0 +1,18 @@
+extern const int MIN_SIZE;
+
+typedef struct {
+    float *arr;
+    int size;
+} SMatrix;
+
+SMatrix *make_smatrix(int size);
+SMatrix *to_smatrix(float *a, int size);
+void free_smatrix(SMatrix *a);
+void print_smat(SMatrix *a);
+SMatrix *sum_smatrix(SMatrix *a, SMatrix *b);
+SMatrix *subtract_smatrix(SMatrix *a, SMatrix *b);
+SMatrix *mult_smatrix(SMatrix *a, SMatrix *b);
+SMatrix *compute_sc11(SMatrix *a, SMatrix *b, SMatrix *c, SMatrix *d);
+SMatrix *compute_sc22(SMatrix *a, SMatrix *b, SMatrix *c, SMatrix *d);
+SMatrix *subdivide_s(SMatrix *a, int start_row, int start_col);
+SMatrix *merge_s(SMatrix *a, SMatrix *b, SMatrix *c, SMatrix *d);
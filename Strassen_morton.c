@@ -0,0 +1,79 @@
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "Strassen_utils.h"
+
+/**
+ * Matrix multiplication with Strassen algorithm on matrices in Morton
+ * order (see to_morton). The quadrants of A and B are contiguous, so they
+ * are used in place instead of being sub-divided, and only the ten sums
+ * are allocated at every level.
+ * @param matrix_a: input matrix a, in Morton order
+ * @param matrix_b: input matrix b, in Morton order
+ * @return: a newly allocated resulting matrix, in Morton order
+ */
+Matrix *Strassen_morton_MMult(Matrix *matrix_a, Matrix *matrix_b) {
+    int size = matrix_a->size;
+
+    // Base case: a tile, stored row-major
+    if (size <= MIN_SIZE) {
+        return mult_matrix(matrix_a, matrix_b);
+    }
+
+    // The quadrants used on their own, without copies
+    Matrix a11 = morton_quadrant(matrix_a, 0), a22 = morton_quadrant(matrix_a, 3);
+    Matrix b11 = morton_quadrant(matrix_b, 0), b22 = morton_quadrant(matrix_b, 3);
+
+    // add and subtract matrix a and b, in one pass over each:
+    //  a11 + a22, a21 + a22, a11 + a12, a21 - a11, a12 - a22
+    //  b11 + b22, b12 - b22, b21 - b11, b11 + b12, b21 + b22
+    Matrix *sa[5], *sb[5], *p[7];
+    split_sums_morton(MATRIX_SPLIT_A, matrix_a, sa);
+    split_sums_morton(MATRIX_SPLIT_B, matrix_b, sb);
+
+    // Relation recursion
+    p[0] = Strassen_morton_MMult(sa[0], sb[0]);
+    p[1] = Strassen_morton_MMult(sa[1], &b11);
+    p[2] = Strassen_morton_MMult(&a11, sb[1]);
+    p[3] = Strassen_morton_MMult(&a22, sb[2]);
+    p[4] = Strassen_morton_MMult(sa[2], &b22);
+    p[5] = Strassen_morton_MMult(sa[3], sb[3]);
+    p[6] = Strassen_morton_MMult(sa[4], sb[4]);
+
+    // free intermediate matrices
+    for (int i = 0; i < 5; i++) {
+        free_matrix(sa[i]);
+        free_matrix(sb[i]);
+    }
+
+    // Merge: c11 = p1 + p4 - p5 + p7, c12 = p3 + p5, c21 = p2 + p4,
+    // c22 = p1 - p2 + p3 + p6, written into consecutive quarters
+    Matrix *r = merge_products_morton(p);
+
+    for (int i = 0; i < 7; i++) {
+        free_matrix(p[i]);
+    }
+
+    return r;
+}
+
+void MY_MMult(int m, int n, int k, double *a, int lda,
+              double *b, int ldb,
+              double *c_r, int ldc) {
+    if (m != n || n != k) {
+        fprintf(stderr, "Strassen_morton multiplies square matrices, not %dx%d by %dx%d\n", m, k, k, n);
+        exit(1);
+    }
+
+    // Matrix is row-major, so it sees the column-major A and B as their
+    // transposes: multiply B^T A^T = (AB)^T, which is AB in column-major order
+    Matrix *matrix_a = to_morton(b, ldb, m);
+    Matrix *matrix_b = to_morton(a, lda, m);
+    Matrix *c = Strassen_morton_MMult(matrix_a, matrix_b);
+
+    from_morton_add(c, c_r, ldc);
+
+    free_matrix(matrix_a);
+    free_matrix(matrix_b);
+    free_matrix(c);
+}
@@ -1,16 +1,20 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <pthread.h>
+#include <unistd.h>
 
 #include "Strassen_utils.h"
+#include "threads.h"
+#include "trace.h"
 
-#define SiC(i, j) si->c->arr[ (i)*si->c->size + (j) ]
+#define SiC(i, j) si->c->arr[ (i)*si->c->stride + (j) ]
 
 typedef struct {
     Matrix *a;
     Matrix *b;
     Matrix *c;
     int isFirst;
+    int index;                      /* 1..7 for p1..p7, 0 for the whole product */
 } StrassenInput;
 
 /**
@@ -26,6 +30,7 @@ StrassenInput *make_strassen_input(Matrix *a, Matrix *b, uint isFirst) {
     new->a = a;
     new->b = b;
     new->isFirst = isFirst;
+    new->index = 0;
     return new;
 }
 
@@ -44,10 +49,47 @@ void free_strassen_inputs(StrassenInput **si) {
     free(si);
 }
 
+/**
+ * Number of threads the first level of recursion asks the budget of
+ * threads.c for: STRASSEN_THREADS if set, else the number of processors
+ * @return: number of threads
+ */
+static int strassen_threads() {
+    char *env = getenv("STRASSEN_THREADS");
+    int threads = env ? atoi(env) : (int) sysconf(_SC_NPROCESSORS_ONLN);
+
+    return threads > 0 ? threads : 1;
+}
+
+void *Strassen_MMult_Threading(void *);
+
+typedef struct {
+    StrassenInput **si;
+    int first;
+    int step;
+} ProductRun;
+
+/**
+ * Thread function: products first, first + step, ... of the seven
+ * @param arg: ProductRun
+ * @return: NULL
+ */
+static void *run_products(void *arg) {
+    ProductRun *run = arg;
+
+    for (int i = run->first; i < 7; i += run->step)
+        Strassen_MMult_Threading(run->si[i]);
+    return NULL;
+}
+
 /**
  * Matrix multiplication with Strassen algorithm.
  * Multi-threading is used in the first level of recursion for parallelization
- * and is avoided further to prevent generating too many threads.
+ * and is avoided further to prevent generating too many threads. At that
+ * level the sub-division and the merge are also split over threads, and
+ * the seven products over up to seven of them, as many as the budget of
+ * threads.c grants: with the processors busy with other calls, this one
+ * runs on its own thread.
  * @param s: strassen input
  * @return: NULL
  */
@@ -56,55 +98,65 @@ void *Strassen_MMult_Threading(void *s) {
     Matrix *matrix_b = ((StrassenInput *) s)->b;
 
     int size = matrix_a->size;
+    int threads = 1;
+    int i;
+    TRACE_BEGIN(t_node);
     // Base case when the size of the matrix is small enough
     if (size <= MIN_SIZE) {
         ((StrassenInput *) s)->c = mult_matrix(matrix_a, matrix_b);
+        TRACE_END(t_node, strassen_nodes[((StrassenInput *) s)->index], "size", size);
         return NULL;
     }
 
-    // Sub-divide matrices A and B
-    Matrix *a11 = subdivide(matrix_a, 0, 0);
-    Matrix *a12 = subdivide(matrix_a, 0, size / 2);
-    Matrix *a21 = subdivide(matrix_a, size / 2, 0);
-    Matrix *a22 = subdivide(matrix_a, size / 2, size / 2);
-
-    Matrix *b11 = subdivide(matrix_b, 0, 0);
-    Matrix *b12 = subdivide(matrix_b, 0, size / 2);
-    Matrix *b21 = subdivide(matrix_b, size / 2, 0);
-    Matrix *b22 = subdivide(matrix_b, size / 2, size / 2);
-
-    // Add and subtract matrix a and b
-    Matrix *a11_p_a22 = sum_matrix(a11, a22);
-    Matrix *b11_p_b22 = sum_matrix(b11, b22);
-    Matrix *a21_p_a22 = sum_matrix(a21, a22);
-    Matrix *b12_s_b22 = subtract_matrix(b12, b22);
-    Matrix *b21_s_b11 = subtract_matrix(b21, b11);
-    Matrix *a11_p_a12 = sum_matrix(a11, a12);
-    Matrix *a21_s_a11 = subtract_matrix(a21, a11);
-    Matrix *b11_p_b12 = sum_matrix(b11, b12);
-    Matrix *a12_s_a22 = subtract_matrix(a12, a22);
-    Matrix *b21_p_b22 = sum_matrix(b21, b22);
+    if (((StrassenInput *) s)->isFirst)
+        threads = threads_acquire(strassen_threads());
+
+    // Sub-divide matrices A and B into the operands of the seven
+    // products, each computed in one pass over the quadrants
+    Matrix *a_parts[7], *b_parts[7], *p[7];
+    TRACE_BEGIN(t_split);
+    if (((StrassenInput *) s)->isFirst) {
+        // Same as split_operands, with the rows spread over threads
+        for (i = 0; i < 7; i++) {
+            a_parts[i] = make_matrix(size / 2);
+            b_parts[i] = make_matrix(size / 2);
+        }
+        MatrixOp split_ops[2] = {
+                split_op(MATRIX_SPLIT_A, matrix_a, a_parts),
+                split_op(MATRIX_SPLIT_B, matrix_b, b_parts),
+        };
+        run_matrix_ops(split_ops, 2, threads);
+    } else {
+        split_operands(MATRIX_SPLIT_A, matrix_a, a_parts);
+        split_operands(MATRIX_SPLIT_B, matrix_b, b_parts);
+    }
+    TRACE_END(t_split, "split", "size", size);
 
     // Relation recursion with multi threading
     StrassenInput **si = malloc(7 * sizeof(StrassenInput *));
-    si[0] = make_strassen_input(a11_p_a22, b11_p_b22, 0);
-    si[1] = make_strassen_input(b11, a21_p_a22, 0);
-    si[2] = make_strassen_input(a11, b12_s_b22, 0);
-    si[3] = make_strassen_input(a22, b21_s_b11, 0);
-    si[4] = make_strassen_input(a11_p_a12, b22, 0);
-    si[5] = make_strassen_input(a21_s_a11, b11_p_b12, 0);
-    si[6] = make_strassen_input(a12_s_a22, b21_p_b22, 0);
+    for (i = 0; i < 7; i++) {
+        si[i] = make_strassen_input(a_parts[i], b_parts[i], 0);
+        si[i]->index = i + 1;
+    }
 
-    int i;
-    if (((StrassenInput *) s)->isFirst) {
+    if (((StrassenInput *) s)->isFirst && threads > 1) {
+        // The calling thread takes the products of run 0 itself
+        int workers = threads < 7 ? threads : 7;
         pthread_t strassen_thread[7];
-        for (i = 0; i < 7; i++) {
-            if (pthread_create(&strassen_thread[i], NULL, Strassen_MMult_Threading, si[i])) {
+        ProductRun runs[7];
+        for (i = 0; i < workers; i++) {
+            runs[i].si = si;
+            runs[i].first = i;
+            runs[i].step = workers;
+        }
+        for (i = 1; i < workers; i++) {
+            if (pthread_create(&strassen_thread[i], NULL, run_products, &runs[i])) {
                 fprintf(stderr, "Error creating thread %d\n", i);
                 exit(1);
             }
         }
-        for (i = 0; i < 7; i++) {
+        run_products(&runs[0]);
+        for (i = 1; i < workers; i++) {
             if (pthread_join(strassen_thread[i], NULL)) {
                 fprintf(stderr, "Error joining thread %d\n", i);
                 exit(2);
@@ -116,58 +168,33 @@ void *Strassen_MMult_Threading(void *s) {
         }
     }
 
-    Matrix *p1 = si[0]->c;
-    Matrix *p2 = si[1]->c;
-    Matrix *p3 = si[2]->c;
-    Matrix *p4 = si[3]->c;
-    Matrix *p5 = si[4]->c;
-    Matrix *p6 = si[5]->c;
-    Matrix *p7 = si[6]->c;
-
     // Free intermediate matrices
-    free_matrix(a11);
-    free_matrix(a12);
-    free_matrix(a21);
-    free_matrix(a22);
-    free_matrix(b11);
-    free_matrix(b12);
-    free_matrix(b21);
-    free_matrix(b22);
-
-    free_matrix(a11_p_a22);
-    free_matrix(b11_p_b22);
-    free_matrix(a21_p_a22);
-    free_matrix(b12_s_b22);
-    free_matrix(b21_s_b11);
-    free_matrix(a11_p_a12);
-    free_matrix(a21_s_a11);
-    free_matrix(b11_p_b12);
-    free_matrix(a12_s_a22);
-    free_matrix(b21_p_b22);
-
+    for (i = 0; i < 7; i++) {
+        p[i] = si[i]->c;
+        free_matrix(a_parts[i]);
+        free_matrix(b_parts[i]);
+    }
     free_strassen_inputs(si);
 
-    // Merge
-    Matrix *c11 = compute_c11(p1, p4, p5, p7);
-    Matrix *c12 = sum_matrix(p3, p5);
-    Matrix *c21 = sum_matrix(p2, p4);
-    Matrix *c22 = compute_c22(p1, p2, p3, p6);
-
-    free_matrix(p1);
-    free_matrix(p2);
-    free_matrix(p3);
-    free_matrix(p4);
-    free_matrix(p5);
-    free_matrix(p6);
-    free_matrix(p7);
-
-    ((StrassenInput *) s)->c = merge(c11, c12, c21, c22);
+    // Merge: c11 = p1 + p4 - p5 + p7, c12 = p3 + p5, c21 = p2 + p4,
+    // c22 = p1 - p2 + p3 + p6
+    TRACE_BEGIN(t_merge);
+    if (((StrassenInput *) s)->isFirst) {
+        ((StrassenInput *) s)->c = make_matrix(size);
+        MatrixOp merge_ops[1] = {merge_op(((StrassenInput *) s)->c, p)};
+        run_matrix_ops(merge_ops, 1, threads);
+    } else {
+        ((StrassenInput *) s)->c = merge_products(p);
+    }
+    TRACE_END(t_merge, "merge", "size", size);
 
-    free_matrix(c11);
-    free_matrix(c12);
-    free_matrix(c21);
-    free_matrix(c22);
+    for (i = 0; i < 7; i++) {
+        free_matrix(p[i]);
+    }
+    if (((StrassenInput *) s)->isFirst)
+        threads_release();
 
+    TRACE_END(t_node, strassen_nodes[((StrassenInput *) s)->index], "size", size);
     return NULL;
 }
 
@@ -175,18 +202,24 @@ void MY_MMult(int m, int n, int k, double *a, int lda,
               double *b, int ldb,
               double *c_r, int ldc) {
 
-    Matrix *matrix_a = to_matrix(a, lda);
-    Matrix *matrix_b = to_matrix(b, ldb);
+    Matrix *matrix_a = to_matrix(a, m, lda);
+    Matrix *matrix_b = to_matrix(b, m, ldb);
 
-    StrassenInput *si = make_strassen_input(matrix_a, matrix_b, 1);
+    // Matrix is row-major, so it sees the column-major A and B as their
+    // transposes: multiply B^T A^T = (AB)^T, which is AB in column-major order
+    StrassenInput *si = make_strassen_input(matrix_b, matrix_a, 1);
     Strassen_MMult_Threading(si);
 
     // Convert Matrix to array
     for (int i = 0; i < si->c->size; i++) {
         for (int j = 0; j < si->c->size; j++) {
-            c_r[i * ldc + j] = SiC(i, j);
+            c_r[i * ldc + j] += SiC(i, j);
         }
     }
 
+    // The operands only wrap the arrays of the caller
+    free(matrix_a);
+    free(matrix_b);
+    free_matrix(si->c);
     free(si);
 }
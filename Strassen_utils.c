@@ -1,41 +1,113 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "Strassen_utils.h"
+#include "trace.h"
+#include "utils.h"
 
 /* Create macros so that the matrices are stored in column-major order */
-#define A(i, j) a->arr[ (i)*a->size + (j) ]
-#define B(i, j) b->arr[ (i)*b->size + (j) ]
-#define C(i, j) c->arr[ (i)*c->size + (j) ]
-#define D(i, j) d->arr[ (i)*d->size + (j) ]
-#define R(i, j) r->arr[ (i)*r->size + (j) ]
+#define A(i, j) a->arr[ (i)*a->stride + (j) ]
+#define B(i, j) b->arr[ (i)*b->stride + (j) ]
+#define C(i, j) c->arr[ (i)*c->stride + (j) ]
+#define D(i, j) d->arr[ (i)*d->stride + (j) ]
+#define R(i, j) r->arr[ (i)*r->stride + (j) ]
+
+/*
+ * Vectors for the element-wise kernels: the widest the compiler is allowed
+ * to use (add -mavx2 or -mavx512f to CFLAGS), SSE2 otherwise.
+ */
+#if defined(__AVX512F__)
+#include <immintrin.h>
+typedef __m512d vec_t;
+#define VEC_WIDTH 8
+#define VLOAD(p) _mm512_loadu_pd(p)
+#define VSTORE(p, v) _mm512_storeu_pd(p, v)
+#define VSTREAM(p, v) _mm512_stream_pd(p, v)
+#define VADD(x, y) _mm512_add_pd(x, y)
+#define VSUB(x, y) _mm512_sub_pd(x, y)
+#elif defined(__AVX__)
+#include <immintrin.h>
+typedef __m256d vec_t;
+#define VEC_WIDTH 4
+#define VLOAD(p) _mm256_loadu_pd(p)
+#define VSTORE(p, v) _mm256_storeu_pd(p, v)
+#define VSTREAM(p, v) _mm256_stream_pd(p, v)
+#define VADD(x, y) _mm256_add_pd(x, y)
+#define VSUB(x, y) _mm256_sub_pd(x, y)
+#else
+#include <emmintrin.h>
+typedef __m128d vec_t;
+#define VEC_WIDTH 2
+#define VLOAD(p) _mm_loadu_pd(p)
+#define VSTORE(p, v) _mm_storeu_pd(p, v)
+#define VSTREAM(p, v) _mm_stream_pd(p, v)
+#define VADD(x, y) _mm_add_pd(x, y)
+#define VSUB(x, y) _mm_sub_pd(x, y)
+#endif
+
+/* Store a vector, bypassing the caches when stream is set */
+#define STORE(p, v) do { if (stream) VSTREAM(p, v); else VSTORE(p, v); } while (0)
+
+/*
+ * Results of at least this many bytes are written with non-temporal stores:
+ * they do not fit in the cache anyway, and streaming them saves reading
+ * every line before it is overwritten.
+ */
+#define STREAM_MIN_BYTES (4 * 1024 * 1024)
+
+/* Matrices are aligned for the widest vector stores */
+#define MATRIX_ALIGN 64
 
 const int MIN_SIZE = 8;
 
-typedef struct {
-    double *arr;
-    int size;
-} Matrix;
+const char *strassen_nodes[8] = {"Strassen", "P1", "P2", "P3", "P4", "P5", "P6", "P7"};
 
 /**
- * Allocate space for a new matrix
- * @param size: size of the matrix
- * @return: a newly allocated matrix
+ * Allocate space for a new matrix with the given distance between rows
  */
-Matrix *make_matrix(int size) {
+static Matrix *make_strided(int size, int stride) {
     Matrix *new = malloc(sizeof(Matrix));
     new->size = size;
-    new->arr = (double *) malloc(size * size * sizeof(double));
+    new->stride = stride;
+    if (posix_memalign((void **) &new->arr, MATRIX_ALIGN, (size_t) size * stride * sizeof(double))) {
+        fprintf(stderr, "Cannot allocate a %dx%d matrix\n", size, size);
+        exit(1);
+    }
     return new;
 }
 
+/**
+ * Allocate space for a new matrix. Its rows are padded (see PADDED_LD) so
+ * that the power-of-two sizes of the recursion do not put the elements of
+ * a column in the same cache sets.
+ * @param size: size of the matrix
+ * @return: a newly allocated matrix
+ */
+Matrix *make_matrix(int size) {
+    return make_strided(size, PADDED_LD(size));
+}
+
+/**
+ * Allocate space for a new matrix whose rows are contiguous, as the Morton
+ * layout and the tiles need
+ */
+static Matrix *make_dense(int size) {
+    return make_strided(size, size);
+}
+
 /**
  * Convert array to Matrix struct
  * @param a: 1D array that represents a 2D matrix
  * @param size: size of the matrix
+ * @param stride: distance between its rows
  * @return: a newly allocated matrix
  */
-Matrix *to_matrix(double *a, int size) {
+Matrix *to_matrix(double *a, int size, int stride) {
     Matrix *new = malloc(sizeof(Matrix));
     new->size = size;
+    new->stride = stride;
     new->arr = a;
     return new;
 }
@@ -63,6 +135,76 @@ void print_mat(Matrix *a) {
     printf("\n");
 }
 
+/*
+ * Loop of an element-wise kernel: vectors first, then the elements left
+ * over, with j and count in scope
+ */
+#define ELEMENTWISE(vector, scalar) \
+    for (; j + VEC_WIDTH <= count; j += VEC_WIDTH) \
+        STORE(r + j, vector); \
+    for (; j < count; j++) \
+        r[j] = scalar;
+
+/**
+ * Element-wise kernel on contiguous arrays. The arguments are restrict,
+ * so the results are computed from vectors loaded once per element.
+ * @param kind: MATRIX_COPY, MATRIX_SUM, MATRIX_SUBTRACT, MATRIX_C11 or MATRIX_C22
+ * @param count: number of elements
+ * @param r: result
+ * @param a, b, c, d: operands, as many as the kind takes
+ * @param stream: write the result with non-temporal stores
+ */
+static void combine(int kind, long count, double *restrict r,
+                    const double *restrict a, const double *restrict b,
+                    const double *restrict c, const double *restrict d, int stream) {
+    long j = 0;
+
+    stream = stream && (uintptr_t) r % (VEC_WIDTH * sizeof(double)) == 0;
+    switch (kind) {
+        case MATRIX_COPY:
+            ELEMENTWISE(VLOAD(a + j), a[j]);
+            break;
+        case MATRIX_SUM:
+            ELEMENTWISE(VADD(VLOAD(a + j), VLOAD(b + j)), a[j] + b[j]);
+            break;
+        case MATRIX_SUBTRACT:
+            ELEMENTWISE(VSUB(VLOAD(a + j), VLOAD(b + j)), a[j] - b[j]);
+            break;
+        case MATRIX_C11:
+            ELEMENTWISE(VADD(VSUB(VADD(VLOAD(a + j), VLOAD(b + j)), VLOAD(c + j)), VLOAD(d + j)),
+                        a[j] + b[j] - c[j] + d[j]);
+            break;
+        case MATRIX_C22:
+            ELEMENTWISE(VADD(VADD(VSUB(VLOAD(a + j), VLOAD(b + j)), VLOAD(c + j)), VLOAD(d + j)),
+                        a[j] - b[j] + c[j] + d[j]);
+            break;
+    }
+    if (stream)
+        _mm_sfence();
+}
+
+/**
+ * Whether a result of size x size should be written with non-temporal stores
+ */
+static int stream_result(int size) {
+    return (size_t) size * size * sizeof(double) >= STREAM_MIN_BYTES;
+}
+
+/**
+ * Element-wise kernel on whole matrices, row by row
+ * @param kind: MATRIX_SUM, MATRIX_SUBTRACT, MATRIX_C11 or MATRIX_C22
+ * @param r: result
+ * @param a, b, c, d: operands, as many as the kind takes
+ */
+static void combine_matrices(int kind, Matrix *r, Matrix *a, Matrix *b, Matrix *c, Matrix *d) {
+    int stream = stream_result(r->size);
+
+    for (int i = 0; i < r->size; i++) {
+        combine(kind, r->size, &R(i, 0), &A(i, 0), &B(i, 0),
+                c ? &C(i, 0) : NULL, d ? &D(i, 0) : NULL, stream);
+    }
+}
+
 /**
  * Element-wise summation of Matrix a and b
  * @param a: input matrix a
@@ -72,11 +214,7 @@ void print_mat(Matrix *a) {
 Matrix *sum_matrix(Matrix *a, Matrix *b) {
     Matrix *c = make_matrix(a->size);
 
-    for (int i = 0; i < c->size; i++) {
-        for (int j = 0; j < c->size; j++) {
-            C(i, j) = A(i, j) + B(i, j);
-        }
-    }
+    combine_matrices(MATRIX_SUM, c, a, b, NULL, NULL);
 
     return c;
 }
@@ -90,11 +228,7 @@ Matrix *sum_matrix(Matrix *a, Matrix *b) {
 Matrix *subtract_matrix(Matrix *a, Matrix *b) {
     Matrix *c = make_matrix(a->size);
 
-    for (int i = 0; i < c->size; i++) {
-        for (int j = 0; j < c->size; j++) {
-            C(i, j) = A(i, j) - B(i, j);
-        }
-    }
+    combine_matrices(MATRIX_SUBTRACT, c, a, b, NULL, NULL);
 
     return c;
 }
@@ -107,10 +241,11 @@ Matrix *subtract_matrix(Matrix *a, Matrix *b) {
  * @return: a newly allocated matrix
  */
 Matrix *mult_matrix(Matrix *a, Matrix *b) {
-    Matrix *c = make_matrix(a->size);
+    Matrix *c = make_dense(a->size);
 
     for (int i = 0; i < c->size; i++) {
         for (int j = 0; j < c->size; j++) {
+            C(i, j) = 0.0;
             for (int p = 0; p < c->size; p++) {
                 C(i, j) += A(i, p) * B(p, j);
             }
@@ -132,11 +267,7 @@ Matrix *mult_matrix(Matrix *a, Matrix *b) {
 Matrix *compute_c11(Matrix *a, Matrix *b, Matrix *c, Matrix *d) {
     Matrix *r = make_matrix(a->size);
 
-    for (int i = 0; i < c->size; i++) {
-        for (int j = 0; j < c->size; j++) {
-            R(i, j) = A(i, j) + B(i, j) - C(i, j) + D(i, j);
-        }
-    }
+    combine_matrices(MATRIX_C11, r, a, b, c, d);
 
     return r;
 }
@@ -153,11 +284,7 @@ Matrix *compute_c11(Matrix *a, Matrix *b, Matrix *c, Matrix *d) {
 Matrix *compute_c22(Matrix *a, Matrix *b, Matrix *c, Matrix *d) {
     Matrix *r = make_matrix(a->size);
 
-    for (int i = 0; i < c->size; i++) {
-        for (int j = 0; j < c->size; j++) {
-            R(i, j) = A(i, j) - B(i, j) + C(i, j) + D(i, j);
-        }
-    }
+    combine_matrices(MATRIX_C22, r, a, b, c, d);
 
     return r;
 }
@@ -178,17 +305,11 @@ Matrix *subdivide(Matrix *a, int start_row, int start_col) {
         exit(1);
     }
 
-    Matrix *new = malloc(sizeof(Matrix));
-    new->size = size;
-    new->arr = (double *) malloc(size * size * sizeof(double));
-
-    int end_row = start_row + size;
-    int end_col = start_col + size;
-    int new_index = 0;
-    for (int i = start_row; i < end_row; i++) {
-        for (int j = start_col; j < end_col; j++) {
-            new->arr[new_index++] = A(i, j);
-        }
+    Matrix *new = make_matrix(size);
+
+    for (int i = 0; i < size; i++) {
+        combine(MATRIX_COPY, size, &new->arr[i * new->stride], &A(start_row + i, start_col),
+                NULL, NULL, NULL, stream_result(size));
     }
     return new;
 }
@@ -202,43 +323,502 @@ Matrix *subdivide(Matrix *a, int start_row, int start_col) {
  * @return: a newly allocated merged matrix
  */
 Matrix *merge(Matrix *a, Matrix *b, Matrix *c, Matrix *d) {
-    int size = a->size * 2;
-    int half_size = size / 2;
-    Matrix *r = malloc(sizeof(Matrix));
-    r->size = size;
-    r->arr = (double *) malloc(size * size * sizeof(double));
-
-    // c11
-    int index = 0;
+    int half_size = a->size;
+    Matrix *r = make_matrix(half_size * 2);
+    int stream = stream_result(r->size);
+
     for (int i = 0; i < half_size; i++) {
-        for (int j = 0; j < half_size; j++) {
-            R(i, j) = a->arr[index++];
-        }
+        // c11 and c12
+        combine(MATRIX_COPY, half_size, &R(i, 0), &A(i, 0), NULL, NULL, NULL, stream);
+        combine(MATRIX_COPY, half_size, &R(i, half_size), &B(i, 0), NULL, NULL, NULL, stream);
+        // c21 and c22
+        combine(MATRIX_COPY, half_size, &R(i + half_size, 0), &C(i, 0), NULL, NULL, NULL, stream);
+        combine(MATRIX_COPY, half_size, &R(i + half_size, half_size), &D(i, 0), NULL, NULL, NULL, stream);
     }
 
-    // c12
-    index = 0;
-    for (int i = 0; i < half_size; i++) {
-        for (int j = half_size; j < size; j++) {
-            R(i, j) = b->arr[index++];
+    return r;
+}
+
+/**
+ * Fused sub-division: rows row_start..row_end-1 of the seven operands of
+ * the Strassen products, read from the four quadrants of a in one pass.
+ * The operands of A are, in the order of the products p1..p7,
+ *  a11 + a22, a21 + a22, a11, a22, a11 + a12, a21 - a11, a12 - a22
+ * and those of B
+ *  b11 + b22, b11, b12 - b22, b21 - b11, b22, b11 + b12, b21 + b22
+ * @param kind: MATRIX_SPLIT_A or MATRIX_SPLIT_B
+ * @param a: matrix to split
+ * @param parts: the seven operands, of half the size of a
+ * @param stream: write them with non-temporal stores
+ */
+static void split_rows(int kind, Matrix *a, Matrix **parts, int row_start, int row_end, int stream) {
+    int h = a->size / 2;
+
+    // Every row of the operands starts on a vector when their stride allows
+    stream = stream && h % VEC_WIDTH == 0 && parts[0]->stride % VEC_WIDTH == 0;
+    for (int i = row_start; i < row_end; i++) {
+        const double *restrict q11 = &A(i, 0), *restrict q12 = &A(i, h);
+        const double *restrict q21 = &A(i + h, 0), *restrict q22 = &A(i + h, h);
+        long row = (long) i * parts[0]->stride;
+        double *restrict r0 = &parts[0]->arr[row], *restrict r1 = &parts[1]->arr[row];
+        double *restrict r2 = &parts[2]->arr[row], *restrict r3 = &parts[3]->arr[row];
+        double *restrict r4 = &parts[4]->arr[row], *restrict r5 = &parts[5]->arr[row];
+        double *restrict r6 = &parts[6]->arr[row];
+        int j = 0;
+
+        if (kind == MATRIX_SPLIT_A) {
+            for (; j + VEC_WIDTH <= h; j += VEC_WIDTH) {
+                vec_t x11 = VLOAD(q11 + j), x12 = VLOAD(q12 + j);
+                vec_t x21 = VLOAD(q21 + j), x22 = VLOAD(q22 + j);
+
+                STORE(r0 + j, VADD(x11, x22));
+                STORE(r1 + j, VADD(x21, x22));
+                STORE(r2 + j, x11);
+                STORE(r3 + j, x22);
+                STORE(r4 + j, VADD(x11, x12));
+                STORE(r5 + j, VSUB(x21, x11));
+                STORE(r6 + j, VSUB(x12, x22));
+            }
+            for (; j < h; j++) {
+                r0[j] = q11[j] + q22[j];
+                r1[j] = q21[j] + q22[j];
+                r2[j] = q11[j];
+                r3[j] = q22[j];
+                r4[j] = q11[j] + q12[j];
+                r5[j] = q21[j] - q11[j];
+                r6[j] = q12[j] - q22[j];
+            }
+        } else {
+            for (; j + VEC_WIDTH <= h; j += VEC_WIDTH) {
+                vec_t x11 = VLOAD(q11 + j), x12 = VLOAD(q12 + j);
+                vec_t x21 = VLOAD(q21 + j), x22 = VLOAD(q22 + j);
+
+                STORE(r0 + j, VADD(x11, x22));
+                STORE(r1 + j, x11);
+                STORE(r2 + j, VSUB(x12, x22));
+                STORE(r3 + j, VSUB(x21, x11));
+                STORE(r4 + j, x22);
+                STORE(r5 + j, VADD(x11, x12));
+                STORE(r6 + j, VADD(x21, x22));
+            }
+            for (; j < h; j++) {
+                r0[j] = q11[j] + q22[j];
+                r1[j] = q11[j];
+                r2[j] = q12[j] - q22[j];
+                r3[j] = q21[j] - q11[j];
+                r4[j] = q22[j];
+                r5[j] = q11[j] + q12[j];
+                r6[j] = q21[j] + q22[j];
+            }
         }
     }
+    if (stream)
+        _mm_sfence();
+}
 
-    // c21
-    index = 0;
-    for (int i = half_size; i < size; i++) {
-        for (int j = 0; j < half_size; j++) {
-            R(i, j) = c->arr[index++];
+/**
+ * Fused merge: rows row_start..row_end-1 of the four quadrants of r,
+ * computed from the seven Strassen products in one pass
+ *  c11 = p1 + p4 - p5 + p7, c12 = p3 + p5, c21 = p2 + p4, c22 = p1 - p2 + p3 + p6
+ * @param r: result, twice the size of the products
+ * @param p: the products p1..p7
+ * @param stream: write r with non-temporal stores
+ */
+static void merge_rows(Matrix *r, Matrix **p, int row_start, int row_end, int stream) {
+    int h = r->size / 2;
+
+    stream = stream && h % VEC_WIDTH == 0 && r->stride % VEC_WIDTH == 0;
+    for (int i = row_start; i < row_end; i++) {
+        const double *restrict p1 = &p[0]->arr[(long) i * p[0]->stride];
+        const double *restrict p2 = &p[1]->arr[(long) i * p[1]->stride];
+        const double *restrict p3 = &p[2]->arr[(long) i * p[2]->stride];
+        const double *restrict p4 = &p[3]->arr[(long) i * p[3]->stride];
+        const double *restrict p5 = &p[4]->arr[(long) i * p[4]->stride];
+        const double *restrict p6 = &p[5]->arr[(long) i * p[5]->stride];
+        const double *restrict p7 = &p[6]->arr[(long) i * p[6]->stride];
+        double *restrict c11 = &R(i, 0), *restrict c12 = &R(i, h);
+        double *restrict c21 = &R(i + h, 0), *restrict c22 = &R(i + h, h);
+        int j = 0;
+
+        for (; j + VEC_WIDTH <= h; j += VEC_WIDTH) {
+            vec_t x1 = VLOAD(p1 + j), x2 = VLOAD(p2 + j), x3 = VLOAD(p3 + j);
+            vec_t x4 = VLOAD(p4 + j), x5 = VLOAD(p5 + j);
+
+            STORE(c11 + j, VADD(VSUB(VADD(x1, x4), x5), VLOAD(p7 + j)));
+            STORE(c12 + j, VADD(x3, x5));
+            STORE(c21 + j, VADD(x2, x4));
+            STORE(c22 + j, VADD(VADD(VSUB(x1, x2), x3), VLOAD(p6 + j)));
+        }
+        for (; j < h; j++) {
+            c11[j] = p1[j] + p4[j] - p5[j] + p7[j];
+            c12[j] = p3[j] + p5[j];
+            c21[j] = p2[j] + p4[j];
+            c22[j] = p1[j] - p2[j] + p3[j] + p6[j];
         }
     }
+    if (stream)
+        _mm_sfence();
+}
+
+/**
+ * Allocate the seven operands of the Strassen products and compute them
+ * from the quadrants of a in one pass (see split_rows)
+ * @param kind: MATRIX_SPLIT_A for the left operand, MATRIX_SPLIT_B for the right one
+ * @param a: matrix to split
+ * @param parts: set to the seven newly allocated operands
+ */
+void split_operands(int kind, Matrix *a, Matrix **parts) {
+    int size = a->size / 2;
 
-    // c22
-    index = 0;
-    for (int i = half_size; i < size; i++) {
-        for (int j = half_size; j < size; j++) {
-            R(i, j) = d->arr[index++];
+    if (size < MIN_SIZE) {
+        printf("Trying to divide matrix smaller than MIN_SIZE = %d\n", MIN_SIZE);
+        exit(1);
+    }
+
+    for (int i = 0; i < 7; i++) {
+        parts[i] = make_matrix(size);
+    }
+    split_rows(kind, a, parts, 0, size, stream_result(a->size));
+}
+
+/**
+ * Combine the seven Strassen products into the full result in one pass
+ * (see merge_rows)
+ * @param p: the products p1..p7
+ * @return: a newly allocated merged matrix
+ */
+Matrix *merge_products(Matrix **p) {
+    Matrix *r = make_matrix(p[0]->size * 2);
+
+    merge_rows(r, p, 0, p[0]->size, stream_result(r->size));
+
+    return r;
+}
+
+/**
+ * Fused sums for a matrix in Morton order (see to_morton), where the
+ * quadrants are the four contiguous quarters of the array. Computes in
+ * one pass the five operands of the Strassen products that are not plain
+ * quadrants, in the order of the products:
+ *  A: a11 + a22, a21 + a22, a11 + a12, a21 - a11, a12 - a22
+ *  B: b11 + b22, b12 - b22, b21 - b11, b11 + b12, b21 + b22
+ * @param kind: MATRIX_SPLIT_A or MATRIX_SPLIT_B
+ * @param a: matrix in Morton order
+ * @param sums: set to the five newly allocated operands, in Morton order
+ */
+void split_sums_morton(int kind, Matrix *a, Matrix **sums) {
+    int size = a->size / 2;
+    long count = (long) size * size;
+    int stream = stream_result(a->size);
+
+    for (int i = 0; i < 5; i++) {
+        sums[i] = make_dense(size);
+    }
+
+    const double *restrict q11 = a->arr, *restrict q12 = a->arr + count;
+    const double *restrict q21 = a->arr + 2 * count, *restrict q22 = a->arr + 3 * count;
+    double *restrict r0 = sums[0]->arr, *restrict r1 = sums[1]->arr, *restrict r2 = sums[2]->arr;
+    double *restrict r3 = sums[3]->arr, *restrict r4 = sums[4]->arr;
+    long j = 0;
+
+    stream = stream && count % VEC_WIDTH == 0;
+    if (kind == MATRIX_SPLIT_A) {
+        for (; j + VEC_WIDTH <= count; j += VEC_WIDTH) {
+            vec_t x11 = VLOAD(q11 + j), x12 = VLOAD(q12 + j);
+            vec_t x21 = VLOAD(q21 + j), x22 = VLOAD(q22 + j);
+
+            STORE(r0 + j, VADD(x11, x22));
+            STORE(r1 + j, VADD(x21, x22));
+            STORE(r2 + j, VADD(x11, x12));
+            STORE(r3 + j, VSUB(x21, x11));
+            STORE(r4 + j, VSUB(x12, x22));
+        }
+        for (; j < count; j++) {
+            r0[j] = q11[j] + q22[j];
+            r1[j] = q21[j] + q22[j];
+            r2[j] = q11[j] + q12[j];
+            r3[j] = q21[j] - q11[j];
+            r4[j] = q12[j] - q22[j];
+        }
+    } else {
+        for (; j + VEC_WIDTH <= count; j += VEC_WIDTH) {
+            vec_t x11 = VLOAD(q11 + j), x12 = VLOAD(q12 + j);
+            vec_t x21 = VLOAD(q21 + j), x22 = VLOAD(q22 + j);
+
+            STORE(r0 + j, VADD(x11, x22));
+            STORE(r1 + j, VSUB(x12, x22));
+            STORE(r2 + j, VSUB(x21, x11));
+            STORE(r3 + j, VADD(x11, x12));
+            STORE(r4 + j, VADD(x21, x22));
+        }
+        for (; j < count; j++) {
+            r0[j] = q11[j] + q22[j];
+            r1[j] = q12[j] - q22[j];
+            r2[j] = q21[j] - q11[j];
+            r3[j] = q11[j] + q12[j];
+            r4[j] = q21[j] + q22[j];
         }
     }
+    if (stream)
+        _mm_sfence();
+}
+
+/**
+ * Combine the seven Strassen products, in Morton order, into the full
+ * result in Morton order: its quadrants are written one after the other
+ * @param p: the products p1..p7
+ * @return: a newly allocated matrix in Morton order
+ */
+Matrix *merge_products_morton(Matrix **p) {
+    int size = p[0]->size;
+    long count = (long) size * size;
+    Matrix *r = make_dense(size * 2);
+    int stream = stream_result(r->size);
+
+    combine(MATRIX_C11, count, r->arr, p[0]->arr, p[3]->arr, p[4]->arr, p[6]->arr, stream);
+    combine(MATRIX_SUM, count, r->arr + count, p[2]->arr, p[4]->arr, NULL, NULL, stream);
+    combine(MATRIX_SUM, count, r->arr + 2 * count, p[1]->arr, p[3]->arr, NULL, NULL, stream);
+    combine(MATRIX_C22, count, r->arr + 3 * count, p[0]->arr, p[1]->arr, p[2]->arr, p[5]->arr, stream);
 
     return r;
-}
\ No newline at end of file
+}
+
+/**
+ * View of quadrant q (0: 11, 1: 12, 2: 21, 3: 22) of a matrix in Morton
+ * order. The view shares the array of a and must not be freed.
+ * @param a: matrix in Morton order
+ * @param q: quadrant
+ * @return: the quadrant
+ */
+Matrix morton_quadrant(Matrix *a, int q) {
+    int size = a->size / 2;
+    Matrix view = {a->arr + (long) q * size * size, size, size};
+
+    return view;
+}
+
+/**
+ * Copy the size x size row-major block at a into z in Morton order
+ */
+static void pack_morton(const double *a, int lda, int size, double *z) {
+    if (size <= MIN_SIZE) {
+        // A tile: its rows are stored one after the other
+        for (int i = 0; i < size; i++) {
+            const double *restrict row = a + (long) i * lda;
+            double *restrict r = z + i * size;
+            int j = 0, count = size, stream = 0;
+
+            ELEMENTWISE(VLOAD(row + j), row[j]);
+        }
+        return;
+    }
+
+    int h = size / 2;
+    long count = (long) h * h;
+    pack_morton(a, lda, h, z);
+    pack_morton(a + h, lda, h, z + count);
+    pack_morton(a + (long) h * lda, lda, h, z + 2 * count);
+    pack_morton(a + (long) h * lda + h, lda, h, z + 3 * count);
+}
+
+/**
+ * Add z, in Morton order, to the size x size row-major block at c
+ */
+static void unpack_add_morton(const double *z, int size, double *c, int ldc) {
+    if (size <= MIN_SIZE) {
+        for (int i = 0; i < size; i++) {
+            const double *restrict row = z + i * size;
+            double *restrict r = c + (long) i * ldc;
+            int j = 0, count = size, stream = 0;
+
+            ELEMENTWISE(VADD(VLOAD(r + j), VLOAD(row + j)), r[j] + row[j]);
+        }
+        return;
+    }
+
+    int h = size / 2;
+    long count = (long) h * h;
+    unpack_add_morton(z, h, c, ldc);
+    unpack_add_morton(z + count, h, c + h, ldc);
+    unpack_add_morton(z + 2 * count, h, c + (long) h * ldc, ldc);
+    unpack_add_morton(z + 3 * count, h, c + (long) h * ldc + h, ldc);
+}
+
+/**
+ * Convert a row-major array to Morton (Z-order) layout: the quadrants 11,
+ * 12, 21 and 22 are stored one after the other, each in the same layout,
+ * down to tiles of MIN_SIZE x MIN_SIZE stored row by row. Every quadrant
+ * at every level of the recursion is then a contiguous Matrix.
+ * @param a: row-major array
+ * @param lda: distance between its rows
+ * @param size: size of the matrix, at most MIN_SIZE times a power of 2
+ * @return: a newly allocated matrix in Morton order
+ */
+Matrix *to_morton(double *a, int lda, int size) {
+    int tile = size;
+
+    while (tile > MIN_SIZE && tile % 2 == 0)
+        tile /= 2;
+    if (tile > MIN_SIZE) {
+        fprintf(stderr, "Cannot store a %dx%d matrix in Morton order\n", size, size);
+        exit(1);
+    }
+
+    Matrix *z = make_dense(size);
+    pack_morton(a, lda, size, z->arr);
+    return z;
+}
+
+/**
+ * Add a matrix in Morton order to a row-major array
+ * @param z: matrix in Morton order
+ * @param c: row-major array
+ * @param ldc: distance between its rows
+ */
+void from_morton_add(Matrix *z, double *c, int ldc) {
+    unpack_add_morton(z->arr, z->size, c, ldc);
+}
+
+/**
+ * Apply an operation to rows row_start..row_end-1 of its result.
+ * @param op: the operation
+ * @param row_start: first row
+ * @param row_end: one past the last row
+ */
+static void apply_op_rows(MatrixOp *op, int row_start, int row_end) {
+    int size = op->size;
+    int stream = stream_result(op->r ? op->r->size : op->a->size);
+
+    if (op->kind == MATRIX_SPLIT_A || op->kind == MATRIX_SPLIT_B) {
+        split_rows(op->kind, op->a, op->parts, row_start, row_end, stream);
+        return;
+    }
+    if (op->kind == MATRIX_MERGE) {
+        merge_rows(op->r, op->parts, row_start, row_end, stream);
+        return;
+    }
+
+    for (int i = row_start; i < row_end; i++) {
+        combine(op->kind, size,
+                &op->r->arr[(long) (i + op->r_row) * op->r->stride + op->r_col],
+                &op->a->arr[(long) (i + op->a_row) * op->a->stride + op->a_col],
+                op->b ? &op->b->arr[(long) i * op->b->stride] : NULL,
+                op->c ? &op->c->arr[(long) i * op->c->stride] : NULL,
+                op->d ? &op->d->arr[(long) i * op->d->stride] : NULL, stream);
+    }
+}
+
+typedef struct {
+    MatrixOp *ops;
+    int count;
+    int chunks;                     /* per operation */
+    int next;                       /* next chunk to take */
+    pthread_mutex_t lock;
+} OpQueue;
+
+/**
+ * Thread function: take chunks of rows from the queue until it is empty
+ * @param q: OpQueue
+ * @return: NULL
+ */
+static void *run_op_chunks(void *q) {
+    OpQueue *queue = (OpQueue *) q;
+    int done = 0;
+    TRACE_BEGIN(t_ops);
+
+    while (1) {
+        pthread_mutex_lock(&queue->lock);
+        int chunk = queue->next++;
+        pthread_mutex_unlock(&queue->lock);
+
+        if (chunk >= queue->count * queue->chunks) {
+            TRACE_END(t_ops, "run_matrix_ops", "chunks", done);
+            return NULL;
+        }
+
+        MatrixOp *op = &queue->ops[chunk / queue->chunks];
+        int part = chunk % queue->chunks;
+        apply_op_rows(op, (int) ((long) op->size * part / queue->chunks),
+                      (int) ((long) op->size * (part + 1) / queue->chunks));
+        done++;
+    }
+}
+
+/**
+ * Run independent operations on several threads. Every operation is cut
+ * into chunks of rows, so that the threads stay busy even when there are
+ * fewer operations than threads.
+ * @param ops: the operations, with their results already allocated
+ * @param count: number of operations
+ * @param threads: number of threads to use
+ */
+void run_matrix_ops(MatrixOp *ops, int count, int threads) {
+    OpQueue queue = {ops, count, threads > 1 ? 4 * threads / count + 1 : 1, 0};
+    pthread_t thread[threads];
+
+    pthread_mutex_init(&queue.lock, NULL);
+    for (int t = 1; t < threads; t++) {
+        if (pthread_create(&thread[t], NULL, run_op_chunks, &queue)) {
+            fprintf(stderr, "Error creating thread %d\n", t);
+            exit(1);
+        }
+    }
+    run_op_chunks(&queue);
+    for (int t = 1; t < threads; t++) {
+        if (pthread_join(thread[t], NULL)) {
+            fprintf(stderr, "Error joining thread %d\n", t);
+            exit(2);
+        }
+    }
+    pthread_mutex_destroy(&queue.lock);
+}
+
+/**
+ * Describe an element-wise operation on whole size x size matrices
+ * @param kind: MATRIX_SUM, MATRIX_SUBTRACT, MATRIX_C11 or MATRIX_C22
+ * @param r: result
+ * @param a, b, c, d: operands, c and d only for MATRIX_C11 and MATRIX_C22
+ * @return: the operation
+ */
+MatrixOp matrix_op(int kind, Matrix *r, Matrix *a, Matrix *b, Matrix *c, Matrix *d) {
+    MatrixOp op = {kind, a->size, r, a, b, c, d, NULL, 0, 0, 0, 0};
+
+    return op;
+}
+
+/**
+ * Describe the copy of a size x size block from (a_row, a_col) of a to
+ * (r_row, r_col) of r, as done by subdivide and merge
+ * @return: the operation
+ */
+MatrixOp copy_op(int size, Matrix *r, int r_row, int r_col, Matrix *a, int a_row, int a_col) {
+    MatrixOp op = {MATRIX_COPY, size, r, a, NULL, NULL, NULL, NULL, r_row, r_col, a_row, a_col};
+
+    return op;
+}
+
+/**
+ * Describe the fused sub-division of a into the seven operands of the
+ * Strassen products, see split_operands
+ * @param kind: MATRIX_SPLIT_A or MATRIX_SPLIT_B
+ * @param parts: the seven operands, already allocated
+ * @return: the operation
+ */
+MatrixOp split_op(int kind, Matrix *a, Matrix **parts) {
+    MatrixOp op = {kind, a->size / 2, NULL, a, NULL, NULL, NULL, parts, 0, 0, 0, 0};
+
+    return op;
+}
+
+/**
+ * Describe the fused merge of the seven Strassen products into r, see
+ * merge_products
+ * @param r: result, already allocated
+ * @param p: the products p1..p7
+ * @return: the operation
+ */
+MatrixOp merge_op(Matrix *r, Matrix **p) {
+    MatrixOp op = {MATRIX_MERGE, p[0]->size, r, NULL, NULL, NULL, NULL, p, 0, 0, 0, 0};
+
+    return op;
+}
@@ -1,12 +1,16 @@
-const int MIN_SIZE;
+extern const int MIN_SIZE;
+
+/* Names of the whole product and of p1..p7, for tracing */
+extern const char *strassen_nodes[8];
 
 typedef struct {
     double *arr;
     int size;
+    int stride;                     /* distance between rows, at least size */
 } Matrix;
 
 Matrix *make_matrix(int size);
-Matrix *to_matrix(double *a, int size);
+Matrix *to_matrix(double *a, int size, int stride);
 void free_matrix(Matrix *a);
 void print_mat(Matrix *a);
 Matrix *sum_matrix(Matrix *a, Matrix *b);
@@ -17,3 +21,39 @@ Matrix *compute_c22(Matrix *a, Matrix *b, Matrix *c, Matrix *d);
 Matrix *subdivide(Matrix *a, int start_row, int start_col);
 Matrix *merge(Matrix *a, Matrix *b, Matrix *c, Matrix *d);
 
+/* Operations that can be run in parallel by run_matrix_ops */
+#define MATRIX_COPY     0           /* r = a, between blocks */
+#define MATRIX_SUM      1           /* r = a + b */
+#define MATRIX_SUBTRACT 2           /* r = a - b */
+#define MATRIX_C11      3           /* r = a + b - c + d */
+#define MATRIX_C22      4           /* r = a - b + c + d */
+#define MATRIX_SPLIT_A  5           /* parts = operands of p1..p7 from a */
+#define MATRIX_SPLIT_B  6           /* parts = operands of p1..p7 from b */
+#define MATRIX_MERGE    7           /* r = quadrants computed from parts = p1..p7 */
+
+typedef struct {
+    int kind;
+    int size;                       /* rows and columns processed */
+    Matrix *r, *a, *b, *c, *d;
+    Matrix **parts;                 /* MATRIX_SPLIT_* and MATRIX_MERGE: 7 matrices */
+    int r_row, r_col;               /* MATRIX_COPY: block of r written */
+    int a_row, a_col;               /* MATRIX_COPY: block of a read */
+} MatrixOp;
+
+MatrixOp matrix_op(int kind, Matrix *r, Matrix *a, Matrix *b, Matrix *c, Matrix *d);
+MatrixOp copy_op(int size, Matrix *r, int r_row, int r_col, Matrix *a, int a_row, int a_col);
+MatrixOp split_op(int kind, Matrix *a, Matrix **parts);
+MatrixOp merge_op(Matrix *r, Matrix **p);
+void run_matrix_ops(MatrixOp *ops, int count, int threads);
+
+/* Fused Strassen steps: one pass over the quadrants or the products */
+void split_operands(int kind, Matrix *a, Matrix **parts);
+Matrix *merge_products(Matrix **p);
+
+/* Morton (Z-order) storage: every quadrant is a contiguous quarter */
+Matrix *to_morton(double *a, int lda, int size);
+void from_morton_add(Matrix *z, double *c, int ldc);
+Matrix morton_quadrant(Matrix *a, int q);
+void split_sums_morton(int kind, Matrix *a, Matrix **sums);
+Matrix *merge_products_morton(Matrix **p);
+
@@ -0,0 +1,177 @@
+/* Complex double version of MMult_4x4_vecreg_subblock_cache.c.
+   Complex numbers are stored interleaved, real part first (the layout of
+   double _Complex), and leading dimensions count complex elements.
+   One __m128d holds one complex number, so the micro-kernel computes a
+   2x2 block of C: for every column of B it accumulates A times the real
+   part and A times the imaginary part of B( p,j ) separately, and only
+   combines them with one addsub when the block is written back. */
+
+#include <stdlib.h>
+
+/* Create macros so that the matrices are stored in column-major order,
+   these point to the real part of an element */
+
+#define A(i,j) a[ 2*( (j)*lda + (i) ) ]
+#define B(i,j) b[ 2*( (j)*ldb + (i) ) ]
+#define C(i,j) c[ 2*( (j)*ldc + (i) ) ]
+#define C_im(i,j) c[ 2*( (j)*ldc + (i) ) + 1 ]
+
+/* Block sizes */
+#define mc 128
+#define kc 128
+
+#define min( i, j ) ( (i)<(j) ? (i): (j) )
+
+/* Routine for computing C = A * B + C */
+
+void AddDot2x2_z( int, double *, double *, double *, int, int, int );
+void PackMatrixA_z( int, int, double *, int, double * );
+void PackMatrixB_z( int, int, double *, int, double * );
+void InnerKernel_z( int, int, int, double *, int, double *, int, double *, int,
+                    double *, double *, int );
+
+void MY_ZMMult( int m, int n, int k, double *a, int lda,
+                                     double *b, int ldb,
+                                     double *c, int ldc )
+{
+  int i, p, pb, ib;
+  double
+    *packedA, *packedB;
+
+  if ( posix_memalign( (void **) &packedA, 16, 2 * mc * kc * sizeof( double ) ) ||
+       posix_memalign( (void **) &packedB, 16, 2 * kc * ( n+1 ) * sizeof( double ) ) )
+    abort();
+
+  for ( p=0; p<k; p+=kc ){
+    pb = min( k-p, kc );
+    for ( i=0; i<m; i+=mc ){
+      ib = min( m-i, mc );
+      InnerKernel_z( ib, n, pb, &A( i,p ), lda, &B( p,0 ), ldb, &C( i,0 ), ldc,
+                     packedA, packedB, i==0 );
+    }
+  }
+
+  free( packedA );
+  free( packedB );
+}
+
+void InnerKernel_z( int m, int n, int k, double *a, int lda,
+                                         double *b, int ldb,
+                                         double *c, int ldc,
+                    double *packedA, double *packedB, int first_time )
+{
+  int i, j;
+
+  for ( j=0; j<n; j+=2 ){        /* Loop over the columns of C, unrolled by 2 */
+    if ( first_time )
+      PackMatrixB_z( k, min( n-j, 2 ), &B( 0,j ), ldb, &packedB[ 2*j*k ] );
+    for ( i=0; i<m; i+=2 ){        /* Loop over the rows of C, unrolled by 2 */
+      if ( j == 0 )
+        PackMatrixA_z( k, min( m-i, 2 ), &A( i,0 ), lda, &packedA[ 2*i*k ] );
+      AddDot2x2_z( k, &packedA[ 2*i*k ], &packedB[ 2*j*k ], &C( i,j ), ldc,
+                   min( m-i, 2 ), min( n-j, 2 ) );
+    }
+  }
+}
+
+void PackMatrixA_z( int k, int mr, double *a, int lda, double *a_to )
+{
+  int j;
+
+  for( j=0; j<k; j++){  /* loop over columns of A */
+    double
+      *a_ij_pntr = &A( 0, j );
+
+    *a_to++ = *a_ij_pntr;                             /* A( 0,j ) */
+    *a_to++ = *(a_ij_pntr+1);
+    *a_to++ = ( mr > 1 ? *(a_ij_pntr+2) : 0.0 );      /* A( 1,j ) */
+    *a_to++ = ( mr > 1 ? *(a_ij_pntr+3) : 0.0 );
+  }
+}
+
+void PackMatrixB_z( int k, int nr, double *b, int ldb, double *b_to )
+{
+  int i;
+  double
+    *b_i0_pntr = &B( 0, 0 ), *b_i1_pntr = &B( 0, 1 );
+
+  for( i=0; i<k; i++){  /* loop over rows of B */
+    *b_to++ = *b_i0_pntr;                             /* B( i,0 ) */
+    *b_to++ = *(b_i0_pntr+1);
+    *b_to++ = ( nr > 1 ? *b_i1_pntr : 0.0 );          /* B( i,1 ) */
+    *b_to++ = ( nr > 1 ? *(b_i1_pntr+1) : 0.0 );
+    b_i0_pntr += 2;
+    b_i1_pntr += 2;
+  }
+}
+
+#include <mmintrin.h>
+#include <xmmintrin.h>  // SSE
+#include <pmmintrin.h>  // SSE2
+#include <emmintrin.h>  // SSE3
+
+typedef union
+{
+  __m128d v;
+  double d[2];
+} v2df_t;
+
+void AddDot2x2_z( int k, double *a, double *b, double *c, int ldc, int mr, int nr )
+{
+  /* So, this routine computes a 2x2 block of complex matrix C
+           C( 0, 0 ), C( 0, 1 ).
+           C( 1, 0 ), C( 1, 1 ).
+     of which only the first mr rows and nr columns are written back.
+     Every register holds one complex number ( re, im ) */
+
+  int p;
+  v2df_t
+    c_00_r_vreg, c_01_r_vreg, c_10_r_vreg, c_11_r_vreg,   /* A times Re( B ) */
+    c_00_i_vreg, c_01_i_vreg, c_10_i_vreg, c_11_i_vreg,   /* A times Im( B ) */
+    a_0p_vreg, a_1p_vreg,
+    b_p0_r_vreg, b_p0_i_vreg, b_p1_r_vreg, b_p1_i_vreg;
+
+  c_00_r_vreg.v = _mm_setzero_pd();  c_00_i_vreg.v = _mm_setzero_pd();
+  c_01_r_vreg.v = _mm_setzero_pd();  c_01_i_vreg.v = _mm_setzero_pd();
+  c_10_r_vreg.v = _mm_setzero_pd();  c_10_i_vreg.v = _mm_setzero_pd();
+  c_11_r_vreg.v = _mm_setzero_pd();  c_11_i_vreg.v = _mm_setzero_pd();
+
+  for ( p=0; p<k; p++ ){
+    a_0p_vreg.v = _mm_load_pd( (double *) a );
+    a_1p_vreg.v = _mm_load_pd( (double *) ( a+2 ) );
+    a += 4;
+
+    b_p0_r_vreg.v = _mm_loaddup_pd( (double *) b );       /* load and duplicate */
+    b_p0_i_vreg.v = _mm_loaddup_pd( (double *) (b+1) );   /* load and duplicate */
+    b_p1_r_vreg.v = _mm_loaddup_pd( (double *) (b+2) );   /* load and duplicate */
+    b_p1_i_vreg.v = _mm_loaddup_pd( (double *) (b+3) );   /* load and duplicate */
+    b += 4;
+
+    c_00_r_vreg.v += a_0p_vreg.v * b_p0_r_vreg.v;
+    c_00_i_vreg.v += a_0p_vreg.v * b_p0_i_vreg.v;
+    c_01_r_vreg.v += a_0p_vreg.v * b_p1_r_vreg.v;
+    c_01_i_vreg.v += a_0p_vreg.v * b_p1_i_vreg.v;
+
+    c_10_r_vreg.v += a_1p_vreg.v * b_p0_r_vreg.v;
+    c_10_i_vreg.v += a_1p_vreg.v * b_p0_i_vreg.v;
+    c_11_r_vreg.v += a_1p_vreg.v * b_p1_r_vreg.v;
+    c_11_i_vreg.v += a_1p_vreg.v * b_p1_i_vreg.v;
+  }
+
+  /* ( ar br - ai bi, ai br + ar bi ) = addsub( ( ar br, ai br ), ( ai bi, ar bi ) ) */
+  c_00_r_vreg.v = _mm_addsub_pd( c_00_r_vreg.v, _mm_shuffle_pd( c_00_i_vreg.v, c_00_i_vreg.v, 1 ) );
+  c_01_r_vreg.v = _mm_addsub_pd( c_01_r_vreg.v, _mm_shuffle_pd( c_01_i_vreg.v, c_01_i_vreg.v, 1 ) );
+  c_10_r_vreg.v = _mm_addsub_pd( c_10_r_vreg.v, _mm_shuffle_pd( c_10_i_vreg.v, c_10_i_vreg.v, 1 ) );
+  c_11_r_vreg.v = _mm_addsub_pd( c_11_r_vreg.v, _mm_shuffle_pd( c_11_i_vreg.v, c_11_i_vreg.v, 1 ) );
+
+  C( 0, 0 ) += c_00_r_vreg.d[0];  C_im( 0, 0 ) += c_00_r_vreg.d[1];
+  if ( nr > 1 ){
+    C( 0, 1 ) += c_01_r_vreg.d[0];  C_im( 0, 1 ) += c_01_r_vreg.d[1];
+  }
+  if ( mr > 1 ){
+    C( 1, 0 ) += c_10_r_vreg.d[0];  C_im( 1, 0 ) += c_10_r_vreg.d[1];
+    if ( nr > 1 ){
+      C( 1, 1 ) += c_11_r_vreg.d[0];  C_im( 1, 1 ) += c_11_r_vreg.d[1];
+    }
+  }
+}
@@ -0,0 +1,96 @@
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "Strassen_utils.h"
+
+Matrix *Strassen_MMult(Matrix *matrix_a, Matrix *matrix_b);
+
+/**
+ * Complex matrix multiplication with three real Strassen products (3M method)
+ *  T1 = Ar * Br, T2 = Ai * Bi, T3 = (Ar + Ai) * (Br + Bi)
+ *  Cr = T1 - T2, Ci = T3 - T1 - T2
+ * which saves one of the four real products of the direct formula.
+ * @param ar: real part of matrix a
+ * @param ai: imaginary part of matrix a
+ * @param br: real part of matrix b
+ * @param bi: imaginary part of matrix b
+ * @param cr: set to a newly allocated real part of the result
+ * @param ci: set to a newly allocated imaginary part of the result
+ */
+void Strassen_ZMMult(Matrix *ar, Matrix *ai, Matrix *br, Matrix *bi, Matrix **cr, Matrix **ci) {
+    Matrix *ar_p_ai = sum_matrix(ar, ai);
+    Matrix *br_p_bi = sum_matrix(br, bi);
+
+    Matrix *t1 = Strassen_MMult(ar, br);
+    Matrix *t2 = Strassen_MMult(ai, bi);
+    Matrix *t3 = Strassen_MMult(ar_p_ai, br_p_bi);
+
+    free_matrix(ar_p_ai);
+    free_matrix(br_p_bi);
+
+    Matrix *t3_s_t1 = subtract_matrix(t3, t1);
+    *cr = subtract_matrix(t1, t2);
+    *ci = subtract_matrix(t3_s_t1, t2);
+
+    free_matrix(t1);
+    free_matrix(t2);
+    free_matrix(t3);
+    free_matrix(t3_s_t1);
+}
+
+/**
+ * Split an interleaved complex column-major matrix into real and imaginary
+ * Matrix structs. Matrix is row-major, so these hold the transposes.
+ * @param a: interleaved complex matrix
+ * @param lda: leading dimension of a, in complex elements
+ * @param size: size of the matrix
+ * @param re: set to a newly allocated real part
+ * @param im: set to a newly allocated imaginary part
+ */
+void split_complex(double *a, int lda, int size, Matrix **re, Matrix **im) {
+    *re = make_matrix(size);
+    *im = make_matrix(size);
+
+    for (int j = 0; j < size; j++) {
+        for (int i = 0; i < size; i++) {
+            (*re)->arr[j * (*re)->stride + i] = a[2 * (j * lda + i)];
+            (*im)->arr[j * (*im)->stride + i] = a[2 * (j * lda + i) + 1];
+        }
+    }
+}
+
+void MY_ZMMult(int m, int n, int k, double *a, int lda,
+               double *b, int ldb,
+               double *c, int ldc) {
+    Matrix *ar, *ai, *br, *bi, *cr, *ci;
+    int tile = m;
+
+    // The halving stops at tiles of 8, as in Strassen.c
+    while (tile > 8 && tile % 2 == 0)
+        tile /= 2;
+    if (m != n || n != k || (m > 8 && tile != 8)) {
+        fprintf(stderr, "ZStrassen multiplies square matrices of 8 times a power of two, not %dx%d by %dx%d\n",
+                m, k, k, n);
+        exit(1);
+    }
+
+    split_complex(a, lda, m, &ar, &ai);
+    split_complex(b, ldb, m, &br, &bi);
+
+    // Multiply B^T A^T = (AB)^T, which is AB in column-major order
+    Strassen_ZMMult(br, bi, ar, ai, &cr, &ci);
+
+    for (int j = 0; j < m; j++) {
+        for (int i = 0; i < m; i++) {
+            c[2 * (j * ldc + i)] += cr->arr[j * cr->stride + i];
+            c[2 * (j * ldc + i) + 1] += ci->arr[j * ci->stride + i];
+        }
+    }
+
+    free_matrix(ar);
+    free_matrix(ai);
+    free_matrix(br);
+    free_matrix(bi);
+    free_matrix(cr);
+    free_matrix(ci);
+}
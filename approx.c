@@ -0,0 +1,205 @@
+/**
+ * Approximate matrix multiplication by column-row sampling.
+ * A * B is the sum over p of the outer products A( :, p ) * B( p, : ).
+ * Approx_MMult draws s of them with replacement, term p with probability
+ * proportional to |A( :, p )| |B( p, : )|, and scales each by
+ * 1 / ( s * prob( p ) ), so that the sum is A * B on average. The terms
+ * drawn are packed into A~, m x d, and B~, d x n, where d <= s is the
+ * number of distinct terms, and the product goes to gemm, which picks
+ * the engine for its shape: the work is that of an m x n x d product
+ * instead of m x n x k.
+ * With these probabilities the expected squared Frobenius error is
+ * ( S^2 - |A * B|^2 ) / s, where S is the sum of |A( :, p )| |B( p, : )|
+ * (Drineas, Kannan and Mahoney, 2006), so the error falls as 1 / sqrt( s )
+ * and is small when a few terms carry most of the product.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "approx.h"
+#include "gemm.h"
+
+#define A(i, j) a[ (j)*lda + (i) ]
+#define B(i, j) b[ (j)*ldb + (i) ]
+#define C(i, j) c[ (j)*ldc + (i) ]
+
+/* The norm of the sampled product comes from the d x d Gram matrices of
+   A~ and B~ when their 2 d^2 ( m+n ) operations take less time than
+   writing the m x n product aside and reading it back, taken as 24 m n
+   bytes at one byte for every GRAM_RATIO / 24 operations */
+#define GRAM_RATIO 48
+
+/**
+ * |A~ * B~|^2 = trace( A~' A~ * B~ B~' ), the sum of the products of the
+ * elements of the Gram matrices
+ * @param a_s: A~, m x d, leading dimension m
+ * @param b_s: B~, d x n, leading dimension d
+ */
+static double gram_norm(int m, int n, int d, double *a_s, double *b_s) {
+    double *a_t = malloc((size_t) d * m * sizeof(double));
+    double *b_t = malloc((size_t) n * d * sizeof(double));
+    double *g_a = calloc((size_t) d * d, sizeof(double));
+    double *g_b = calloc((size_t) d * d, sizeof(double));
+    double norm = 0.0;
+
+    if (a_t == NULL || b_t == NULL || g_a == NULL || g_b == NULL) {
+        fprintf(stderr, "Approx_MMult: out of memory\n");
+        exit(1);
+    }
+
+    for (int q = 0; q < d; q++) {
+        for (int i = 0; i < m; i++)
+            a_t[(size_t) i * d + q] = a_s[(size_t) q * m + i];
+        for (int j = 0; j < n; j++)
+            b_t[(size_t) q * n + j] = b_s[(size_t) j * d + q];
+    }
+
+    gemm(d, d, m, a_t, d, a_s, m, g_a, d);
+    gemm(d, d, n, b_s, d, b_t, n, g_b, d);
+
+    for (long x = 0; x < (long) d * d; x++)
+        norm += g_a[x] * g_b[x];
+
+    free(a_t);
+    free(b_t);
+    free(g_a);
+    free(g_b);
+    return norm;
+}
+
+/**
+ * The first index p with cdf[ p ] > u, for u in [ 0, cdf[ k-1 ] )
+ */
+static int draw(const double *cdf, int k, double u) {
+    int lo = 0, hi = k - 1;
+
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (cdf[mid] > u)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return lo;
+}
+
+/**
+ * C += A * B approximately, from s sampled columns of A and rows of B.
+ * With s >= k the product is exact.
+ * @param s: number of samples, the rank of the approximation at most
+ * @param seed: seed of the sampling, the same seed draws the same terms
+ * @return: estimate of the relative Frobenius error of the approximation,
+ *          |A * B - A~ * B~| / |A~ * B~|, 0 if exact
+ */
+double Approx_MMult(int m, int n, int k, double *a, int lda, double *b, int ldb, double *c, int ldc,
+                    int s, unsigned int seed) {
+    if (s >= k) {
+        gemm(m, n, k, a, lda, b, ldb, c, ldc);
+        return 0.0;
+    }
+
+    double *weight = malloc(k * sizeof(double));
+    double *cdf = malloc(k * sizeof(double));
+    int *count = calloc(k, sizeof(int));
+    double total = 0.0;
+
+    if (weight == NULL || cdf == NULL || count == NULL) {
+        fprintf(stderr, "Approx_MMult: out of memory\n");
+        exit(1);
+    }
+
+    /* Weight of each term, |A( :, p )| |B( p, : )|; the squared norms of
+       the rows of B are summed column after column, as B is stored */
+    for (int p = 0; p < k; p++)
+        cdf[p] = 0.0;
+    for (int j = 0; j < n; j++)
+        for (int p = 0; p < k; p++)
+            cdf[p] += B(p, j) * B(p, j);
+    for (int p = 0; p < k; p++) {
+        double col = 0.0;
+
+        for (int i = 0; i < m; i++)
+            col += A(i, p) * A(i, p);
+        weight[p] = sqrt(col * cdf[p]);
+        total += weight[p];
+        cdf[p] = total;
+    }
+
+    /* Nothing to multiply */
+    if (total == 0.0) {
+        free(weight);
+        free(cdf);
+        free(count);
+        return 0.0;
+    }
+
+    /* Draw s terms; a term drawn several times is packed once */
+    int d = 0;
+    for (int t = 0; t < s; t++) {
+        int p = draw(cdf, k, total * (rand_r(&seed) / ((double) RAND_MAX + 1.0)));
+
+        if (count[p]++ == 0)
+            d++;
+    }
+
+    double *a_s = malloc((size_t) m * d * sizeof(double));
+    double *b_s = malloc((size_t) d * n * sizeof(double));
+
+    if (a_s == NULL || b_s == NULL) {
+        fprintf(stderr, "Approx_MMult: out of memory\n");
+        exit(1);
+    }
+
+    /* Term p drawn count[ p ] times weighs count[ p ] / ( s * prob( p ) ),
+       with prob( p ) = weight[ p ] / total */
+    for (int p = 0, q = 0; p < k; p++) {
+        if (count[p] == 0)
+            continue;
+
+        double scale = count[p] * total / ((double) s * weight[p]);
+
+        for (int i = 0; i < m; i++)
+            a_s[(size_t) q * m + i] = scale * A(i, p);
+        for (int j = 0; j < n; j++)
+            b_s[(size_t) j * d + q] = B(p, j);
+        q++;
+    }
+
+    double norm = 0.0;
+    if ((double) d * d * (m + n) < GRAM_RATIO * (double) m * n) {
+        norm = gram_norm(m, n, d, a_s, b_s);
+        gemm(m, n, d, a_s, m, b_s, d, c, ldc);
+    } else {
+        double *c_s = calloc((size_t) m * n, sizeof(double));
+
+        if (c_s == NULL) {
+            fprintf(stderr, "Approx_MMult: out of memory\n");
+            exit(1);
+        }
+        gemm(m, n, d, a_s, m, b_s, d, c_s, m);
+        for (int j = 0; j < n; j++)
+            for (int i = 0; i < m; i++) {
+                double v = c_s[(size_t) j * m + i];
+
+                norm += v * v;
+                C(i, j) += v;
+            }
+        free(c_s);
+    }
+
+    /* E|A~ * B~|^2 = |A * B|^2 + E err^2 and E err^2 = ( S^2 - |A * B|^2 ) / s
+       give err^2 = ( S^2 - |A~ * B~|^2 ) / ( s - 1 ) */
+    double err = s > 1 ? (total * total - norm) / (s - 1) : total * total;
+
+    free(weight);
+    free(cdf);
+    free(count);
+    free(a_s);
+    free(b_s);
+
+    if (norm == 0.0)
+        return INFINITY;
+    return err > 0.0 ? sqrt(err / norm) : 0.0;
+}
@@ -0,0 +1,6 @@
+/* Approximate C += A * B from a sample of the columns of A and rows of B */
+
+/* Samples for a ratio of the inner dimension k, at least one */
+#define APPROX_SAMPLES( ratio, k ) ( (int) ( (ratio) * (k) ) > 0 ? (int) ( (ratio) * (k) ) : 1 )
+
+double Approx_MMult(int, int, int, double *, int, double *, int, double *, int, int, unsigned int);
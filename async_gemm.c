@@ -0,0 +1,217 @@
+/**
+ * Asynchronous matrix multiplication.
+ * gemm_submit queues C += A * B and returns at once; a persistent pool of
+ * worker threads runs the queued jobs with gemm, which picks the engine
+ * for the shape of each job and shares the thread budget among the
+ * workers' calls. Jobs of at most GEMM_SMALL_FLOPS
+ * flops wait in their own queue, which the workers always serve first,
+ * so latency-sensitive small products do not sit behind large ones.
+ *
+ * The pool starts on the first submit with one worker per thread of the
+ * budget of threads.h, unless gemm_pool_start was called before, and
+ * never has more workers than that: each running job takes at least its
+ * worker's thread, and the threads it starts, from the budget.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#include "async_gemm.h"
+#include "gemm.h"
+#include "threads.h"
+
+struct GemmJob {
+    int m, n, k;
+    double *a, *b, *c;
+    int lda, ldb, ldc;
+    int done;
+    GemmJob *next;
+};
+
+typedef struct {
+    GemmJob *head, *tail;
+} JobQueue;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t job_ready = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t job_done = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_stopped = PTHREAD_COND_INITIALIZER;
+
+static JobQueue small_jobs, large_jobs;
+static pthread_t *workers;
+static int num_workers;
+static int stopping;
+
+static void push_job(JobQueue *q, GemmJob *job) {
+    job->next = NULL;
+    if (q->tail)
+        q->tail->next = job;
+    else
+        q->head = job;
+    q->tail = job;
+}
+
+static GemmJob *pop_job(JobQueue *q) {
+    GemmJob *job = q->head;
+
+    if (job) {
+        q->head = job->next;
+        if (q->head == NULL)
+            q->tail = NULL;
+    }
+    return job;
+}
+
+/**
+ * Worker thread: run jobs, small ones first, until the pool is stopped
+ * and both queues are empty
+ * @return: NULL
+ */
+static void *worker(void *arg) {
+    GemmJob *job;
+
+    pthread_mutex_lock(&lock);
+    while (1) {
+        job = pop_job(&small_jobs);
+        if (job == NULL)
+            job = pop_job(&large_jobs);
+        if (job == NULL) {
+            if (stopping)
+                break;
+            pthread_cond_wait(&job_ready, &lock);
+            continue;
+        }
+        pthread_mutex_unlock(&lock);
+
+        gemm(job->m, job->n, job->k, job->a, job->lda, job->b, job->ldb, job->c, job->ldc);
+
+        pthread_mutex_lock(&lock);
+        job->done = 1;
+        pthread_cond_broadcast(&job_done);
+    }
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+/**
+ * Start the worker pool with lock held, if it is not running yet. A pool
+ * being stopped is waited for, since its workers may already have found
+ * the queues empty and exited, and a new one started
+ */
+static void start_locked(int threads) {
+    if (threads <= 0 || threads > threads_max())
+        threads = threads_max();
+
+    while (stopping)
+        pthread_cond_wait(&pool_stopped, &lock);
+    if (workers == NULL) {
+        num_workers = threads;
+        workers = malloc(threads * sizeof(pthread_t));
+        for (int t = 0; t < threads; t++) {
+            if (pthread_create(&workers[t], NULL, worker, NULL)) {
+                fprintf(stderr, "Error creating GEMM worker thread\n");
+                exit(1);
+            }
+        }
+    }
+}
+
+/**
+ * Start the worker pool, if it is not running yet
+ * @param threads: number of workers, 0 for the default; at most
+ *                 threads_max()
+ * @return: number of workers of the pool
+ */
+int gemm_pool_start(int threads) {
+    pthread_mutex_lock(&lock);
+    start_locked(threads);
+    threads = num_workers;
+    pthread_mutex_unlock(&lock);
+    return threads;
+}
+
+/**
+ * Finish the queued jobs and stop the worker pool
+ */
+void gemm_pool_stop() {
+    pthread_mutex_lock(&lock);
+    while (stopping)
+        pthread_cond_wait(&pool_stopped, &lock);
+    if (workers == NULL) {
+        pthread_mutex_unlock(&lock);
+        return;
+    }
+    stopping = 1;
+    pthread_cond_broadcast(&job_ready);
+    pthread_mutex_unlock(&lock);
+
+    for (int t = 0; t < num_workers; t++)
+        pthread_join(workers[t], NULL);
+
+    pthread_mutex_lock(&lock);
+    free(workers);
+    workers = NULL;
+    stopping = 0;
+    pthread_cond_broadcast(&pool_stopped);
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * Queue C += A * B. The operands must not be freed, and C not read,
+ * until the job has been collected with gemm_wait or gemm_test.
+ * @return: handle of the job
+ */
+GemmJob *gemm_submit(int m, int n, int k, double *a, int lda,
+                     double *b, int ldb,
+                     double *c, int ldc) {
+    GemmJob *job = malloc(sizeof(GemmJob));
+
+    job->m = m;
+    job->n = n;
+    job->k = k;
+    job->a = a;
+    job->lda = lda;
+    job->b = b;
+    job->ldb = ldb;
+    job->c = c;
+    job->ldc = ldc;
+    job->done = 0;
+
+    /* Queued in the same critical section as the pool is checked, so
+       that a stop cannot come in between */
+    pthread_mutex_lock(&lock);
+    start_locked(0);
+    push_job(2.0 * m * n * k <= GEMM_SMALL_FLOPS ? &small_jobs : &large_jobs, job);
+    pthread_cond_signal(&job_ready);
+    pthread_mutex_unlock(&lock);
+    return job;
+}
+
+/**
+ * Check whether a job has finished without blocking. A finished job is
+ * collected: its handle is freed and must not be used again.
+ * @return: 1 if the job has finished, 0 if not
+ */
+int gemm_test(GemmJob *job) {
+    int done;
+
+    pthread_mutex_lock(&lock);
+    done = job->done;
+    pthread_mutex_unlock(&lock);
+
+    if (done)
+        free(job);
+    return done;
+}
+
+/**
+ * Block until a job has finished and collect it, freeing its handle
+ */
+void gemm_wait(GemmJob *job) {
+    pthread_mutex_lock(&lock);
+    while (!job->done)
+        pthread_cond_wait(&job_done, &lock);
+    pthread_mutex_unlock(&lock);
+
+    free(job);
+}
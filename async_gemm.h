@@ -0,0 +1,13 @@
+/* Asynchronous C += A * B with gemm, run by a pool of worker threads */
+
+/* Jobs of at most this many flops go ahead of larger ones */
+#define GEMM_SMALL_FLOPS (2.0 * 256 * 256 * 256)
+
+typedef struct GemmJob GemmJob;
+
+int gemm_pool_start(int);
+void gemm_pool_stop();
+
+GemmJob *gemm_submit(int, int, int, double *, int, double *, int, double *, int);
+int gemm_test(GemmJob *);
+void gemm_wait(GemmJob *);
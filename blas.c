@@ -0,0 +1,188 @@
+/**
+ * BLAS Level-3 GEMM, C = alpha * op(A) * op(B) + beta * C, through the gemm
+ * dispatcher, so that existing applications can reach the engines of this
+ * repo without being rebuilt:
+ *     make libcachemulti.so
+ *     LD_PRELOAD=./libcachemulti.so ./application
+ * The library exports only dgemm_ (Fortran) and cblas_dgemm.
+ *
+ * The engines compute C += A * B on column-major matrices whose sizes are
+ * multiples of 4, except the narrow kernels, which take any m and k.
+ * beta is applied to C first; a call without transposes, with alpha = 1
+ * and such sizes then goes straight to gemm. Otherwise
+ * alpha * op(A) and op(B) are copied into column-major buffers padded with
+ * zeros to multiples of 4, and the product is added into C from a padded
+ * buffer as well.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "blas.h"
+#include "gemm.h"
+
+#define max( i, j ) ( (i)>(j) ? (i): (j) )
+
+#define X(i, j) x[ (j)*ldx + (i) ]
+
+/* Round up to a multiple of 4 */
+#define PAD4( i ) ( ( (i)+3 ) & ~3 )
+
+/**
+ * Report an illegal argument and stop, as the reference xerbla does
+ * @param routine: name of the routine
+ * @param arg: position of the argument, from 1
+ */
+static void blas_error(const char *routine, int arg) {
+    fprintf(stderr, " ** On entry to %s parameter number %d had an illegal value\n", routine, arg);
+    exit(1);
+}
+
+/**
+ * Copy scale * op(X) into a zeroed column-major buffer
+ * @param trans: whether op transposes X
+ * @param rows, cols: size of op(X)
+ * @param ld_to: leading dimension of the buffer, at least rows
+ * @param cols_to: columns of the buffer, at least cols
+ * @return: the newly allocated buffer
+ */
+static double *pack_operand(int trans, int rows, int cols, double scale,
+                            const double *x, int ldx, int ld_to, int cols_to) {
+    double *to = calloc((size_t) ld_to * cols_to, sizeof(double));
+
+    if (to == NULL) {
+        fprintf(stderr, "Cannot allocate a %dx%d GEMM operand\n", ld_to, cols_to);
+        exit(1);
+    }
+    for (int j = 0; j < cols; j++) {
+        for (int i = 0; i < rows; i++) {
+            to[(size_t) j * ld_to + i] = scale * (trans ? X(j, i) : X(i, j));
+        }
+    }
+    return to;
+}
+
+/**
+ * C = alpha * op(A) * op(B) + beta * C on column-major matrices, with
+ * arguments already checked
+ */
+static void dgemm_colmajor(int transa, int transb, int m, int n, int k,
+                           double alpha, const double *a, int lda,
+                           const double *b, int ldb,
+                           double beta, double *c, int ldc) {
+    if (m == 0 || n == 0)
+        return;
+
+    // beta = 0 overwrites C, even where it holds NaN
+    if (beta != 1.0) {
+        for (int j = 0; j < n; j++) {
+            for (int i = 0; i < m; i++) {
+                c[(size_t) j * ldc + i] = beta == 0.0 ? 0.0 : beta * c[(size_t) j * ldc + i];
+            }
+        }
+    }
+    if (alpha == 0.0 || k == 0)
+        return;
+
+    if (!transa && !transb && alpha == 1.0 &&
+        ((m % 4 == 0 && n % 4 == 0) || gemm_shape(m, n, k) == GEMM_NARROW)) {
+        gemm(m, n, k, (double *) a, lda, (double *) b, ldb, c, ldc);
+        return;
+    }
+
+    int m4 = PAD4(m), n4 = PAD4(n);
+    double *a_to = pack_operand(transa, m, k, alpha, a, lda, m4, k);
+    double *b_to = pack_operand(transb, k, n, 1.0, b, ldb, k, n4);
+    double *c_to = calloc((size_t) m4 * n4, sizeof(double));
+
+    if (c_to == NULL) {
+        fprintf(stderr, "Cannot allocate a %dx%d GEMM result\n", m4, n4);
+        exit(1);
+    }
+    gemm(m4, n4, k, a_to, m4, b_to, k, c_to, m4);
+    for (int j = 0; j < n; j++) {
+        for (int i = 0; i < m; i++) {
+            c[(size_t) j * ldc + i] += c_to[(size_t) j * m4 + i];
+        }
+    }
+
+    free(a_to);
+    free(b_to);
+    free(c_to);
+}
+
+/**
+ * Whether a BLAS transpose character asks for op(X) = X^T
+ * @return: 1 for T or C, 0 for N, -1 for anything else
+ */
+static int blas_trans(char t) {
+    if (t == 'N' || t == 'n')
+        return 0;
+    if (t == 'T' || t == 't' || t == 'C' || t == 'c')
+        return 1;
+    return -1;
+}
+
+/**
+ * Fortran BLAS DGEMM: every argument is passed by reference
+ */
+void dgemm_(const char *transa, const char *transb, const int *m, const int *n, const int *k,
+            const double *alpha, const double *a, const int *lda, const double *b, const int *ldb,
+            const double *beta, double *c, const int *ldc) {
+    int ta = blas_trans(*transa), tb = blas_trans(*transb);
+
+    if (ta < 0)
+        blas_error("DGEMM ", 1);
+    if (tb < 0)
+        blas_error("DGEMM ", 2);
+    if (*m < 0)
+        blas_error("DGEMM ", 3);
+    if (*n < 0)
+        blas_error("DGEMM ", 4);
+    if (*k < 0)
+        blas_error("DGEMM ", 5);
+    if (*lda < max(1, ta ? *k : *m))
+        blas_error("DGEMM ", 8);
+    if (*ldb < max(1, tb ? *n : *k))
+        blas_error("DGEMM ", 10);
+    if (*ldc < max(1, *m))
+        blas_error("DGEMM ", 13);
+
+    dgemm_colmajor(ta, tb, *m, *n, *k, *alpha, a, *lda, b, *ldb, *beta, c, *ldc);
+}
+
+/**
+ * CBLAS DGEMM. A row-major C = op(A) * op(B) is the column-major
+ * C^T = op(B)^T * op(A)^T, so row-major calls swap the operands.
+ */
+void cblas_dgemm(enum CBLAS_ORDER order, enum CBLAS_TRANSPOSE transa, enum CBLAS_TRANSPOSE transb,
+                 int m, int n, int k, double alpha, const double *a, int lda,
+                 const double *b, int ldb, double beta, double *c, int ldc) {
+    int ta = transa == CblasNoTrans ? 0 : transa == CblasTrans || transa == CblasConjTrans ? 1 : -1;
+    int tb = transb == CblasNoTrans ? 0 : transb == CblasTrans || transb == CblasConjTrans ? 1 : -1;
+    int row_major = order == CblasRowMajor;
+
+    if (order != CblasRowMajor && order != CblasColMajor)
+        blas_error("cblas_dgemm", 1);
+    if (ta < 0)
+        blas_error("cblas_dgemm", 2);
+    if (tb < 0)
+        blas_error("cblas_dgemm", 3);
+    if (m < 0)
+        blas_error("cblas_dgemm", 4);
+    if (n < 0)
+        blas_error("cblas_dgemm", 5);
+    if (k < 0)
+        blas_error("cblas_dgemm", 6);
+    // Rows of the matrices as they are stored
+    if (lda < max(1, row_major != ta ? k : m))
+        blas_error("cblas_dgemm", 9);
+    if (ldb < max(1, row_major != tb ? n : k))
+        blas_error("cblas_dgemm", 11);
+    if (ldc < max(1, row_major ? n : m))
+        blas_error("cblas_dgemm", 14);
+
+    if (row_major)
+        dgemm_colmajor(tb, ta, n, m, k, alpha, b, ldb, a, lda, beta, c, ldc);
+    else
+        dgemm_colmajor(ta, tb, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+}
@@ -0,0 +1,16 @@
+/* Standard BLAS and CBLAS entry points for C = alpha * op(A) * op(B) + beta * C,
+   on top of the gemm dispatcher */
+
+/* The values of cblas.h, so that callers built against it link unchanged */
+enum CBLAS_ORDER {CblasRowMajor = 101, CblasColMajor = 102};
+enum CBLAS_TRANSPOSE {CblasNoTrans = 111, CblasTrans = 112, CblasConjTrans = 113};
+
+/* Symbols of the shared library, the rest of it is hidden */
+#define BLAS_EXPORT __attribute__(( visibility( "default" ) ))
+
+BLAS_EXPORT void dgemm_(const char *, const char *, const int *, const int *, const int *,
+                        const double *, const double *, const int *, const double *, const int *,
+                        const double *, double *, const int *);
+BLAS_EXPORT void cblas_dgemm(enum CBLAS_ORDER, enum CBLAS_TRANSPOSE, enum CBLAS_TRANSPOSE,
+                             int, int, int, double, const double *, int, const double *, int,
+                             double, double *, int);
@@ -0,0 +1,107 @@
+/**
+ * Communication-avoiding recursive parallel matrix multiplication, after
+ * CARMA (Demmel et al., "Communication-optimal parallel recursive
+ * rectangular matrix multiplication", IPDPS 2013).
+ * The threads are split in two at every level and the largest of m, n
+ * and k is split in proportion, so every thread ends up with a sub-problem
+ * as close to square as possible, which is the shape that moves the least
+ * data per flop. Splitting m or n gives two independent halves of C;
+ * splitting k gives two products of the same C, so one half accumulates
+ * into a zeroed buffer that is added into C afterwards.
+ * Sub-matrices are views into the operands through their leading
+ * dimensions and nothing is copied, unlike the subdivide of the Strassen
+ * engines. Every thread's sub-problem is then handed to the linked
+ * MY_MMult, which must accept sizes that are multiples of 4.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#include "carma.h"
+
+#define A(i, j) t->a[ (j)*t->lda + (i) ]
+#define B(i, j) t->b[ (j)*t->ldb + (i) ]
+#define C(i, j) t->c[ (j)*t->ldc + (i) ]
+
+void MY_MMult(int, int, int, double *, int, double *, int, double *, int);
+
+typedef struct {
+    int m, n, k;
+    double *a, *b, *c;
+    int lda, ldb, ldc;
+    int threads;
+} CarmaTask;
+
+/**
+ * Multiply one task, splitting it over its threads
+ * @param arg: CarmaTask
+ * @return: NULL
+ */
+static void *carma(void *arg) {
+    CarmaTask *t = (CarmaTask *) arg;
+    CarmaTask first = *t, second = *t;
+    int p1 = t->threads / 2, dim, split;
+    double *buf = NULL;
+    pthread_t thread;
+
+    dim = t->m >= t->n && t->m >= t->k ? t->m : t->n >= t->k ? t->n : t->k;
+    /* Split in proportion to the threads, on a multiple of 4 */
+    split = (int) ((long) dim * p1 / t->threads) / 4 * 4;
+
+    if (t->threads <= 1 || split == 0 || split == dim) {
+        MY_MMult(t->m, t->n, t->k, t->a, t->lda, t->b, t->ldb, t->c, t->ldc);
+        return NULL;
+    }
+
+    first.threads = p1;
+    second.threads = t->threads - p1;
+    if (dim == t->m) {
+        first.m = split;
+        second.m = t->m - split;
+        second.a = &A(split, 0);
+        second.c = &C(split, 0);
+    } else if (dim == t->n) {
+        first.n = split;
+        second.n = t->n - split;
+        second.b = &B(0, split);
+        second.c = &C(0, split);
+    } else {
+        first.k = split;
+        second.k = t->k - split;
+        second.a = &A(0, split);
+        second.b = &B(split, 0);
+        buf = calloc((size_t) t->m * t->n, sizeof(double));
+        second.c = buf;
+        second.ldc = t->m;
+    }
+
+    if (pthread_create(&thread, NULL, carma, &second)) {
+        fprintf(stderr, "Error creating CARMA thread\n");
+        exit(1);
+    }
+    carma(&first);
+    if (pthread_join(thread, NULL)) {
+        fprintf(stderr, "Error joining CARMA thread\n");
+        exit(2);
+    }
+
+    if (buf) {
+        for (int j = 0; j < t->n; j++)
+            for (int i = 0; i < t->m; i++)
+                C(i, j) += buf[(size_t) j * t->m + i];
+        free(buf);
+    }
+    return NULL;
+}
+
+/**
+ * C += A * B on the given number of threads
+ * @param threads: number of threads, at least 1
+ */
+void CARMA_MMult(int m, int n, int k, double *a, int lda,
+                 double *b, int ldb,
+                 double *c, int ldc, int threads) {
+    CarmaTask t = {m, n, k, a, b, c, lda, ldb, ldc, threads};
+
+    carma(&t);
+}
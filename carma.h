@@ -0,0 +1,3 @@
+/* Recursive parallel C += A * B (CARMA) over the linked MY_MMult */
+
+void CARMA_MMult(int, int, int, double *, int, double *, int, double *, int, int);
@@ -0,0 +1,237 @@
+/**
+ * Matrix chain multiplication.
+ * chain_plan picks the parenthesization with the fewest flops by dynamic
+ * programming over the sub-chains, and an engine for every product of
+ * the plan. chain_execute then runs the plan: intermediate products are
+ * taken from a ChainPool and given back as soon as they have been used,
+ * so a pool kept across calls stops allocating after the first one. The
+ * last product accumulates straight into C.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "chain.h"
+#include "gemm.h"
+
+#define SPLIT(i, j) plan->split[ (i) * plan->count + (j) ]
+#define ENGINE(i, j) plan->engine[ (i) * plan->count + (j) ]
+
+static void check_chain(int count, ChainOperand *ops) {
+    if (count < 1) {
+        fprintf(stderr, "A chain needs at least one operand\n");
+        exit(1);
+    }
+    for (int i = 0; i + 1 < count; i++) {
+        if (ops[i].cols != ops[i + 1].rows) {
+            fprintf(stderr, "Operand %d is %dx%d but operand %d is %dx%d\n",
+                    i, ops[i].rows, ops[i].cols, i + 1, ops[i + 1].rows, ops[i + 1].cols);
+            exit(1);
+        }
+    }
+}
+
+/* gemm looks up the engine for the shape, and the alignment of the
+   operands, of every product when it runs */
+static MMultEngine default_selector(int m, int n, int k) {
+    return gemm;
+}
+
+/**
+ * Choose the order of the products of a chain
+ * @param count: number of operands
+ * @param ops: the operands, only their sizes are used
+ * @param select: picks the engine for each product, NULL for gemm
+ * @return: newly allocated plan
+ */
+ChainPlan *chain_plan(int count, ChainOperand *ops, EngineSelector select) {
+    ChainPlan *plan = malloc(sizeof(ChainPlan));
+    double *cost = malloc(count * count * sizeof(double));
+    int *d;
+
+    check_chain(count, ops);
+    if (select == NULL)
+        select = default_selector;
+
+    plan->count = count;
+    plan->rows = d = malloc((count + 1) * sizeof(int));
+    plan->split = malloc(count * count * sizeof(int));
+    plan->engine = malloc(count * count * sizeof(MMultEngine));
+
+    for (int i = 0; i < count; i++)
+        d[i] = ops[i].rows;
+    d[count] = ops[count - 1].cols;
+
+    /* cost[i][j] is the fewest flops for the product of operands i..j */
+    for (int i = 0; i < count; i++)
+        cost[i * count + i] = 0.0;
+    for (int len = 2; len <= count; len++) {
+        for (int i = 0; i + len - 1 < count; i++) {
+            int j = i + len - 1;
+
+            cost[i * count + j] = -1.0;
+            for (int s = i; s < j; s++) {
+                double c = cost[i * count + s] + cost[(s + 1) * count + j]
+                           + 2.0 * d[i] * d[s + 1] * d[j + 1];
+
+                if (cost[i * count + j] < 0.0 || c < cost[i * count + j]) {
+                    cost[i * count + j] = c;
+                    SPLIT(i, j) = s;
+                }
+            }
+            ENGINE(i, j) = select(d[i], d[j + 1], d[SPLIT(i, j) + 1]);
+        }
+    }
+
+    plan->flops = cost[count - 1];
+    free(cost);
+    return plan;
+}
+
+void free_chain_plan(ChainPlan *plan) {
+    free(plan->rows);
+    free(plan->split);
+    free(plan->engine);
+    free(plan);
+}
+
+/**
+ * Flops of multiplying a chain in the order it is written
+ */
+double chain_flops_left_to_right(int count, ChainOperand *ops) {
+    double flops = 0.0;
+
+    check_chain(count, ops);
+    for (int i = 1; i < count; i++)
+        flops += 2.0 * ops[0].rows * ops[i].rows * ops[i].cols;
+    return flops;
+}
+
+ChainPool *chain_pool_create() {
+    ChainPool *pool = malloc(sizeof(ChainPool));
+
+    pool->count = 0;
+    pool->capacity = 8;
+    pool->buf = malloc(pool->capacity * sizeof(double *));
+    pool->size = malloc(pool->capacity * sizeof(size_t));
+    pool->in_use = malloc(pool->capacity * sizeof(int));
+    return pool;
+}
+
+void chain_pool_free(ChainPool *pool) {
+    for (int i = 0; i < pool->count; i++)
+        free(pool->buf[i]);
+    free(pool->buf);
+    free(pool->size);
+    free(pool->in_use);
+    free(pool);
+}
+
+/**
+ * Take a buffer of at least size elements from the pool. The smallest
+ * free buffer that is large enough is used, otherwise a new one is added.
+ */
+static double *pool_get(ChainPool *pool, size_t size) {
+    int best = -1;
+
+    for (int i = 0; i < pool->count; i++)
+        if (!pool->in_use[i] && pool->size[i] >= size && (best < 0 || pool->size[i] < pool->size[best]))
+            best = i;
+
+    if (best < 0) {
+        if (pool->count == pool->capacity) {
+            pool->capacity *= 2;
+            pool->buf = realloc(pool->buf, pool->capacity * sizeof(double *));
+            pool->size = realloc(pool->size, pool->capacity * sizeof(size_t));
+            pool->in_use = realloc(pool->in_use, pool->capacity * sizeof(int));
+        }
+        best = pool->count++;
+        if (posix_memalign((void **) &pool->buf[best], 64, size * sizeof(double))) {
+            fprintf(stderr, "Cannot allocate an intermediate of %zu elements\n", size);
+            exit(1);
+        }
+        pool->size[best] = size;
+    }
+    pool->in_use[best] = 1;
+    return pool->buf[best];
+}
+
+static void pool_put(ChainPool *pool, double *buf) {
+    for (int i = 0; i < pool->count; i++)
+        if (pool->buf[i] == buf)
+            pool->in_use[i] = 0;
+}
+
+/**
+ * Compute the product of operands i..j. With c NULL the result goes to a
+ * pool buffer, otherwise it is added into c.
+ * @return: the product, as an operand
+ */
+static ChainOperand run(ChainPlan *plan, ChainOperand *ops, int i, int j,
+                        double *c, int ldc, ChainPool *pool) {
+    ChainOperand left, right, result;
+    int s;
+
+    if (i == j)
+        return ops[i];
+
+    s = SPLIT(i, j);
+    left = run(plan, ops, i, s, NULL, 0, pool);
+    right = run(plan, ops, s + 1, j, NULL, 0, pool);
+
+    result.rows = plan->rows[i];
+    result.cols = plan->rows[j + 1];
+    if (c == NULL) {
+        result.ld = result.rows;
+        result.data = pool_get(pool, (size_t) result.rows * result.cols);
+        memset(result.data, 0, (size_t) result.rows * result.cols * sizeof(double));
+    } else {
+        result.ld = ldc;
+        result.data = c;
+    }
+
+    ENGINE(i, j)(result.rows, result.cols, left.cols, left.data, left.ld,
+                 right.data, right.ld, result.data, result.ld);
+
+    /* Intermediates are consumed, give their buffers back */
+    if (s > i)
+        pool_put(pool, left.data);
+    if (j > s + 1)
+        pool_put(pool, right.data);
+    return result;
+}
+
+/**
+ * C += A1 * ... * An following a plan
+ * @param plan: plan from chain_plan for these operands
+ * @param ops: the operands
+ * @param c: result, ops[0].rows x ops[count - 1].cols
+ * @param ldc: leading dimension of c
+ * @param pool: buffers for the intermediates, NULL for a pool used only for this call
+ */
+void chain_execute(ChainPlan *plan, ChainOperand *ops, double *c, int ldc, ChainPool *pool) {
+    ChainPool *own = (pool == NULL ? chain_pool_create() : NULL);
+    int count = plan->count;
+
+    if (count == 1) {
+        for (int j = 0; j < ops[0].cols; j++)
+            for (int i = 0; i < ops[0].rows; i++)
+                c[j * ldc + i] += ops[0].data[j * ops[0].ld + i];
+    } else {
+        run(plan, ops, 0, count - 1, c, ldc, pool ? pool : own);
+    }
+
+    if (own)
+        chain_pool_free(own);
+}
+
+/**
+ * C += A1 * ... * An in the order with the fewest flops, with gemm for
+ * every product
+ */
+void Chain_MMult(int count, ChainOperand *ops, double *c, int ldc, ChainPool *pool) {
+    ChainPlan *plan = chain_plan(count, ops, NULL);
+
+    chain_execute(plan, ops, c, ldc, pool);
+    free_chain_plan(plan);
+}
@@ -0,0 +1,40 @@
+/* Products of chains of matrices, C += A1 * A2 * ... * An */
+
+#include <stddef.h>
+
+typedef void (*MMultEngine)(int, int, int, double *, int, double *, int, double *, int);
+
+/* Picks the engine for an m x k by k x n product */
+typedef MMultEngine (*EngineSelector)(int, int, int);
+
+typedef struct {
+    int rows, cols;
+    double *data;                   /* column-major */
+    int ld;
+} ChainOperand;
+
+typedef struct {
+    int count;                      /* number of operands */
+    int *rows;                      /* count + 1 dimensions, operand i is rows[i] x rows[i + 1] */
+    int *split;                     /* product of operands i..j is (i..split) * (split+1..j) */
+    MMultEngine *engine;            /* engine for the product of operands i..j */
+    double flops;                   /* of the whole plan */
+} ChainPlan;
+
+/* Reusable buffers for the intermediate products */
+typedef struct {
+    int count, capacity;
+    double **buf;
+    size_t *size;                   /* in elements */
+    int *in_use;
+} ChainPool;
+
+ChainPlan *chain_plan(int, ChainOperand *, EngineSelector);
+void chain_execute(ChainPlan *, ChainOperand *, double *, int, ChainPool *);
+void free_chain_plan(ChainPlan *);
+double chain_flops_left_to_right(int, ChainOperand *);
+
+ChainPool *chain_pool_create();
+void chain_pool_free(ChainPool *);
+
+void Chain_MMult(int, ChainOperand *, double *, int, ChainPool *);
@@ -0,0 +1,93 @@
+/**
+ * Benchmark of the speed of Approx_MMult against its error.
+ * For every size, A and B are size x size with entries in [ 0, 1 ), like
+ * counts or frequencies, and the columns of A and rows of B fall off as
+ * 1 / sqrt( p+1 ), so that some terms of the product weigh more than
+ * others. The exact product is gemm's; then each ratio of the inner
+ * dimension is sampled and timed, best of NREPEATS runs.
+ * Gflops counts the 2 size^3 operations of the exact product, so it is
+ * the speed the approximation appears to have, and Speedup is against
+ * gemm. Err is the relative Frobenius error from the exact product and
+ * EstErr the estimate returned by Approx_MMult.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "utils.h"
+#include "gemm.h"
+#include "approx.h"
+
+#define PFIRST 256
+#define PLAST  2048
+#define NREPEATS 3
+
+static const double ratios[] = {0.01, 0.02, 0.05, 0.1, 0.2, 0.5};
+
+/**
+ * |X - Y| / |Y| in the Frobenius norm
+ * @param len: number of elements of x and y, stored contiguously
+ */
+static double relative_error(long len, double *x, double *y) {
+    double diff = 0.0, norm = 0.0;
+
+    for (long i = 0; i < len; i++) {
+        diff += (x[i] - y[i]) * (x[i] - y[i]);
+        norm += y[i] * y[i];
+    }
+    return sqrt(diff / norm);
+}
+
+int main() {
+    double drand48();
+
+    for (int p = PFIRST; p <= PLAST; p *= 2) {
+        double gflops = 2.0 * p * p * p * 1.0e-09;
+        double *a = malloc((size_t) p * p * sizeof(double));
+        double *b = malloc((size_t) p * p * sizeof(double));
+        double *c = malloc((size_t) p * p * sizeof(double));
+        double *cref = malloc((size_t) p * p * sizeof(double));
+        double dtime, dtime_exact = 0.0;
+
+        for (int j = 0; j < p; j++)
+            for (int i = 0; i < p; i++) {
+                a[(size_t) j * p + i] = drand48() / sqrt(j + 1.0);
+                b[(size_t) j * p + i] = drand48() / sqrt(i + 1.0);
+            }
+
+        for (int rep = 0; rep < NREPEATS; rep++) {
+            memset(cref, 0, (size_t) p * p * sizeof(double));
+            dtime = dclock();
+            gemm(p, p, p, a, p, b, p, cref, p);
+            dtime = dclock() - dtime;
+            if (rep == 0 || dtime < dtime_exact)
+                dtime_exact = dtime;
+        }
+
+        for (int r = 0; r < sizeof(ratios) / sizeof(ratios[0]); r++) {
+            int s = APPROX_SAMPLES(ratios[r], p);
+            double dtime_best = 0.0, estimate = 0.0;
+
+            for (int rep = 0; rep < NREPEATS; rep++) {
+                memset(c, 0, (size_t) p * p * sizeof(double));
+                dtime = dclock();
+                estimate = Approx_MMult(p, p, p, a, p, b, p, c, p, s, 1);
+                dtime = dclock() - dtime;
+                if (rep == 0 || dtime < dtime_best)
+                    dtime_best = dtime;
+            }
+
+            printf("%d,%g,%d,%le,%le,%le,%le\n", p, ratios[r], s, gflops / dtime_best, dtime_exact / dtime_best,
+                   relative_error((long) p * p, c, cref), estimate);
+            fflush(stdout);
+        }
+
+        free(a);
+        free(b);
+        free(c);
+        free(cref);
+    }
+
+    exit(0);
+}
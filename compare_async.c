@@ -0,0 +1,104 @@
+/**
+ * Benchmark for the asynchronous GEMM queue.
+ * Submits NLARGE products of size LARGE followed by NSMALL SMALL x SMALL_N
+ * ones, which is how a latency-sensitive caller ends up behind a batch
+ * job, and collects them all. Prints, for 1 to MAX_THREADS workers (no
+ * more than the thread budget, CACHEMULTI_THREADS or the processors), the
+ * time of the same products run one after another with gemm, the time until
+ * all jobs were collected, the mean latency from submit to completion of
+ * the small and of the large jobs, and the largest difference from the
+ * serial results.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "utils.h"
+#include "async_gemm.h"
+#include "gemm.h"
+
+#define NLARGE 4
+#define LARGE 1024
+#define NSMALL 16
+#define SMALL 128
+#define SMALL_N 50
+#define NJOBS (NLARGE + NSMALL)
+#define MAX_THREADS 4
+
+int main() {
+    double *a[NJOBS], *b[NJOBS], *c[NJOBS], *cref[NJOBS];
+    int size[NJOBS], cols[NJOBS];
+
+    for (int q = 0; q < NJOBS; q++) {
+        int p = size[q] = (q < NLARGE ? LARGE : SMALL);
+        int n = cols[q] = (q < NLARGE ? LARGE : SMALL_N);
+
+        a[q] = malloc((size_t) p * p * sizeof(double));
+        b[q] = malloc((size_t) p * n * sizeof(double));
+        c[q] = malloc((size_t) p * n * sizeof(double));
+        cref[q] = calloc((size_t) p * n, sizeof(double));
+        random_matrix(p, p, a[q], p);
+        random_matrix(p, n, b[q], p);
+    }
+
+    double dtime_serial = dclock();
+    for (int q = 0; q < NJOBS; q++)
+        gemm(size[q], cols[q], size[q], a[q], size[q], b[q], size[q], cref[q], size[q]);
+    dtime_serial = dclock() - dtime_serial;
+
+    for (int threads = 1; threads <= MAX_THREADS; threads *= 2) {
+        GemmJob *job[NJOBS];
+        double submitted[NJOBS], latency_small = 0.0, latency_large = 0.0, diff_max = 0.0;
+        int collected = 0, done[NJOBS] = {0};
+
+        int workers = gemm_pool_start(threads);
+
+        for (int q = 0; q < NJOBS; q++)
+            for (long i = 0; i < (long) size[q] * cols[q]; i++)
+                c[q][i] = 0.0;
+
+        double dtime = dclock();
+        for (int q = 0; q < NJOBS; q++) {
+            submitted[q] = dclock();
+            job[q] = gemm_submit(size[q], cols[q], size[q], a[q], size[q], b[q], size[q], c[q], size[q]);
+        }
+
+        /* Poll, as a caller doing other work would, without taking the
+           processor from the workers */
+        while (collected < NJOBS) {
+            usleep(100);
+            for (int q = 0; q < NJOBS; q++) {
+                if (!done[q] && gemm_test(job[q])) {
+                    double latency = dclock() - submitted[q];
+
+                    done[q] = 1;
+                    collected++;
+                    if (q < NLARGE)
+                        latency_large += latency / NLARGE;
+                    else
+                        latency_small += latency / NSMALL;
+                }
+            }
+        }
+        dtime = dclock() - dtime;
+
+        gemm_pool_stop();
+
+        for (int q = 0; q < NJOBS; q++) {
+            double diff = compare_matrices(size[q], cols[q], c[q], size[q], cref[q], size[q]);
+            diff_max = (diff > diff_max ? diff : diff_max);
+        }
+
+        printf("%d,%le,%le,%le,%le,%le\n", workers, dtime_serial, dtime,
+               latency_small, latency_large, diff_max);
+        fflush(stdout);
+    }
+
+    for (int q = 0; q < NJOBS; q++) {
+        free(a[q]);
+        free(b[q]);
+        free(c[q]);
+        free(cref[q]);
+    }
+    exit(0);
+}
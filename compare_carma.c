@@ -0,0 +1,61 @@
+/**
+ * Strong scaling benchmark for the recursive parallel engine.
+ * For every size, times MY_MMult (the blocked engine, one thread) and
+ * Strassen_multithread (seven threads at the top level) once, then
+ * CARMA_MMult on 1 to MAX_THREADS threads on the same problem.
+ * Diff is the largest difference of the CARMA results from MY_MMult.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "utils.h"
+#include "carma.h"
+
+#define PFIRST 512
+#define PLAST  4096
+#define MAX_THREADS 16
+
+void MY_MMult(int, int, int, double *, int, double *, int, double *, int);
+/* Strassen_multithread.c, built with its MY_MMult renamed */
+void Strassen_multithread_MMult(int, int, int, double *, int, double *, int, double *, int);
+
+int main() {
+    for (int p = PFIRST; p <= PLAST; p *= 2) {
+        double gflops = 2.0 * p * p * p * 1.0e-09;
+        double dtime, gflops_blocked, gflops_strassen;
+        double *a = malloc((size_t) p * p * sizeof(double));
+        double *b = malloc((size_t) p * p * sizeof(double));
+        double *c = malloc((size_t) p * p * sizeof(double));
+        double *cref = calloc((size_t) p * p, sizeof(double));
+
+        random_matrix(p, p, a, p);
+        random_matrix(p, p, b, p);
+
+        dtime = dclock();
+        MY_MMult(p, p, p, a, p, b, p, cref, p);
+        gflops_blocked = gflops / (dclock() - dtime);
+
+        for (long i = 0; i < (long) p * p; i++) c[i] = 0.0;
+        dtime = dclock();
+        Strassen_multithread_MMult(p, p, p, a, p, b, p, c, p);
+        gflops_strassen = gflops / (dclock() - dtime);
+
+        for (int threads = 1; threads <= MAX_THREADS; threads *= 2) {
+            for (long i = 0; i < (long) p * p; i++) c[i] = 0.0;
+            dtime = dclock();
+            CARMA_MMult(p, p, p, a, p, b, p, c, p, threads);
+            dtime = dclock() - dtime;
+
+            printf("%d,%d,%le,%le,%le,%le\n", p, threads, gflops / dtime, gflops_blocked,
+                   gflops_strassen, compare_matrices(p, p, c, p, cref, p));
+            fflush(stdout);
+        }
+
+        free(a);
+        free(b);
+        free(c);
+        free(cref);
+    }
+
+    exit(0);
+}
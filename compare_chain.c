@@ -0,0 +1,91 @@
+/**
+ * Benchmark for the matrix chain planner.
+ * Multiplies chains of random matrices with random dimensions (multiples
+ * of 4 up to MAX_DIM) once in the order they are written and once with
+ * Chain_MMult, sharing one ChainPool across all the chains.
+ * Prints the Gflop of both orders, their times and the largest difference
+ * of the results.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+#include "chain.h"
+#include "gemm.h"
+
+#define NCHAINS 10
+#define MAX_COUNT 6
+#define MAX_DIM 1024
+
+/**
+ * C += A1 * ... * An multiplied from left to right
+ */
+void left_to_right(int count, ChainOperand *ops, double *c, int ldc) {
+    int m = ops[0].rows;
+    double *acc = malloc((size_t) m * ops[0].cols * sizeof(double)), *next;
+
+    copy_matrix(m, ops[0].cols, ops[0].data, ops[0].ld, acc, m);
+    for (int i = 1; i < count; i++) {
+        next = calloc((size_t) m * ops[i].cols, sizeof(double));
+        gemm(m, ops[i].cols, ops[i].rows, acc, m, ops[i].data, ops[i].ld, next, m);
+        free(acc);
+        acc = next;
+    }
+    for (int j = 0; j < ops[count - 1].cols; j++)
+        for (int i = 0; i < m; i++)
+            c[j * ldc + i] += acc[j * m + i];
+    free(acc);
+}
+
+int main() {
+    ChainPool *pool = chain_pool_create();
+    double drand48();
+
+    for (int t = 0; t < NCHAINS; t++) {
+        int count = 3 + t % (MAX_COUNT - 2);
+        int dims[MAX_COUNT + 1];
+        ChainOperand ops[MAX_COUNT];
+        ChainPlan *plan;
+        double dtime_left, dtime_plan, diff;
+        double *c, *cref;
+
+        /* Mix small and large dimensions, where the order matters most */
+        for (int i = 0; i <= count; i++)
+            dims[i] = 4 * (1 + (int) (drand48() * (drand48() < 0.5 ? 8 : MAX_DIM / 4)));
+
+        for (int i = 0; i < count; i++) {
+            ops[i].rows = dims[i];
+            ops[i].cols = dims[i + 1];
+            ops[i].ld = dims[i];
+            ops[i].data = malloc((size_t) dims[i] * dims[i + 1] * sizeof(double));
+            random_matrix(dims[i], dims[i + 1], ops[i].data, dims[i]);
+        }
+        c = calloc((size_t) dims[0] * dims[count], sizeof(double));
+        cref = calloc((size_t) dims[0] * dims[count], sizeof(double));
+
+        dtime_left = dclock();
+        left_to_right(count, ops, cref, dims[0]);
+        dtime_left = dclock() - dtime_left;
+
+        dtime_plan = dclock();
+        plan = chain_plan(count, ops, NULL);
+        chain_execute(plan, ops, c, dims[0], pool);
+        dtime_plan = dclock() - dtime_plan;
+
+        diff = compare_matrices(dims[0], dims[count], c, dims[0], cref, dims[0]);
+
+        printf("%d,%le,%le,%le,%le,%le\n", count, chain_flops_left_to_right(count, ops) * 1.0e-09,
+               plan->flops * 1.0e-09, dtime_left, dtime_plan, diff);
+        fflush(stdout);
+
+        free_chain_plan(plan);
+        for (int i = 0; i < count; i++)
+            free(ops[i].data);
+        free(c);
+        free(cref);
+    }
+
+    chain_pool_free(pool);
+    exit(0);
+}
@@ -0,0 +1,88 @@
+/**
+ * Benchmark for the complex double engines.
+ * For every size, MY_ZMMult of ZMMult_2x2_vecreg_subblock_cache.c and the
+ * 3M Strassen of ZStrassen.c (linked as ZStrassen_ZMMult) multiply the
+ * same random complex matrices, interleaved column-major, best of
+ * NREPEATS runs. Gflops counts the 8 size^3 real operations of the direct
+ * complex product for both, so the 3M method shows its saving as speed.
+ * Diff and DiffStrassen are the largest differences of any real or
+ * imaginary part from a plain triple loop.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+
+#define PFIRST 16
+#define PLAST  1024
+#define NREPEATS 2
+
+void MY_ZMMult(int, int, int, double *, int, double *, int, double *, int);
+void ZStrassen_ZMMult(int, int, int, double *, int, double *, int, double *, int);
+
+/**
+ * C += A * B for interleaved complex column-major matrices, one complex
+ * multiply-add at a time
+ */
+static void ZREF_MMult(int m, int n, int k, double *a, int lda, double *b, int ldb, double *c, int ldc) {
+    for (int j = 0; j < n; j++)
+        for (int p = 0; p < k; p++) {
+            double b_re = b[2 * (j * ldb + p)], b_im = b[2 * (j * ldb + p) + 1];
+
+            for (int i = 0; i < m; i++) {
+                double a_re = a[2 * (p * lda + i)], a_im = a[2 * (p * lda + i) + 1];
+
+                c[2 * (j * ldc + i)] += a_re * b_re - a_im * b_im;
+                c[2 * (j * ldc + i) + 1] += a_re * b_im + a_im * b_re;
+            }
+        }
+}
+
+/**
+ * Time one engine
+ * @return: the best time, with its result left in c
+ */
+static double time_engine(void (*zmmult)(int, int, int, double *, int, double *, int, double *, int),
+                          int p, double *a, double *b, double *c) {
+    double dtime, dtime_best = 0.0;
+
+    for (int rep = 0; rep < NREPEATS; rep++) {
+        memset(c, 0, (size_t) 2 * p * p * sizeof(double));
+        dtime = dclock();
+        zmmult(p, p, p, a, p, b, p, c, p);
+        dtime = dclock() - dtime;
+        if (rep == 0 || dtime < dtime_best)
+            dtime_best = dtime;
+    }
+    return dtime_best;
+}
+
+int main() {
+    for (int p = PFIRST; p <= PLAST; p *= 2) {
+        double gflops = 8.0 * p * p * p * 1.0e-09;
+        size_t bytes = (size_t) 2 * p * p * sizeof(double);
+        double *a = malloc(bytes), *b = malloc(bytes), *c = malloc(bytes), *cref = calloc(1, bytes);
+        double dtime, dtime_strassen, diff, diff_strassen;
+
+        /* A complex matrix is a real one with twice the rows */
+        random_matrix(2 * p, p, a, 2 * p);
+        random_matrix(2 * p, p, b, 2 * p);
+        ZREF_MMult(p, p, p, a, p, b, p, cref, p);
+
+        dtime = time_engine(MY_ZMMult, p, a, b, c);
+        diff = compare_matrices(2 * p, p, c, 2 * p, cref, 2 * p);
+        dtime_strassen = time_engine(ZStrassen_ZMMult, p, a, b, c);
+        diff_strassen = compare_matrices(2 * p, p, c, 2 * p, cref, 2 * p);
+
+        printf("%d,%le,%le,%le,%le\n", p, gflops / dtime, diff, gflops / dtime_strassen, diff_strassen);
+        fflush(stdout);
+
+        free(a);
+        free(b);
+        free(c);
+        free(cref);
+    }
+
+    exit(0);
+}
@@ -0,0 +1,95 @@
+/**
+ * Benchmark of concurrent callers sharing the thread budget.
+ * 1 to MAX_CALLERS threads each make NCALLS calls of gemm_ctx at once, on
+ * a context of Strassen_multithread, which on its own would start seven
+ * threads per call. Each count of callers runs twice: with the budget of
+ * threads.c at its default, the number of processors, and with a budget
+ * so large that every call gets all the threads it asks for, as before
+ * there was one. Gflops is the throughput of all callers together and
+ * Diff the largest difference of any result from REF_MMult.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "utils.h"
+#include "gemm.h"
+#include "threads.h"
+
+#define SIZE 512
+#define NCALLS 4
+#define MAX_CALLERS 16
+#define UNLIMITED (1 << 20)
+
+typedef struct {
+    GemmContext *ctx;
+    double *a, *b, *c;
+} Caller;
+
+/**
+ * Thread function: NCALLS products into the caller's C
+ * @param arg: Caller
+ * @return: NULL
+ */
+static void *call(void *arg) {
+    Caller *caller = arg;
+
+    for (int i = 0; i < NCALLS; i++)
+        gemm_ctx(caller->ctx, SIZE, SIZE, SIZE, caller->a, SIZE, caller->b, SIZE, caller->c, SIZE);
+    return NULL;
+}
+
+int main() {
+    int budget = threads_max();
+    size_t bytes = (size_t) SIZE * SIZE * sizeof(double);
+    double *a = malloc(bytes), *b = malloc(bytes), *cref = calloc(1, bytes);
+    GemmContext *ctx = gemm_context_create(0, "Strassen_multithread");
+    Caller callers[MAX_CALLERS];
+    pthread_t threads[MAX_CALLERS];
+
+    random_matrix(SIZE, SIZE, a, SIZE);
+    random_matrix(SIZE, SIZE, b, SIZE);
+    REF_MMult(SIZE, SIZE, SIZE, a, SIZE, b, SIZE, cref, SIZE);
+    for (int i = 0; i < SIZE * SIZE; i++)
+        cref[i] *= NCALLS;
+
+    for (int i = 0; i < MAX_CALLERS; i++) {
+        Caller caller = {ctx, a, b, malloc(bytes)};
+        callers[i] = caller;
+    }
+
+    for (int n = 1; n <= MAX_CALLERS; n *= 2)
+        for (int limited = 1; limited >= 0; limited--) {
+            double gflops = 2.0 * SIZE * SIZE * SIZE * NCALLS * n * 1.0e-09, diff = 0.0, dtime;
+
+            threads_set_max(limited ? budget : UNLIMITED);
+            for (int i = 0; i < n; i++)
+                memset(callers[i].c, 0, bytes);
+
+            dtime = dclock();
+            for (int i = 0; i < n; i++)
+                if (pthread_create(&threads[i], NULL, call, &callers[i])) {
+                    fprintf(stderr, "Error creating thread %d\n", i);
+                    exit(1);
+                }
+            for (int i = 0; i < n; i++)
+                pthread_join(threads[i], NULL);
+            dtime = dclock() - dtime;
+
+            for (int i = 0; i < n; i++) {
+                double d = compare_matrices(SIZE, SIZE, callers[i].c, SIZE, cref, SIZE);
+                diff = d > diff ? d : diff;
+            }
+            printf("%d,%d,%d,%le,%le\n", n, SIZE, limited ? budget : 0, gflops / dtime, diff);
+            fflush(stdout);
+        }
+
+    for (int i = 0; i < MAX_CALLERS; i++)
+        free(callers[i].c);
+    gemm_context_destroy(ctx);
+    free(a);
+    free(b);
+    free(cref);
+    exit(0);
+}
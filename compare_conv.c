@@ -0,0 +1,137 @@
+/**
+ * Benchmark of MY_Conv2d, the implicit GEMM convolution, against the
+ * explicit lowering: im2col into a buffer, then MY_MMult. For every layer
+ * of the table both run on the same input, best of NREPEATS runs, the
+ * explicit one with the time to fill its buffer. Im2colMB is the size of
+ * that buffer, which MY_Conv2d never allocates.
+ * Diff is the largest difference of MY_Conv2d from a direct convolution.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+#include "conv.h"
+
+#define NREPEATS 3
+
+/* Round up to a multiple of 4 */
+#define PAD4( i ) ( ( (i)+3 ) & ~3 )
+
+void MY_MMult(int, int, int, double *, int, double *, int, double *, int);
+
+/* batch, height, width, channels, kh, kw, filters, stride, pad, dilation */
+static const ConvShape layers[] = {
+        {1, 56, 56, 64, 3, 3, 64, 1, 1, 1},
+        {1, 28, 28, 128, 3, 3, 128, 1, 1, 1},
+        {1, 14, 14, 256, 3, 3, 256, 1, 1, 1},
+        {1, 7, 7, 512, 3, 3, 512, 1, 1, 1},
+        {1, 56, 56, 64, 1, 1, 256, 1, 0, 1},
+        {1, 224, 224, 3, 7, 7, 64, 2, 3, 1},
+        {4, 28, 28, 64, 3, 3, 64, 1, 2, 2},
+        {1, 32, 32, 64, 3, 3, 10, 1, 1, 1},
+        {2, 15, 15, 16, 5, 5, 3, 1, 0, 1},
+};
+
+/**
+ * The im2col matrix of the input, k x ldb column-major with a column per
+ * output pixel, in the row order of PackMatrixBConv; zero in the padding
+ */
+static void im2col(const ConvShape *s, int out_h, int out_w, double *in, double *b, int ldb) {
+    int k = s->kh * s->kw * s->channels;
+
+    for (int pixel = 0; pixel < s->batch * out_h * out_w; pixel++) {
+        int img = pixel / (out_h * out_w), oh = pixel / out_w % out_h, ow = pixel % out_w;
+
+        for (int r = 0; r < k; r++) {
+            int ci = r % s->channels, kw = r / s->channels % s->kw, kh = r / s->channels / s->kw;
+            int ih = oh * s->stride - s->pad + kh * s->dilation;
+            int iw = ow * s->stride - s->pad + kw * s->dilation;
+
+            b[(long) pixel * ldb + r] = ih >= 0 && ih < s->height && iw >= 0 && iw < s->width ?
+                                        in[(((long) img * s->height + ih) * s->width + iw) * s->channels + ci] : 0.0;
+        }
+    }
+}
+
+/**
+ * out += conv( in, filter ), one multiply-add at a time
+ */
+static void direct_conv(const ConvShape *s, int out_h, int out_w, double *in, double *filter, double *out) {
+    for (int img = 0; img < s->batch; img++)
+        for (int oh = 0; oh < out_h; oh++)
+            for (int ow = 0; ow < out_w; ow++)
+                for (int kh = 0; kh < s->kh; kh++)
+                    for (int kw = 0; kw < s->kw; kw++) {
+                        int ih = oh * s->stride - s->pad + kh * s->dilation;
+                        int iw = ow * s->stride - s->pad + kw * s->dilation;
+                        if (ih < 0 || ih >= s->height || iw < 0 || iw >= s->width)
+                            continue;
+
+                        double *x = &in[(((long) img * s->height + ih) * s->width + iw) * s->channels];
+                        double *w = &filter[(long) (kh * s->kw + kw) * s->channels * s->filters];
+                        double *y = &out[(((long) img * out_h + oh) * out_w + ow) * s->filters];
+                        for (int ci = 0; ci < s->channels; ci++)
+                            for (int co = 0; co < s->filters; co++)
+                                y[co] += x[ci] * w[ci * s->filters + co];
+                    }
+}
+
+int main() {
+    for (int l = 0; l < sizeof(layers) / sizeof(layers[0]); l++) {
+        const ConvShape *s = &layers[l];
+        int out_h = CONV_OUT_SIZE(s->height, s->kh, s->stride, s->pad, s->dilation);
+        int out_w = CONV_OUT_SIZE(s->width, s->kw, s->stride, s->pad, s->dilation);
+        int m = s->filters, k = s->kh * s->kw * s->channels, n = s->batch * out_h * out_w;
+        int m4 = PAD4(m), n4 = PAD4(n);
+        double gflops = 2.0 * m * n * k * 1.0e-09;
+        double *in = malloc((size_t) s->batch * s->height * s->width * s->channels * sizeof(double));
+        double *filter = malloc((size_t) k * m * sizeof(double));
+        double *filter_pad = calloc((size_t) k * m4, sizeof(double));
+        double *out = malloc((size_t) m4 * n4 * sizeof(double));
+        double *out_ref = calloc((size_t) m * n, sizeof(double));
+        double *cols = calloc((size_t) k * n4, sizeof(double));
+        double dtime, dtime_implicit = 0.0, dtime_explicit = 0.0;
+
+        random_matrix(s->channels, s->batch * s->height * s->width, in, s->channels);
+        random_matrix(m, k, filter, m);
+        copy_matrix(m, k, filter, m, filter_pad, m4);
+        direct_conv(s, out_h, out_w, in, filter, out_ref);
+
+        for (int rep = 0; rep < NREPEATS; rep++) {
+            memset(out, 0, (size_t) m * n * sizeof(double));
+            dtime = dclock();
+            MY_Conv2d(s, in, filter, out);
+            dtime = dclock() - dtime;
+            if (rep == 0 || dtime < dtime_implicit)
+                dtime_implicit = dtime;
+        }
+        double diff = compare_matrices(m, n, out, m, out_ref, m);
+
+        /* The explicit lowering pads the filters and the pixels to a
+           multiple of 4 for MY_MMult */
+        for (int rep = 0; rep < NREPEATS; rep++) {
+            memset(out, 0, (size_t) m4 * n4 * sizeof(double));
+            dtime = dclock();
+            im2col(s, out_h, out_w, in, cols, k);
+            MY_MMult(m4, n4, k, filter_pad, m4, cols, k, out, m4);
+            dtime = dclock() - dtime;
+            if (rep == 0 || dtime < dtime_explicit)
+                dtime_explicit = dtime;
+        }
+
+        printf("%d,%d,%d,%d,%d,%d,%d,%le,%le,%le,%le\n", s->batch, s->height, s->channels, s->kh, s->filters,
+               s->stride, s->dilation, gflops / dtime_implicit, gflops / dtime_explicit,
+               (double) k * n4 * sizeof(double) / (1024 * 1024), diff);
+        fflush(stdout);
+
+        free(in);
+        free(filter);
+        free(filter_pad);
+        free(out);
+        free(out_ref);
+        free(cols);
+    }
+
+    exit(0);
+}
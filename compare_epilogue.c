@@ -0,0 +1,124 @@
+/**
+ * Benchmark of the fused epilogue of MY_MMult_ep.
+ * For every size and activation, C = act( C + A * B + bias ) + residual is
+ * computed twice from the same C: by MY_MMult_ep in the write-back of the
+ * last kc block, and by MY_MMult followed by separate passes over C for
+ * the bias, the activation and the residual, as without the epilogue.
+ * Gflops counts the 2 m n k operations of the product for both, best of
+ * NREPEATS runs, and Speedup is the time of the separate passes over
+ * that of the fused epilogue. Diff is the largest difference of the fused result from
+ * REF_MMult followed by the same passes. The last rows have k = 0, where
+ * only the epilogue is left to apply.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "utils.h"
+#include "epilogue.h"
+
+#define NREPEATS 2
+
+void MY_MMult(int, int, int, double *, int, double *, int, double *, int);
+
+/* m = n, k */
+static const int shapes[][2] = {
+        {64,   64},
+        {128,  128},
+        {256,  256},
+        {512,  512},
+        {1024, 1024},
+        {256,  0},
+};
+
+static const int activations[] = {EPILOGUE_NONE, EPILOGUE_RELU, EPILOGUE_GELU};
+static const char *activation_names[] = {"none", "relu", "gelu"};
+
+/**
+ * The epilogue as three passes over the m x n matrix C
+ */
+static void separate_passes(int m, int n, double *c, const Epilogue *ep) {
+    for (int j = 0; j < n; j++)
+        for (int i = 0; i < m; i++)
+            c[j * m + i] += ep->bias[i];
+
+    for (int j = 0; j < n; j++)
+        for (int i = 0; i < m; i++) {
+            double x = c[j * m + i];
+
+            if (ep->activation == EPILOGUE_RELU)
+                c[j * m + i] = x > 0.0 ? x : 0.0;
+            else if (ep->activation == EPILOGUE_GELU)
+                c[j * m + i] = x * 0.5 * (1.0 + erf(x * M_SQRT1_2));
+        }
+
+    for (int j = 0; j < n; j++)
+        for (int i = 0; i < m; i++)
+            c[j * m + i] += ep->residual[j * ep->ldr + i];
+}
+
+int main() {
+    for (int s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++) {
+        int m = shapes[s][0], n = m, k = shapes[s][1];
+        double gflops = 2.0 * m * n * k * 1.0e-09;
+        size_t bytes = (size_t) m * n * sizeof(double);
+        double *a = malloc((size_t) m * (k + 1) * sizeof(double));
+        double *b = malloc((size_t) (k + 1) * n * sizeof(double));
+        double *cold = malloc(bytes), *c = malloc(bytes), *cref = malloc(bytes);
+        double *product = malloc(bytes), *residual = malloc(bytes), *bias = malloc(m * sizeof(double));
+
+        random_matrix(m, k, a, m);
+        random_matrix(k, n, b, k);
+        random_matrix(m, n, cold, m);
+        random_matrix(m, n, residual, m);
+        random_matrix(m, 1, bias, m);
+
+        /* Cold + A * B, once for the checks */
+        memcpy(product, cold, bytes);
+        REF_MMult(m, n, k, a, m, b, k, product, m);
+
+        for (int act = 0; act < sizeof(activations) / sizeof(activations[0]); act++) {
+            Epilogue ep = {bias, activations[act], residual, m};
+            double dtime, dtime_fused = 0.0, dtime_separate = 0.0, diff;
+
+            for (int rep = 0; rep < NREPEATS; rep++) {
+                memcpy(c, cold, bytes);
+                dtime = dclock();
+                MY_MMult_ep(m, n, k, a, m, b, k, c, m, &ep);
+                dtime = dclock() - dtime;
+                if (rep == 0 || dtime < dtime_fused)
+                    dtime_fused = dtime;
+            }
+
+            memcpy(cref, product, bytes);
+            separate_passes(m, n, cref, &ep);
+            diff = compare_matrices(m, n, c, m, cref, m);
+
+            for (int rep = 0; rep < NREPEATS; rep++) {
+                memcpy(c, cold, bytes);
+                dtime = dclock();
+                MY_MMult(m, n, k, a, m, b, k, c, m);
+                separate_passes(m, n, c, &ep);
+                dtime = dclock() - dtime;
+                if (rep == 0 || dtime < dtime_separate)
+                    dtime_separate = dtime;
+            }
+
+            printf("%d,%d,%s,%le,%le,%le,%le\n", m, k, activation_names[act], gflops / dtime_fused,
+                   gflops / dtime_separate, dtime_separate / dtime_fused, diff);
+            fflush(stdout);
+        }
+
+        free(a);
+        free(b);
+        free(cold);
+        free(c);
+        free(cref);
+        free(product);
+        free(residual);
+        free(bias);
+    }
+
+    exit(0);
+}
@@ -0,0 +1,137 @@
+/**
+ * Tuning benchmark for the gemm dispatcher.
+ * Times every engine that can multiply each problem, for square products
+ * of size 16 to PLAST, skinny ones (m = n = size, k = size / 8) and narrow
+ * ones (m = k = size, n = NARROW_N), on one
+ * thread and on all of them, best of NREPEATS runs. The fastest engine at each size becomes a
+ * rule of the decision table, and the table is written to the file given
+ * as argument (gemm_profile.txt by default), for GEMM_PROFILE to load.
+ * An engine more than DROP_RATIO times slower than the fastest is not
+ * timed at larger sizes of the same series.
+ * Diff is the largest difference from the blocked engine.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "utils.h"
+#include "gemm.h"
+
+#define PFIRST 16
+#define PLAST  2048
+#define NREPEATS 2
+#define DROP_RATIO 4.0
+/* Columns of B and C in the narrow series */
+#define NARROW_N 4
+
+/* The blocked engine, the reference of Diff */
+#define REFERENCE 2
+
+/**
+ * Time every engine on one size of a series and print a line per engine
+ * @param dropped: engines left out of the series, updated
+ * @return: index of the fastest engine
+ */
+static int time_engines(int shape, int size, int threads, int *dropped) {
+    int m = size, n = shape == GEMM_NARROW ? NARROW_N : size;
+    int k = shape == GEMM_SKINNY ? size / 8 : size;
+    double gflops = 2.0 * m * n * k * 1.0e-09, best = 0.0, rate[gemm_engine_count];
+    double *a = malloc((size_t) m * k * sizeof(double));
+    double *b = malloc((size_t) k * n * sizeof(double));
+    double *c = malloc((size_t) m * n * sizeof(double));
+    double *cref = calloc((size_t) m * n, sizeof(double));
+    int winner = REFERENCE;
+
+    for (int e = 0; e < gemm_engine_count; e++) rate[e] = 0.0;
+    random_matrix(m, k, a, m);
+    random_matrix(k, n, b, k);
+    gemm_engines[REFERENCE].mmult(m, n, k, a, m, b, k, cref, m);
+
+    for (int e = 0; e < gemm_engine_count; e++) {
+        const GemmEngine *engine = &gemm_engines[e];
+        double dtime, dtime_best = 0.0;
+
+        if (dropped[e] || (engine->threaded && threads == 1) || !engine->fits(m, n, k, a, m, b, k, c, m))
+            continue;
+
+        for (int rep = 0; rep < NREPEATS; rep++) {
+            for (long i = 0; i < (long) m * n; i++) c[i] = 0.0;
+            dtime = dclock();
+            engine->mmult(m, n, k, a, m, b, k, c, m);
+            dtime = dclock() - dtime;
+            if (rep == 0 || dtime < dtime_best)
+                dtime_best = dtime;
+        }
+
+        printf("%s,%d,%d,%s,%le,%le\n", gemm_shape_names[shape], size, threads,
+               engine->name, gflops / dtime_best, compare_matrices(m, n, c, m, cref, m));
+        fflush(stdout);
+
+        rate[e] = gflops / dtime_best;
+        if (rate[e] > best) {
+            best = rate[e];
+            winner = e;
+        }
+    }
+
+    /* Engines that are far behind will not catch up at the next size.
+       Calls too short for the clock give no ranking. */
+    for (int e = 0; e < gemm_engine_count && best < HUGE_VAL; e++)
+        if (rate[e] > 0.0 && rate[e] * DROP_RATIO < best)
+            dropped[e] = 1;
+
+    free(a);
+    free(b);
+    free(c);
+    free(cref);
+    return winner;
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = argc > 1 ? argv[1] : GEMM_PROFILE_FILE;
+    int all_threads = gemm_threads();
+    int budgets[2] = {all_threads, 1};
+    GemmRule rules[GEMM_MAX_RULES];
+    int count = 0;
+    char value[16];
+    FILE *f;
+
+    /* The series with threads come first, as a call that has them
+       should match their rules before those of one thread */
+    for (int t = all_threads > 1 ? 0 : 1; t < 2; t++) {
+        snprintf(value, sizeof(value), "%d", budgets[t]);
+        setenv("GEMM_THREADS", value, 1);
+
+        for (int shape = GEMM_SQUARE; shape <= GEMM_NARROW; shape++) {
+            int dropped[gemm_engine_count];
+            int first = count;
+
+            memset(dropped, 0, sizeof(dropped));
+            for (int p = shape == GEMM_SQUARE ? PFIRST : 4 * PFIRST; p <= PLAST; p *= 2) {
+                int winner = time_engines(shape, p, budgets[t], dropped);
+
+                /* Extend the last rule of the series, or start a new one */
+                if (count > first && rules[count - 1].engine == winner) {
+                    rules[count - 1].max_size = p;
+                } else if (count < GEMM_MAX_RULES) {
+                    GemmRule r = {shape, p, budgets[t], winner};
+                    rules[count++] = r;
+                }
+            }
+            /* The last engine of the series takes the larger sizes too */
+            if (count > first)
+                rules[count - 1].max_size = 0;
+        }
+    }
+
+    f = fopen(path, "w");
+    if (f == NULL) {
+        perror(path);
+        exit(1);
+    }
+    gemm_write_rules(f, rules, count);
+    fclose(f);
+
+    exit(0);
+}
@@ -0,0 +1,70 @@
+/**
+ * Benchmark of MY_MMult against the leading dimension.
+ * With lda = m, ldb = k and ldc = m on power-of-two sizes, the elements of
+ * a row of a matrix are a power of two apart and fall in the same cache
+ * sets. For every size, A, B and C are stored with each leading dimension
+ * of the sweep, size plus each of offsets and PADDED_LD( size ), and the product
+ * is timed on them, best of NREPEATS runs.
+ * Diff is the largest difference from REF_MMult.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "utils.h"
+
+#define PFIRST 256
+#define PLAST  2048
+#define NREPEATS 2
+
+void MY_MMult(int, int, int, double *, int, double *, int, double *, int);
+
+/* Even offsets, as MMult_4x4_vecreg loads A in aligned pairs */
+static const int offsets[] = {0, 2, 8, 16, 64};
+
+int main() {
+    int noffsets = sizeof(offsets) / sizeof(offsets[0]);
+
+    for (int p = PFIRST; p <= PLAST; p *= 2) {
+        double gflops = 2.0 * p * p * p * 1.0e-09;
+        double *a = malloc((size_t) p * p * sizeof(double));
+        double *b = malloc((size_t) p * p * sizeof(double));
+        double *cref = calloc((size_t) p * p, sizeof(double));
+
+        random_matrix(p, p, a, p);
+        random_matrix(p, p, b, p);
+        REF_MMult(p, p, p, a, p, b, p, cref, p);
+
+        for (int o = 0; o <= noffsets; o++) {
+            int ld = o < noffsets ? p + offsets[o] : PADDED_LD(p);
+            double *a_ld = malloc((size_t) ld * p * sizeof(double));
+            double *b_ld = malloc((size_t) ld * p * sizeof(double));
+            double *c_ld = malloc((size_t) ld * p * sizeof(double));
+            double dtime, dtime_best = 0.0;
+
+            copy_matrix(p, p, a, p, a_ld, ld);
+            copy_matrix(p, p, b, p, b_ld, ld);
+
+            for (int rep = 0; rep < NREPEATS; rep++) {
+                for (long i = 0; i < (long) ld * p; i++) c_ld[i] = 0.0;
+                dtime = dclock();
+                MY_MMult(p, p, p, a_ld, ld, b_ld, ld, c_ld, ld);
+                dtime = dclock() - dtime;
+                if (rep == 0 || dtime < dtime_best)
+                    dtime_best = dtime;
+            }
+
+            printf("%d,%d,%le,%le\n", p, ld, gflops / dtime_best, compare_matrices(p, p, c_ld, ld, cref, p));
+            fflush(stdout);
+
+            free(a_ld);
+            free(b_ld);
+            free(c_ld);
+        }
+
+        free(a);
+        free(b);
+        free(cref);
+    }
+
+    exit(0);
+}
@@ -0,0 +1,162 @@
+/**
+ * Benchmark for the int8 and bf16 engines, MY_QMMult and MY_BMMult.
+ * The operands are random doubles, rounded to each format:
+ *  - int8: A to unsigned 8 bits with a scale and zero point per row, B to
+ *    signed 8 bits with a scale and zero point per column, both
+ *    asymmetric so that the zero points take part.
+ *  - bf16: A and B to bfloat16, see copy_matrix_to_bf16.
+ * Each engine is timed into an fp32 C, best of NREPEATS runs, and DiffQ
+ * and DiffB are the largest differences from REF_MMult on the operands
+ * the engine actually saw, dequantized or widened back to double, so they
+ * measure the fp32 arithmetic of the engine and not the rounding of the
+ * inputs. Shapes other than squares check the edges of the 8x4 blocks
+ * and the padding of k.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "utils.h"
+
+#define NREPEATS 2
+
+void MY_QMMult(int, int, int, unsigned char *, int, signed char *, int, float *, int,
+               float *, int *, float *, int *);
+void MY_BMMult(int, int, int, unsigned short *, int, unsigned short *, int, float *, int);
+
+/* m, n, k */
+static const int shapes[][3] = {
+        {64,   64,   64},
+        {128,  128,  128},
+        {256,  256,  256},
+        {512,  512,  512},
+        {1024, 1024, 1024},
+        {2048, 2048, 2048},
+        {127,  61,   133},
+        {1001, 999,  997},
+};
+
+/**
+ * Round count values x[ 0 ], x[ stride ], ... to integers in [ lo, hi ]
+ * with their own scale and zero point, and write back the values they
+ * stand for
+ * @param q: the integers, at the same positions as the values
+ */
+static void quantize(int count, int stride, double *x, int lo, int hi, int *q, float *scale, int *zero) {
+    double min = x[0], max = x[0];
+
+    for (int i = 1; i < count; i++) {
+        min = fmin(min, x[i * stride]);
+        max = fmax(max, x[i * stride]);
+    }
+    *scale = (float) ((max - min) / (hi - lo));
+    *zero = (int) lrint(lo - min / *scale);
+    *zero = *zero < lo ? lo : *zero > hi ? hi : *zero;
+
+    for (int i = 0; i < count; i++) {
+        int v = (int) lrint(x[i * stride] / *scale) + *zero;
+
+        q[i * stride] = v < lo ? lo : v > hi ? hi : v;
+        x[i * stride] = (double) *scale * (q[i * stride] - *zero);
+    }
+}
+
+/**
+ * Copy of a bf16 matrix widened to double, which is exact
+ */
+static void copy_matrix_from_bf16(int m, int n, unsigned short *a, int lda, double *b, int ldb) {
+    union { float f; unsigned int u; } x;
+
+    for (int j = 0; j < n; j++)
+        for (int i = 0; i < m; i++) {
+            x.u = (unsigned int) a[j * lda + i] << 16;
+            b[j * ldb + i] = x.f;
+        }
+}
+
+int main() {
+    for (int s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++) {
+        int m = shapes[s][0], n = shapes[s][1], k = shapes[s][2];
+        double gflops = 2.0 * m * n * k * 1.0e-09;
+        double *a = malloc((size_t) m * k * sizeof(double));
+        double *b = malloc((size_t) k * n * sizeof(double));
+        double *cref = malloc((size_t) m * n * sizeof(double));
+        double *cd = malloc((size_t) m * n * sizeof(double));
+        float *c = malloc((size_t) m * n * sizeof(float));
+        int *q = malloc((size_t) (m > n ? m : n) * k * sizeof(int));
+        unsigned char *qa = malloc((size_t) m * k);
+        signed char *qb = malloc((size_t) k * n);
+        unsigned short *ba = malloc((size_t) m * k * sizeof(unsigned short));
+        unsigned short *bb = malloc((size_t) k * n * sizeof(unsigned short));
+        float *scale_a = malloc(m * sizeof(float)), *scale_b = malloc(n * sizeof(float));
+        int *zero_a = malloc(m * sizeof(int)), *zero_b = malloc(n * sizeof(int));
+        double dtime, dtime_q = 0.0, dtime_b = 0.0, diff_q, diff_b;
+
+        /* int8: rows of A, then columns of B */
+        random_matrix(m, k, a, m);
+        random_matrix(k, n, b, k);
+        for (int i = 0; i < m; i++)
+            quantize(k, m, &a[i], 0, 255, &q[i], &scale_a[i], &zero_a[i]);
+        for (long i = 0; i < (long) m * k; i++)
+            qa[i] = (unsigned char) q[i];
+        for (int j = 0; j < n; j++)
+            quantize(k, 1, &b[(size_t) j * k], -128, 127, &q[(size_t) j * k], &scale_b[j], &zero_b[j]);
+        for (long i = 0; i < (long) k * n; i++)
+            qb[i] = (signed char) q[i];
+
+        for (int rep = 0; rep < NREPEATS; rep++) {
+            memset(c, 0, (size_t) m * n * sizeof(float));
+            dtime = dclock();
+            MY_QMMult(m, n, k, qa, m, qb, k, c, m, scale_a, zero_a, scale_b, zero_b);
+            dtime = dclock() - dtime;
+            if (rep == 0 || dtime < dtime_q)
+                dtime_q = dtime;
+        }
+        memset(cref, 0, (size_t) m * n * sizeof(double));
+        REF_MMult(m, n, k, a, m, b, k, cref, m);
+        copy_matrix_from_float(m, n, c, m, cd, m);
+        diff_q = compare_matrices(m, n, cd, m, cref, m);
+
+        /* bf16 */
+        random_matrix(m, k, a, m);
+        random_matrix(k, n, b, k);
+        copy_matrix_to_bf16(m, k, a, m, ba, m);
+        copy_matrix_to_bf16(k, n, b, k, bb, k);
+        copy_matrix_from_bf16(m, k, ba, m, a, m);
+        copy_matrix_from_bf16(k, n, bb, k, b, k);
+
+        for (int rep = 0; rep < NREPEATS; rep++) {
+            memset(c, 0, (size_t) m * n * sizeof(float));
+            dtime = dclock();
+            MY_BMMult(m, n, k, ba, m, bb, k, c, m);
+            dtime = dclock() - dtime;
+            if (rep == 0 || dtime < dtime_b)
+                dtime_b = dtime;
+        }
+        memset(cref, 0, (size_t) m * n * sizeof(double));
+        REF_MMult(m, n, k, a, m, b, k, cref, m);
+        copy_matrix_from_float(m, n, c, m, cd, m);
+        diff_b = compare_matrices(m, n, cd, m, cref, m);
+
+        printf("%d,%d,%d,%le,%le,%le,%le\n", m, n, k, gflops / dtime_q, diff_q, gflops / dtime_b, diff_b);
+        fflush(stdout);
+
+        free(a);
+        free(b);
+        free(cref);
+        free(cd);
+        free(c);
+        free(q);
+        free(qa);
+        free(qb);
+        free(ba);
+        free(bb);
+        free(scale_a);
+        free(scale_b);
+        free(zero_a);
+        free(zero_b);
+    }
+
+    exit(0);
+}
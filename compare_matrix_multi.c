@@ -1,19 +1,148 @@
 /**
  * Borrowed from GEMM optimization tutorial.
  * Modified to generate csv files we need for performance comparison.
+ * The last columns account for the memory of the last timed call of
+ * MY_MMult (see memstat.c): allocations, MB allocated, peak MB live and
+ * bytes leaked, then the peak resident set size of the process so far.
  */
 #include <stdio.h>
 #include <stdlib.h>
 
 #include "utils.h"
+#include "matfile.h"
+#include "memstat.h"
 
 #define PFIRST 4
 #define PLAST  4096
 #define NREPEATS 2
 
+#define MB( bytes ) ( (bytes) / ( 1024.0 * 1024.0 ) )
+
 void MY_MMult(int, int, int, double *, int, double *, int, double *, int);
+#ifdef WITH_SGEMM
+void MY_SMMult(int, int, int, float *, int, float *, int, float *, int);
+#endif
+#ifdef HAVE_MMULT_PACKED
+void MY_MMult_packed(int, int, int, double *, double *, double *, int);
+#endif
+
+/**
+ * Column-major m x k copy of A stored in the MATFILE_PACKED_A layout
+ */
+static double *unpack_a(int m, int k, double *packed) {
+    double *a = malloc((size_t) m * k * sizeof(double));
+
+    for (int p = 0; p < k; p += MATFILE_KC) {
+        int pb = k - p < MATFILE_KC ? k - p : MATFILE_KC;
+        for (int i = 0; i < m; i += MATFILE_PANEL)
+            for (int q = 0; q < pb; q++)
+                for (int r = 0; r < MATFILE_PANEL; r++)
+                    a[(size_t) (p + q) * m + i + r] = *packed++;
+    }
+    return a;
+}
+
+/**
+ * Column-major k x n copy of B stored in the MATFILE_PACKED_B layout
+ */
+static double *unpack_b(int k, int n, double *packed) {
+    double *b = malloc((size_t) k * n * sizeof(double));
+
+    for (int p = 0; p < k; p += MATFILE_KC) {
+        int pb = k - p < MATFILE_KC ? k - p : MATFILE_KC;
+        for (int j = 0; j < n; j += MATFILE_PANEL)
+            for (int q = 0; q < pb; q++)
+                for (int c = 0; c < MATFILE_PANEL; c++)
+                    b[(size_t) (j + c) * k + p + q] = *packed++;
+    }
+    return b;
+}
+
+/**
+ * Time MY_MMult on operands loaded from matrix files instead of random ones.
+ * Column-major operands are passed to MY_MMult as they are mapped; operands
+ * stored pre-packed (MATFILE_PACKED_A and MATFILE_PACKED_B) go straight to
+ * MY_MMult_packed when the linked engine provides it. Diff is against
+ * REF_MMult on the column-major operands, unpacked if need be.
+ * @param a_path: matrix file holding A
+ * @param b_path: matrix file holding B
+ */
+void time_files(const char *a_path, const char *b_path) {
+    MatFile *fa = matfile_open(a_path, 0);
+    MatFile *fb = matfile_open(b_path, 0);
+    int m = fa->header.rows, k = fa->header.cols, n = fb->header.cols;
+    int packed = fa->header.layout == MATFILE_PACKED_A && fb->header.layout == MATFILE_PACKED_B;
+    double dtime, dtime_best = 0.0, gflops = 2.0 * m * n * k * 1.0e-09;
+    double *a, *b, *c, *cref;
+
+    if (fb->header.rows != k) {
+        fprintf(stderr, "Cannot multiply a %dx%d matrix by a %ldx%d matrix\n",
+                m, k, (long) fb->header.rows, n);
+        exit(1);
+    }
+#ifdef MMULT_SQUARE_ONLY
+    int tile = m;
+
+    while (tile > 8 && tile % 2 == 0)
+        tile /= 2;
+    if (m != n || n != k || (m > 8 && tile != 8)) {
+        fprintf(stderr, "The linked engine multiplies square matrices of 8 times a power of two only\n");
+        exit(1);
+    }
+#endif
+#ifndef HAVE_MMULT_PACKED
+    if (packed) {
+        fprintf(stderr, "The linked engine cannot use pre-packed operands\n");
+        exit(1);
+    }
+#endif
+    if (!packed && (fa->header.layout != MATFILE_COL_MAJOR || fb->header.layout != MATFILE_COL_MAJOR)) {
+        fprintf(stderr, "Operands must both be column-major or both be pre-packed\n");
+        exit(1);
+    }
+    /* MY_MMult_packed walks whole 4-row and 4-column panels */
+    if (packed && (m % MATFILE_PANEL || n % MATFILE_PANEL)) {
+        fprintf(stderr, "Pre-packed operands must have a multiple of %d rows in A and columns in B\n",
+                MATFILE_PANEL);
+        exit(1);
+    }
+
+    c = (double *) malloc((size_t) m * n * sizeof(double));
+    for (int rep = 0; rep < NREPEATS; rep++) {
+        for (long i = 0; i < (long) m * n; i++)
+            c[i] = 0.0;
+
+        dtime = dclock();
+#ifdef HAVE_MMULT_PACKED
+        if (packed)
+            MY_MMult_packed(m, n, k, fa->data, fb->data, c, m);
+        else
+#endif
+            MY_MMult(m, n, k, fa->data, m, fb->data, k, c, m);
+        dtime = dclock() - dtime;
+
+        if (rep == 0 || dtime < dtime_best)
+            dtime_best = dtime;
+    }
+
+    a = packed ? unpack_a(m, k, fa->data) : fa->data;
+    b = packed ? unpack_b(k, n, fb->data) : fb->data;
+    cref = (double *) calloc((size_t) m * n, sizeof(double));
+    REF_MMult(m, n, k, a, m, b, k, cref, m);
 
-int main() {
+    printf("%d,%le,%le\n", m, gflops / dtime_best, compare_matrices(m, n, c, m, cref, m));
+
+    if (packed) {
+        free(a);
+        free(b);
+    }
+    free(c);
+    free(cref);
+    matfile_close(fa);
+    matfile_close(fb);
+}
+
+int main(int argc, char *argv[]) {
     int
             p,
             m, n, k,
@@ -28,6 +157,23 @@ int main() {
     double
             *a, *b, *c, *cref, *cold;
 
+    MemStat
+            mem;
+
+#ifdef WITH_SGEMM
+    double
+            dtime_best_s,
+            diff_s;
+
+    float
+            *sa, *sb, *sc, *scold;
+#endif
+
+    if (argc == 3) {
+        time_files(argv[1], argv[2]);
+        exit(0);
+    }
+
     for (p = PFIRST; p <= PLAST; p *= 2) {
         m = p;
         n = p;
@@ -60,11 +206,13 @@ int main() {
             copy_matrix(m, n, cold, ldc, c, ldc);
 
             /* Time your implementation */
+            memstat_reset();
             dtime = dclock();
 
             MY_MMult(m, n, k, a, lda, b, ldb, c, ldc);
 
             dtime = dclock() - dtime;
+            mem = memstat_read();
 
             if (rep == 0)
                 dtime_best = dtime;
@@ -77,9 +225,53 @@ int main() {
 //        REF_MMult(m, n, k, a, lda, b, ldb, cref, ldc);
 //        diff = compare_matrices(m, n, c, ldc, cref, ldc);
 
-        printf("%d,%le,%le\n", p, gflops / dtime_best, diff);
+#ifdef WITH_SGEMM
+        /* Time the single-precision engine on the same operands, rounded to float */
+        sa = (float *) malloc(lda * (k + 1) * sizeof(float));
+        sb = (float *) malloc(ldb * n * sizeof(float));
+        sc = (float *) malloc(ldc * n * sizeof(float));
+        scold = (float *) malloc(ldc * n * sizeof(float));
+
+        copy_matrix_to_float(m, k, a, lda, sa, lda);
+        copy_matrix_to_float(k, n, b, ldb, sb, ldb);
+        copy_matrix_to_float(m, n, cold, ldc, scold, ldc);
+
+        for (rep = 0; rep < NREPEATS; rep++) {
+            copy_matrix_float(m, n, scold, ldc, sc, ldc);
+
+            dtime = dclock();
+
+            MY_SMMult(m, n, k, sa, lda, sb, ldb, sc, ldc);
+
+            dtime = dclock() - dtime;
+
+            if (rep == 0)
+                dtime_best_s = dtime;
+            else
+                dtime_best_s = (dtime < dtime_best_s ? dtime : dtime_best_s);
+        }
+
+        /* Compare with the double-precision result */
+        copy_matrix_from_float(m, n, sc, ldc, cref, ldc);
+        diff_s = compare_matrices(m, n, c, ldc, cref, ldc);
+
+        free(sa);
+        free(sb);
+        free(sc);
+        free(scold);
+
+        printf("%d,%le,%le,%le,%le,", p, gflops / dtime_best, diff, gflops / dtime_best_s, diff_s);
+#else
+        printf("%d,%le,%le,", p, gflops / dtime_best, diff);
+#endif
+        printf("%ld,%.3f,%.3f,%ld,%.1f\n", mem.allocs, MB(mem.bytes), MB(mem.peak), mem.live,
+               memstat_max_rss() / 1024.0);
         fflush(stdout);
 
+        if (mem.live != 0)
+            fprintf(stderr, "MY_MMult leaked %ld bytes in %ld allocations at size %d\n",
+                    mem.live, mem.allocs - mem.frees, p);
+
         free(a);
         free(b);
         free(c);
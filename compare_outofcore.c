@@ -0,0 +1,107 @@
+/**
+ * Benchmark for the out-of-core engine.
+ * Writes random operands to files, multiplies them with OOC_MMult and
+ * prints the same csv columns as compare_matrix_multi.c. Sizes that are
+ * not multiples of the disk tiles give rectangular tiles at the edges.
+ * For sizes up to CHECK_SIZE the result is checked against gemm on the
+ * same operands held in memory, in one call.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+#include "outofcore.h"
+#include "matfile.h"
+#include "gemm.h"
+
+#define CHECK_SIZE 3000
+
+#define OOC_DIR "/tmp"
+
+static const int sizes[] = {256, 512, 1000, 2048, 3000, 4096};
+
+/**
+ * Write a random rows x cols column-major matrix file one column at a
+ * time, so the operands never have to fit in memory.
+ * @param path: output file
+ * @param rows: number of rows
+ * @param cols: number of columns
+ */
+void write_random_matrix(const char *path, int rows, int cols) {
+    FILE *f = fopen(path, "wb");
+    double *col = malloc(rows * sizeof(double));
+    MatFileHeader h;
+
+    matfile_header(&h, rows, cols, MATFILE_COL_MAJOR);
+    if (f == NULL || fwrite(&h, sizeof(h), 1, f) != 1 || fseek(f, h.data_offset, SEEK_SET)) {
+        perror(path);
+        exit(1);
+    }
+    for (int j = 0; j < cols; j++) {
+        random_matrix(rows, 1, col, rows);
+        fwrite(col, sizeof(double), rows, f);
+    }
+    free(col);
+    fclose(f);
+}
+
+/**
+ * Read a whole matrix file into a newly allocated array
+ * @param path: input file
+ * @return: newly allocated column-major array
+ */
+double *read_matrix(const char *path) {
+    MatFile *mf = matfile_open(path, 0);
+    double *a = malloc(mf->map_size);
+
+    memcpy(a, mf->data, mf->map_size);
+    matfile_close(mf);
+    return a;
+}
+
+int main() {
+    const char *a_path = OOC_DIR "/ooc_a.mat";
+    const char *b_path = OOC_DIR "/ooc_b.mat";
+    const char *c_path = OOC_DIR "/ooc_c.mat";
+
+    for (int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        int p = sizes[s];
+        int m = p, n = p, k = p;
+        double gflops = 2.0 * m * n * k * 1.0e-09;
+        double dtime, diff = 0.0;
+        double *a, *b, *c, *cref;
+
+        write_random_matrix(a_path, m, k);
+        write_random_matrix(b_path, k, n);
+        write_random_matrix(c_path, m, n);
+
+        if (p <= CHECK_SIZE) {
+            a = read_matrix(a_path);
+            b = read_matrix(b_path);
+            cref = read_matrix(c_path);
+            gemm(m, n, k, a, m, b, k, cref, m);
+            free(a);
+            free(b);
+        }
+
+        dtime = dclock();
+        OOC_MMult(a_path, b_path, c_path);
+        dtime = dclock() - dtime;
+
+        if (p <= CHECK_SIZE) {
+            c = read_matrix(c_path);
+            diff = compare_matrices(m, n, c, m, cref, m);
+            free(c);
+            free(cref);
+        }
+
+        printf("%d,%le,%le\n", p, gflops / dtime, diff);
+        fflush(stdout);
+    }
+
+    remove(a_path);
+    remove(b_path);
+    remove(c_path);
+    exit(0);
+}
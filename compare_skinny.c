@@ -0,0 +1,77 @@
+/**
+ * Benchmark for the narrow kernels.
+ * For every size, A is size x size and B and C have N = 1, 2, 4 or 8
+ * columns. Skinny_MMult runs on all the processors, and GB/s counts the
+ * reading of A only, which bounds these products: compare it with the
+ * bandwidth of the memory. The blocked engine runs on B and C padded with
+ * zero columns to a multiple of 4, as gemm did before it had these kernels.
+ * Diff is the largest difference of Skinny_MMult from REF_MMult.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "utils.h"
+#include "skinny.h"
+
+#define PFIRST 256
+#define PLAST  4096
+#define NREPEATS 3
+
+/* Round up to a multiple of 4 */
+#define PAD4( i ) ( ( (i)+3 ) & ~3 )
+
+/* The blocked engine */
+void MY_MMult(int, int, int, double *, int, double *, int, double *, int);
+
+static const int widths[] = {1, 2, 4, 8};
+
+int main() {
+    int threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+
+    for (int p = PFIRST; p <= PLAST; p *= 2) {
+        double *a = malloc((size_t) p * p * sizeof(double));
+        double *b = calloc((size_t) p * SKINNY_MAX_N, sizeof(double));
+        double *c = malloc((size_t) p * SKINNY_MAX_N * sizeof(double));
+        double *cref = calloc((size_t) p * SKINNY_MAX_N, sizeof(double));
+
+        random_matrix(p, p, a, p);
+
+        for (int w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+            int n = widths[w];
+            double gflops = 2.0 * p * p * n * 1.0e-09, gbytes = (double) p * p * sizeof(double) * 1.0e-09;
+            double dtime, dtime_best = 0.0, dtime_blocked = 0.0;
+
+            random_matrix(p, n, b, p);
+            for (long i = 0; i < (long) p * n; i++) cref[i] = 0.0;
+            REF_MMult(p, n, p, a, p, b, p, cref, p);
+
+            for (int rep = 0; rep < NREPEATS; rep++) {
+                for (long i = 0; i < (long) p * PAD4(n); i++) c[i] = 0.0;
+                dtime = dclock();
+                MY_MMult(p, PAD4(n), p, a, p, b, p, c, p);
+                dtime = dclock() - dtime;
+                if (rep == 0 || dtime < dtime_blocked)
+                    dtime_blocked = dtime;
+
+                for (long i = 0; i < (long) p * n; i++) c[i] = 0.0;
+                dtime = dclock();
+                Skinny_MMult(p, n, p, a, p, b, p, c, p, threads);
+                dtime = dclock() - dtime;
+                if (rep == 0 || dtime < dtime_best)
+                    dtime_best = dtime;
+            }
+
+            printf("%d,%d,%d,%le,%le,%le,%le\n", p, n, threads, gflops / dtime_best, gbytes / dtime_best,
+                   gflops / dtime_blocked, compare_matrices(p, n, c, p, cref, p));
+            fflush(stdout);
+        }
+
+        free(a);
+        free(b);
+        free(c);
+        free(cref);
+    }
+
+    exit(0);
+}
@@ -0,0 +1,108 @@
+/**
+ * Benchmark for the sparse x dense engines.
+ * For every size and density, A is a random matrix with that fraction of
+ * nonzeros, either scattered (Block = 1) or in BSR_BLOCK x BSR_BLOCK tiles
+ * (Block = 4), and is multiplied by a dense B with MY_MMult, CSR_MMult,
+ * BSR_MMult and Sparse_MMult.
+ * Gflops are counted as for a dense multiply of the same size, so the
+ * columns compare directly with compare_matrix_multi.c. The conversion of
+ * A is not timed for CSR and BSR but is for Sparse_MMult.
+ * Diff is the largest difference of the three sparse results from MY_MMult.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "utils.h"
+#include "sparse.h"
+
+#define PFIRST 256
+#define PLAST  2048
+#define NREPEATS 2
+
+void MY_MMult(int, int, int, double *, int, double *, int, double *, int);
+
+static const double densities[] = {0.01, 0.05, 0.1, 0.25, 0.5};
+static const int blocks[] = {1, BSR_BLOCK};
+
+/* The engines timed, with the same signature as MY_MMult */
+
+static CSRMatrix *csr_a;
+static BSRMatrix *bsr_a;
+
+static void csr_mmult(int m, int n, int k, double *a, int lda, double *b, int ldb, double *c, int ldc) {
+    CSR_MMult(csr_a, n, b, ldb, c, ldc);
+}
+
+static void bsr_mmult(int m, int n, int k, double *a, int lda, double *b, int ldb, double *c, int ldc) {
+    BSR_MMult(bsr_a, n, b, ldb, c, ldc);
+}
+
+typedef void (*mmult_t)(int, int, int, double *, int, double *, int, double *, int);
+
+/**
+ * Time an engine on C = Cold + A * B, keeping the best of NREPEATS runs
+ * @param c: set to the result
+ * @return: best time in seconds
+ */
+static double time_mmult(mmult_t mmult, int p, double *a, double *b, double *c, double *cold) {
+    double dtime, dtime_best = 0.0;
+
+    for (int rep = 0; rep < NREPEATS; rep++) {
+        copy_matrix(p, p, cold, p, c, p);
+        dtime = dclock();
+        mmult(p, p, p, a, p, b, p, c, p);
+        dtime = dclock() - dtime;
+        if (rep == 0 || dtime < dtime_best)
+            dtime_best = dtime;
+    }
+    return dtime_best;
+}
+
+int main() {
+    for (int p = PFIRST; p <= PLAST; p *= 2) {
+        double gflops = 2.0 * p * p * p * 1.0e-09;
+        double *a = malloc((size_t) p * p * sizeof(double));
+        double *b = malloc((size_t) p * p * sizeof(double));
+        double *c = malloc((size_t) p * p * sizeof(double));
+        double *cold = malloc((size_t) p * p * sizeof(double));
+        double *cref = malloc((size_t) p * p * sizeof(double));
+
+        random_matrix(p, p, b, p);
+        random_matrix(p, p, cold, p);
+
+        for (int s = 0; s < 2; s++) {
+            for (int d = 0; d < sizeof(densities) / sizeof(densities[0]); d++) {
+                double t_dense, t_csr, t_bsr, t_auto, diff, diff_max;
+
+                random_sparse_matrix(p, p, a, p, densities[d], blocks[s]);
+                csr_a = csr_from_dense(p, p, a, p);
+                bsr_a = bsr_from_dense(p, p, a, p);
+
+                t_dense = time_mmult(MY_MMult, p, a, b, cref, cold);
+                t_csr = time_mmult(csr_mmult, p, a, b, c, cold);
+                diff_max = compare_matrices(p, p, c, p, cref, p);
+                t_bsr = time_mmult(bsr_mmult, p, a, b, c, cold);
+                diff = compare_matrices(p, p, c, p, cref, p);
+                diff_max = (diff > diff_max ? diff : diff_max);
+                t_auto = time_mmult(Sparse_MMult, p, a, b, c, cold);
+                diff = compare_matrices(p, p, c, p, cref, p);
+                diff_max = (diff > diff_max ? diff : diff_max);
+
+                printf("%d,%d,%g,%le,%le,%le,%le,%le\n", p, blocks[s], densities[d],
+                       gflops / t_dense, gflops / t_csr, gflops / t_bsr, gflops / t_auto, diff_max);
+                fflush(stdout);
+
+                free_csr(csr_a);
+                free_bsr(bsr_a);
+            }
+        }
+
+        free(a);
+        free(b);
+        free(c);
+        free(cold);
+        free(cref);
+    }
+
+    exit(0);
+}
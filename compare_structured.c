@@ -0,0 +1,157 @@
+/**
+ * Benchmark for the structured kernels of MMult_structured.c.
+ * For every size, times MY_MMult, and SYRK, SYMM and TRMM on operands of
+ * the same size, all with the lower triangle stored.
+ * Gflops are counted as for MY_MMult (2 n^3), so the columns show the
+ * speedup over computing the same product with the general engine.
+ * Diff is the largest difference from MY_MMult on the equivalent dense
+ * operands, over the timed calls and, once per size, over every other
+ * variant: both triangles, both SYRK operands and both TRMM diagonals.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+#include "MMult_structured.h"
+
+#define PFIRST 128
+#define PLAST  2048
+#define NREPEATS 2
+
+void MY_MMult(int, int, int, double *, int, double *, int, double *, int);
+
+/**
+ * Dense copy of the uplo triangle of a, the other one zero, with a unit
+ * diagonal if diag is MMULT_UNIT
+ */
+static void triangle(int uplo, int diag, int p, double *a, double *a_full) {
+    for (int j = 0; j < p; j++)
+        for (int i = 0; i < p; i++)
+            a_full[j * p + i] = i == j && diag == MMULT_UNIT ? 1.0 :
+                                (uplo == MMULT_LOWER ? i >= j : i <= j) ? a[j * p + i] : 0.0;
+}
+
+/**
+ * Largest difference from MY_MMult of the SYRK, SYMM and TRMM variants
+ * the timed loop does not run
+ * @param at: the transpose of a
+ * @param a_full, c, cref: p x p work space
+ */
+static double check_variants(int p, double *a, double *at, double *b, double *a_full, double *c, double *cref) {
+    size_t size = (size_t) p * p * sizeof(double);
+    double diff, diff_max = 0.0;
+
+    for (int uplo = MMULT_LOWER; uplo <= MMULT_UPPER; uplo++) {
+        for (int trans = MMULT_NOTRANS; trans <= MMULT_TRANS; trans++) {
+            if (uplo == MMULT_LOWER && trans == MMULT_NOTRANS)
+                continue;
+            memset(c, 0, size);
+            memset(cref, 0, size);
+            if (trans == MMULT_TRANS)
+                MY_MMult(p, p, p, at, p, a, p, cref, p);
+            else
+                MY_MMult(p, p, p, a, p, at, p, cref, p);
+            MY_SYRK(uplo, trans, p, p, a, p, c, p, 1);
+            diff = compare_matrices(p, p, c, p, cref, p);
+            diff_max = (diff > diff_max ? diff : diff_max);
+        }
+
+        if (uplo == MMULT_UPPER) {
+            copy_matrix(p, p, a, p, a_full, p);
+            symmetrize_matrix(uplo, p, a_full, p);
+            memset(c, 0, size);
+            memset(cref, 0, size);
+            MY_MMult(p, p, p, a_full, p, b, p, cref, p);
+            MY_SYMM(uplo, p, p, a, p, b, p, c, p);
+            diff = compare_matrices(p, p, c, p, cref, p);
+            diff_max = (diff > diff_max ? diff : diff_max);
+        }
+
+        for (int diag = MMULT_NONUNIT; diag <= MMULT_UNIT; diag++) {
+            if (uplo == MMULT_LOWER && diag == MMULT_NONUNIT)
+                continue;
+            triangle(uplo, diag, p, a, a_full);
+            memset(c, 0, size);
+            memset(cref, 0, size);
+            MY_MMult(p, p, p, a_full, p, b, p, cref, p);
+            MY_TRMM(uplo, diag, p, p, a, p, b, p, c, p);
+            diff = compare_matrices(p, p, c, p, cref, p);
+            diff_max = (diff > diff_max ? diff : diff_max);
+        }
+    }
+    return diff_max;
+}
+
+int main() {
+    for (int p = PFIRST; p <= PLAST; p *= 2) {
+        double gflops = 2.0 * p * p * p * 1.0e-09;
+        double dtime, t_gemm = 0.0, t_syrk = 0.0, t_symm = 0.0, t_trmm = 0.0, diff, diff_max = 0.0;
+        size_t size = (size_t) p * p * sizeof(double);
+        double *a = malloc(size), *at = malloc(size), *a_full = malloc(size), *b = malloc(size);
+        double *c = malloc(size), *cref = malloc(size);
+
+        random_matrix(p, p, a, p);
+        random_matrix(p, p, b, p);
+        for (int j = 0; j < p; j++)
+            for (int i = 0; i < p; i++)
+                at[i * p + j] = a[j * p + i];
+
+        for (int rep = 0; rep < NREPEATS; rep++) {
+            /* SYRK: C = A * A^T */
+            for (int i = 0; i < p * p; i++) cref[i] = c[i] = 0.0;
+            dtime = dclock();
+            MY_MMult(p, p, p, a, p, at, p, cref, p);
+            dtime = dclock() - dtime;
+            t_gemm = (rep == 0 || dtime < t_gemm ? dtime : t_gemm);
+
+            dtime = dclock();
+            MY_SYRK(MMULT_LOWER, MMULT_NOTRANS, p, p, a, p, c, p, 1);
+            dtime = dclock() - dtime;
+            t_syrk = (rep == 0 || dtime < t_syrk ? dtime : t_syrk);
+            diff = compare_matrices(p, p, c, p, cref, p);
+            diff_max = (diff > diff_max ? diff : diff_max);
+
+            /* SYMM: C = A * B with A the symmetric matrix of the lower triangle of a */
+            copy_matrix(p, p, a, p, a_full, p);
+            symmetrize_matrix(MMULT_LOWER, p, a_full, p);
+            for (int i = 0; i < p * p; i++) cref[i] = c[i] = 0.0;
+            MY_MMult(p, p, p, a_full, p, b, p, cref, p);
+
+            dtime = dclock();
+            MY_SYMM(MMULT_LOWER, p, p, a, p, b, p, c, p);
+            dtime = dclock() - dtime;
+            t_symm = (rep == 0 || dtime < t_symm ? dtime : t_symm);
+            diff = compare_matrices(p, p, c, p, cref, p);
+            diff_max = (diff > diff_max ? diff : diff_max);
+
+            /* TRMM: C = A * B with A the lower triangle of a */
+            triangle(MMULT_LOWER, MMULT_NONUNIT, p, a, a_full);
+            for (int i = 0; i < p * p; i++) cref[i] = c[i] = 0.0;
+            MY_MMult(p, p, p, a_full, p, b, p, cref, p);
+
+            dtime = dclock();
+            MY_TRMM(MMULT_LOWER, MMULT_NONUNIT, p, p, a, p, b, p, c, p);
+            dtime = dclock() - dtime;
+            t_trmm = (rep == 0 || dtime < t_trmm ? dtime : t_trmm);
+            diff = compare_matrices(p, p, c, p, cref, p);
+            diff_max = (diff > diff_max ? diff : diff_max);
+        }
+
+        diff = check_variants(p, a, at, b, a_full, c, cref);
+        diff_max = (diff > diff_max ? diff : diff_max);
+
+        printf("%d,%le,%le,%le,%le,%le\n", p, gflops / t_gemm, gflops / t_syrk,
+               gflops / t_symm, gflops / t_trmm, diff_max);
+        fflush(stdout);
+
+        free(a);
+        free(at);
+        free(a_full);
+        free(b);
+        free(c);
+        free(cref);
+    }
+
+    exit(0);
+}
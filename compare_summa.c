@@ -0,0 +1,111 @@
+/**
+ * Benchmark for the distributed SUMMA engine.
+ * For every size and process grid, times SUMMA_MMult on processes forked
+ * over shared memory and over Unix sockets, including the scatter of the
+ * operands and the gather of C, and prints the largest difference from
+ * gemm in one process.
+ *
+ * Built with -DWITH_MPI (make compare_summa_mpi.x) it runs on the ranks
+ * started by mpirun instead, on the squarest grid of that many ranks:
+ *     mpirun -n 4 ./compare_summa_mpi.x
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef WITH_MPI
+#include <mpi.h>
+#endif
+
+#include "utils.h"
+#include "summa.h"
+#include "gemm.h"
+
+#define PFIRST 256
+#define PLAST  2048
+
+#ifndef WITH_MPI
+static const int grids[][2] = {{1, 1}, {1, 2}, {2, 2}};
+#endif
+
+int main(int argc, char *argv[]) {
+    int rank = 0, grid_count = 1;
+
+#ifdef WITH_MPI
+    Transport *t;
+    int grids[1][2] = {{1, 1}};
+
+    MPI_Init(&argc, &argv);
+    t = transport_mpi();
+    rank = t->rank;
+    for (int q = 1; q * q <= t->size; q++)
+        if (t->size % q == 0)
+            grids[0][0] = q;
+    grids[0][1] = t->size / grids[0][0];
+#else
+    grid_count = sizeof(grids) / sizeof(grids[0]);
+#endif
+
+    for (int p = PFIRST; p <= PLAST; p *= 2) {
+        double gflops = 2.0 * p * p * p * 1.0e-09;
+        size_t size = (size_t) p * p * sizeof(double);
+        double *a = NULL, *b = NULL, *c = NULL, *cref = NULL;
+
+        if (rank == 0) {
+            a = malloc(size);
+            b = malloc(size);
+            c = malloc(size);
+            cref = calloc((size_t) p * p, sizeof(double));
+            random_matrix(p, p, a, p);
+            random_matrix(p, p, b, p);
+            gemm(p, p, p, a, p, b, p, cref, p);
+        }
+
+        for (int g = 0; g < grid_count; g++) {
+            int pr = grids[g][0], pc = grids[g][1];
+            double dtime, diff = 0.0;
+
+#ifdef WITH_MPI
+            if (rank == 0)
+                for (long i = 0; i < (long) p * p; i++) c[i] = 0.0;
+            transport_barrier(t);
+            dtime = dclock();
+            SUMMA_MMult_transport(t, pr, pc, p, p, p, a, p, b, p, c, p);
+            dtime = dclock() - dtime;
+            if (rank == 0) {
+                diff = compare_matrices(p, p, c, p, cref, p);
+                printf("%d,%d,%le,%le\n", p, pr * pc, gflops / dtime, diff);
+            }
+#else
+            double gflops_shm, gflops_socket;
+
+            for (long i = 0; i < (long) p * p; i++) c[i] = 0.0;
+            dtime = dclock();
+            SUMMA_MMult(p, p, p, a, p, b, p, c, p, pr, pc, TRANSPORT_SHM);
+            dtime = dclock() - dtime;
+            gflops_shm = gflops / dtime;
+            diff = compare_matrices(p, p, c, p, cref, p);
+
+            for (long i = 0; i < (long) p * p; i++) c[i] = 0.0;
+            dtime = dclock();
+            SUMMA_MMult(p, p, p, a, p, b, p, c, p, pr, pc, TRANSPORT_SOCKET);
+            dtime = dclock() - dtime;
+            gflops_socket = gflops / dtime;
+            if (compare_matrices(p, p, c, p, cref, p) > diff)
+                diff = compare_matrices(p, p, c, p, cref, p);
+
+            printf("%d,%d,%le,%le,%le\n", p, pr * pc, gflops_shm, gflops_socket, diff);
+#endif
+            fflush(stdout);
+        }
+
+        free(a);
+        free(b);
+        free(c);
+        free(cref);
+    }
+
+#ifdef WITH_MPI
+    transport_close(t);
+    MPI_Finalize();
+#endif
+    exit(0);
+}
@@ -0,0 +1,16 @@
+/* 2D convolution as an implicit GEMM on the blocked engine */
+
+/* Output height or width for an input of size in, a filter of size k */
+#define CONV_OUT_SIZE( in, k, stride, pad, dilation ) \
+  ( ( (in) + 2*(pad) - (dilation)*( (k)-1 ) - 1 ) / (stride) + 1 )
+
+/* Input NHWC: batch x height x width x channels. Filter HWIO:
+   kh x kw x channels x filters. Output NHWC: batch x out_h x out_w x
+   filters, with out_h and out_w from CONV_OUT_SIZE */
+typedef struct {
+    int batch, height, width, channels;
+    int kh, kw, filters;
+    int stride, pad, dilation;
+} ConvShape;
+
+void MY_Conv2d(const ConvShape *, double *, double *, double *);
@@ -0,0 +1,17 @@
+/* Operations fused into the write-back of C by MY_MMult_ep, which computes
+       C = act( C + A * B + bias ) + residual
+   while each block of C is still in registers */
+
+/* Activations */
+#define EPILOGUE_NONE 0
+#define EPILOGUE_RELU 1
+#define EPILOGUE_GELU 2             /* exact form, x * Phi( x ) */
+
+typedef struct {
+    double *bias;                   /* one value per row of C, or NULL */
+    int activation;
+    double *residual;               /* m x n column-major, or NULL */
+    int ldr;                        /* leading dimension of residual */
+} Epilogue;
+
+void MY_MMult_ep(int, int, int, double *, int, double *, int, double *, int, const Epilogue *);
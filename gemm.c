@@ -0,0 +1,374 @@
+/**
+ * Engine dispatcher.
+ * Every engine is linked in under its own name (compiled with
+ * -DMY_MMult=<engine>_gemm, see the makefile) and gemm routes each call to
+ * one of them through a decision table. The table is looked up by the
+ * shape of the call (square, skinny or narrow, see GEMM_SKINNY_RATIO and
+ * GEMM_NARROW_N), its size
+ * (the largest of m, n and k) and the number of threads the call may
+ * use; the first row that matches and whose engine can multiply those
+ * sizes and leading dimensions wins.
+ *
+ * The built-in table follows the crossovers measured on the development
+ * machine. compare_gemm.x times every engine on this host and writes a
+ * profile in the same format, which is loaded from the file named by
+ * GEMM_PROFILE on the first call:
+ *     # shape max_size min_threads engine
+ *     square 128 1 MMult_4x4_vecreg
+ * The number of threads is GEMM_THREADS, or the number of processors,
+ * as far as the budget of threads.c, shared with the other callers,
+ * grants them. A caller can keep its own thread limit, engine and
+ * processors in a GemmContext and pass it to gemm_ctx.
+ */
+#define _GNU_SOURCE                 /* pthread_setaffinity_np */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "gemm.h"
+#include "carma.h"
+#include "skinny.h"
+#include "threads.h"
+
+#define max( i, j ) ( (i)>(j) ? (i): (j) )
+#define min( i, j ) ( (i)<(j) ? (i): (j) )
+
+void MMult_basic_gemm(int, int, int, double *, int, double *, int, double *, int);
+void MMult_4x4_vecreg_gemm(int, int, int, double *, int, double *, int, double *, int);
+void MMult_4x4_vecreg_subblock_cache_gemm(int, int, int, double *, int, double *, int, double *, int);
+void Strassen_gemm(int, int, int, double *, int, double *, int, double *, int);
+void Strassen_multithread_gemm(int, int, int, double *, int, double *, int, double *, int);
+void Strassen_morton_gemm(int, int, int, double *, int, double *, int, double *, int);
+void MMult_jit_gemm(int, int, int, double *, int, double *, int, double *, int);
+
+/**
+ * Threads of the call under way: those granted by the budget, or all of
+ * gemm_threads() for an engine called directly
+ */
+static int call_threads() {
+    int held = threads_held();
+
+    return held ? held : gemm_threads();
+}
+
+/**
+ * CARMA over the generated kernels, on all the threads of the call
+ */
+static void CARMA_gemm(int m, int n, int k, double *a, int lda,
+                       double *b, int ldb, double *c, int ldc) {
+    CARMA_MMult(m, n, k, a, lda, b, ldb, c, ldc, call_threads());
+}
+
+/**
+ * The narrow kernels, on all the threads of the call
+ */
+static void Skinny_gemm(int m, int n, int k, double *a, int lda,
+                        double *b, int ldb, double *c, int ldc) {
+    Skinny_MMult(m, n, k, a, lda, b, ldb, c, ldc, call_threads());
+}
+
+static int fits_any(int m, int n, int k, double *a, int lda, double *b, int ldb, double *c, int ldc) {
+    return 1;
+}
+
+/* The 4x4 kernels have no clean-up loops for the edges of C */
+static int fits_4x4(int m, int n, int k, double *a, int lda, double *b, int ldb, double *c, int ldc) {
+    return m % 4 == 0 && n % 4 == 0;
+}
+
+/* The register kernel also loads the columns of A with aligned loads */
+static int fits_vecreg(int m, int n, int k, double *a, int lda, double *b, int ldb, double *c, int ldc) {
+    return m % 4 == 0 && n % 4 == 0 && lda % 2 == 0 && (uintptr_t) a % 16 == 0;
+}
+
+static int fits_carma(int m, int n, int k, double *a, int lda, double *b, int ldb, double *c, int ldc) {
+    return m % 4 == 0 && n % 4 == 0 && k % 4 == 0;
+}
+
+static int fits_skinny(int m, int n, int k, double *a, int lda, double *b, int ldb, double *c, int ldc) {
+    return n <= SKINNY_MAX_N;
+}
+
+/* The row-major Strassen engines halve the matrices down to tiles of 8 */
+static int fits_strassen(int m, int n, int k, double *a, int lda, double *b, int ldb, double *c, int ldc) {
+    int tile = m;
+
+    while (tile > 8 && tile % 2 == 0)
+        tile /= 2;
+    return m == n && n == k && (m <= 8 || tile == 8);
+}
+
+/* The Morton conversion handles any leading dimension and tiles of up to 8 */
+static int fits_morton(int m, int n, int k, double *a, int lda, double *b, int ldb, double *c, int ldc) {
+    int tile = m;
+
+    while (tile > 8 && tile % 2 == 0)
+        tile /= 2;
+    return m == n && n == k && tile <= 8;
+}
+
+const GemmEngine gemm_engines[] = {
+        {"MMult_basic",                     MMult_basic_gemm,                     0, fits_any},
+        {"MMult_4x4_vecreg",                MMult_4x4_vecreg_gemm,                0, fits_vecreg},
+        {"MMult_4x4_vecreg_subblock_cache", MMult_4x4_vecreg_subblock_cache_gemm, 0, fits_4x4},
+        {"Strassen",                        Strassen_gemm,                        0, fits_strassen},
+        {"Strassen_multithread",            Strassen_multithread_gemm,            1, fits_strassen},
+        {"Strassen_morton",                 Strassen_morton_gemm,                 0, fits_morton},
+        {"CARMA",                           CARMA_gemm,                           1, fits_carma},
+        {"Skinny",                          Skinny_gemm,                          0, fits_skinny},
+        {"MMult_jit",                       MMult_jit_gemm,                       0, fits_any},
+};
+const int gemm_engine_count = sizeof(gemm_engines) / sizeof(gemm_engines[0]);
+
+/* Engines by index in gemm_engines */
+#define VECREG      1
+#define CARMA       6
+#define SKINNY      7
+#define JIT         8
+
+/* From output_*.csv: the register kernel on the smallest products, the
+   generated kernels of MMult_jit above, and CARMA over them on large
+   problems when there are threads to run it. Narrow calls are bound by
+   reading A, which the narrow kernels do once. */
+static GemmRule rules[GEMM_MAX_RULES] = {
+        {GEMM_SQUARE, 16,   1, VECREG},
+        {GEMM_SQUARE, 512,  1, JIT},
+        {GEMM_SQUARE, 0,    4, CARMA},
+        {GEMM_SQUARE, 0,    1, JIT},
+        {GEMM_SKINNY, 16,   1, VECREG},
+        {GEMM_SKINNY, 512,  1, JIT},
+        {GEMM_SKINNY, 0,    4, CARMA},
+        {GEMM_SKINNY, 0,    1, JIT},
+        {GEMM_NARROW, 0,    1, SKINNY},
+};
+static int rule_count = 9;
+
+const char *gemm_shape_names[] = {"square", "skinny", "narrow"};
+
+static pthread_once_t profile_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Shape of an m x k by k x n product
+ * @return: GEMM_SQUARE, GEMM_SKINNY or GEMM_NARROW
+ */
+int gemm_shape(int m, int n, int k) {
+    int largest = max(m, max(n, k)), smallest = min(m, min(n, k));
+
+    if (n <= GEMM_NARROW_N && max(m, k) > GEMM_SKINNY_RATIO * n)
+        return GEMM_NARROW;
+    return largest > GEMM_SKINNY_RATIO * smallest ? GEMM_SKINNY : GEMM_SQUARE;
+}
+
+/**
+ * Number of threads a call may use: GEMM_THREADS if set, else the number
+ * of processors
+ */
+int gemm_threads() {
+    char *env = getenv("GEMM_THREADS");
+    int threads = env ? atoi(env) : (int) sysconf(_SC_NPROCESSORS_ONLN);
+
+    return threads > 0 ? threads : 1;
+}
+
+/**
+ * Index of an engine in gemm_engines
+ * @param name: name of the engine
+ * @return: its index, or -1 if there is no such engine
+ */
+int gemm_find_engine(const char *name) {
+    for (int e = 0; e < gemm_engine_count; e++)
+        if (strcmp(gemm_engines[e].name, name) == 0)
+            return e;
+    return -1;
+}
+
+/**
+ * Shape by name in gemm_shape_names
+ * @return: the shape, or -1 if there is no such shape
+ */
+static int find_shape(const char *name) {
+    for (int s = GEMM_SQUARE; s <= GEMM_NARROW; s++)
+        if (strcmp(gemm_shape_names[s], name) == 0)
+            return s;
+    return -1;
+}
+
+/**
+ * Replace the decision table by the rules of a profile file. Lines
+ * starting with # are comments.
+ * @param path: profile, as written by gemm_write_rules
+ */
+void gemm_load_profile(const char *path) {
+    FILE *f = fopen(path, "r");
+    char line[256], shape[32], name[128];
+    int count = 0;
+
+    if (f == NULL) {
+        perror(path);
+        exit(1);
+    }
+    while (fgets(line, sizeof(line), f)) {
+        GemmRule *r = &rules[count];
+
+        if (line[0] == '#' || line[0] == '\n')
+            continue;
+        if (count == GEMM_MAX_RULES ||
+            sscanf(line, "%31s %d %d %127s", shape, &r->max_size, &r->min_threads, name) != 4 ||
+            (r->engine = gemm_find_engine(name)) < 0 ||
+            (r->shape = find_shape(shape)) < 0) {
+            fprintf(stderr, "%s: bad rule %s", path, line);
+            exit(1);
+        }
+        count++;
+    }
+    fclose(f);
+    rule_count = count;
+}
+
+/**
+ * Write rules in the format of gemm_load_profile
+ * @param f: file to write to
+ * @param r: the rules
+ * @param count: number of rules
+ */
+void gemm_write_rules(FILE *f, GemmRule *r, int count) {
+    fprintf(f, "# shape max_size min_threads engine\n");
+    for (int i = 0; i < count; i++)
+        fprintf(f, "%s %d %d %s\n", gemm_shape_names[r[i].shape],
+                r[i].max_size, r[i].min_threads, gemm_engines[r[i].engine].name);
+}
+
+static void load_env_profile() {
+    char *path = getenv("GEMM_PROFILE");
+
+    if (path)
+        gemm_load_profile(path);
+}
+
+/**
+ * Pick the engine for a call that has threads threads
+ * @return: index of the engine in gemm_engines
+ */
+static int pick(int threads, int m, int n, int k, double *a, int lda, double *b, int ldb, double *c, int ldc) {
+    int shape = gemm_shape(m, n, k), size = max(m, max(n, k));
+
+    pthread_once(&profile_once, load_env_profile);
+    for (int i = 0; i < rule_count; i++) {
+        const GemmEngine *e = &gemm_engines[rules[i].engine];
+
+        if (rules[i].shape == shape && (rules[i].max_size == 0 || size <= rules[i].max_size) &&
+            threads >= rules[i].min_threads && (threads > 1 || !e->threaded) &&
+            e->fits(m, n, k, a, lda, b, ldb, c, ldc))
+            return rules[i].engine;
+    }
+    return JIT;
+}
+
+/**
+ * Pick the engine for a call with all of gemm_threads()
+ * @return: index of the engine in gemm_engines
+ */
+int gemm_pick(int m, int n, int k, double *a, int lda, double *b, int ldb, double *c, int ldc) {
+    return pick(gemm_threads(), m, n, k, a, lda, b, ldb, c, ldc);
+}
+
+/**
+ * New context
+ * @param threads: most threads a call may use, 0 for gemm_threads()
+ * @param engine: name of the engine for every call it can multiply, NULL
+ *        for the decision table
+ * @return: the context, to free with gemm_context_destroy
+ */
+GemmContext *gemm_context_create(int threads, const char *engine) {
+    GemmContext *ctx = calloc(1, sizeof(GemmContext));
+
+    if (ctx == NULL) {
+        fprintf(stderr, "gemm_context_create: out of memory\n");
+        exit(1);
+    }
+    ctx->threads = threads;
+    ctx->engine = engine ? gemm_find_engine(engine) : -1;
+    if (engine && ctx->engine < 0) {
+        fprintf(stderr, "gemm_context_create: no engine %s\n", engine);
+        exit(1);
+    }
+    return ctx;
+}
+
+/**
+ * Run the threads of the calls of a context on some processors only; the
+ * calls also use no more threads than there are of them
+ * @param cpus: numbers of the processors, as for sched_setaffinity
+ * @param ncpus: number of processors, 0 for any
+ */
+void gemm_context_set_affinity(GemmContext *ctx, const int *cpus, int ncpus) {
+    free(ctx->cpus);
+    ctx->cpus = ncpus > 0 ? malloc(ncpus * sizeof(int)) : NULL;
+    ctx->ncpus = ncpus > 0 ? ncpus : 0;
+
+    for (int i = 0; i < ctx->ncpus; i++) {
+        if (cpus[i] < 0 || cpus[i] >= CPU_SETSIZE) {
+            fprintf(stderr, "gemm_context_set_affinity: no processor %d\n", cpus[i]);
+            exit(1);
+        }
+        ctx->cpus[i] = cpus[i];
+    }
+}
+
+void gemm_context_destroy(GemmContext *ctx) {
+    free(ctx->cpus);
+    free(ctx);
+}
+
+/**
+ * C += A * B, column-major like MY_MMult, with the settings of a context.
+ * The threads come from the budget of threads.c: when other calls hold
+ * them, this one gets fewer and the table picks for that many. Engines
+ * that do not use threads give theirs back before they start. The
+ * threads an engine starts inherit the processors of the calling thread,
+ * which is pinned to those of the context for the call.
+ * @param ctx: the context, or NULL for the defaults of gemm
+ */
+void gemm_ctx(const GemmContext *ctx, int m, int n, int k, double *a, int lda,
+              double *b, int ldb,
+              double *c, int ldc) {
+    int want = ctx && ctx->threads > 0 ? ctx->threads : gemm_threads();
+    int pinned = 0, threads, e;
+    cpu_set_t cpus, saved;
+
+    if (ctx && ctx->ncpus > 0) {
+        want = min(want, ctx->ncpus);
+        CPU_ZERO(&cpus);
+        for (int i = 0; i < ctx->ncpus; i++)
+            CPU_SET(ctx->cpus[i], &cpus);
+        pinned = pthread_getaffinity_np(pthread_self(), sizeof(saved), &saved) == 0 &&
+                 pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+    }
+
+    threads = threads_acquire(want);
+    if (ctx && ctx->engine >= 0 && gemm_engines[ctx->engine].fits(m, n, k, a, lda, b, ldb, c, ldc))
+        e = ctx->engine;
+    else
+        e = pick(threads, m, n, k, a, lda, b, ldb, c, ldc);
+
+    /* The narrow kernels run on as many threads as they get */
+    if (!gemm_engines[e].threaded && e != SKINNY)
+        threads_trim(1);
+    gemm_engines[e].mmult(m, n, k, a, lda, b, ldb, c, ldc);
+    threads_release();
+
+    if (pinned)
+        pthread_setaffinity_np(pthread_self(), sizeof(saved), &saved);
+}
+
+/**
+ * C += A * B with the engine picked for the call, column-major like MY_MMult
+ */
+void gemm(int m, int n, int k, double *a, int lda,
+          double *b, int ldb,
+          double *c, int ldc) {
+    gemm_ctx(NULL, m, n, k, a, lda, b, ldb, c, ldc);
+}
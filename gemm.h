@@ -0,0 +1,67 @@
+/* C += A * B through the engine that is fastest for the shape of each call */
+
+#include <stdio.h>
+
+typedef void (*MMultEngine)(int, int, int, double *, int, double *, int, double *, int);
+
+/* Calls whose largest dimension is more than this many times the
+   smallest are looked up as skinny rather than square */
+#define GEMM_SKINNY_RATIO 4
+
+/* Calls with at most this many columns in B and C, and a larger m or k,
+   are looked up as narrow */
+#define GEMM_NARROW_N 8
+
+#define GEMM_SQUARE 0
+#define GEMM_SKINNY 1
+#define GEMM_NARROW 2
+
+/* Largest decision table */
+#define GEMM_MAX_RULES 64
+
+/* Tuning profile written by compare_gemm.x, read from GEMM_PROFILE */
+#define GEMM_PROFILE_FILE "gemm_profile.txt"
+
+typedef struct {
+    const char *name;
+    MMultEngine mmult;
+    int threaded;                   /* uses more than one thread */
+    int (*fits)(int, int, int, double *, int, double *, int, double *, int);
+} GemmEngine;
+
+/* A row of the decision table: calls of this shape, of size up to
+   max_size (0: any) and with at least min_threads threads to use go to
+   the engine, if it can multiply them */
+typedef struct {
+    int shape;
+    int max_size;
+    int min_threads;
+    int engine;
+} GemmRule;
+
+extern const GemmEngine gemm_engines[];
+extern const int gemm_engine_count;
+extern const char *gemm_shape_names[];
+
+int gemm_shape(int, int, int);
+int gemm_threads();
+int gemm_find_engine(const char *);
+int gemm_pick(int, int, int, double *, int, double *, int, double *, int);
+void gemm_load_profile(const char *);
+void gemm_write_rules(FILE *, GemmRule *, int);
+
+/* Settings of a caller for its calls to gemm_ctx. Calls with a context
+   and without one share the thread budget of threads.h */
+typedef struct {
+    int threads;                    /* most threads a call may use, 0: gemm_threads() */
+    int engine;                     /* index in gemm_engines, -1: the decision table */
+    int *cpus;                      /* processors the threads of a call run on */
+    int ncpus;                      /* 0: any */
+} GemmContext;
+
+GemmContext *gemm_context_create(int, const char *);
+void gemm_context_set_affinity(GemmContext *, const int *, int);
+void gemm_context_destroy(GemmContext *);
+
+void gemm(int, int, int, double *, int, double *, int, double *, int);
+void gemm_ctx(const GemmContext *, int, int, int, double *, int, double *, int, double *, int);
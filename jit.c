@@ -0,0 +1,355 @@
+/**
+ * Run-time generation of GEMM micro-kernels.
+ * AddDot4x4 is one register tile for one instruction set. Instead of
+ * writing a variant by hand for every tile and ISA, jit_kernel emits the
+ * x86-64 machine code of the kernel described by a JitConfig into
+ * executable memory, the first time that configuration is asked for, and
+ * keeps it for the later calls. jit_host_config gives the largest tile
+ * that fits the vector registers of the host.
+ *
+ * A kernel follows the System V calling convention:
+ *     rdi = k, rsi = packed A, rdx = packed B, rcx = C, r8 = ldc
+ * The mr x nr accumulators live in vector registers; every step of k loads
+ * mr / W vectors of A (W doubles per vector), and for each of the nr
+ * columns broadcasts an element of B and multiplies-adds it in. The
+ * accumulators are then added to C, the epilogue applied, and stored.
+ * Only the instructions needed for that are encoded: VEX for AVX2 and
+ * EVEX for AVX-512, with memory operands based on rsi, rdx or rcx.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "jit.h"
+#include "epilogue.h"
+
+#if defined(__x86_64__)
+#include <sys/mman.h>
+
+/* Largest kernel, in bytes */
+#define JIT_MAX_CODE (64 * 1024)
+
+/* General-purpose registers of the calling convention */
+#define RCX 1
+#define RDX 2
+#define RSI 6
+#define RDI 7
+
+/* Opcode maps */
+#define MAP_0F   1
+#define MAP_0F38 2
+
+typedef struct {
+    unsigned char *code;
+    int size;
+    int isa;
+    int vector_bytes;
+} JitBuffer;
+
+static void emit(JitBuffer *b, int byte) {
+    if (b->size == JIT_MAX_CODE) {
+        fprintf(stderr, "JIT kernel larger than %d bytes\n", JIT_MAX_CODE);
+        exit(1);
+    }
+    b->code[b->size++] = (unsigned char) byte;
+}
+
+static void emit32(JitBuffer *b, int value) {
+    for (int i = 0; i < 4; i++)
+        emit(b, (value >> (8 * i)) & 0xff);
+}
+
+/**
+ * Emit a vector instruction with the 66 prefix: reg, vvvv and either a
+ * register rm (base < 0) or the memory operand [base + disp]
+ * @param w: VEX/EVEX.W
+ * @param scale: EVEX only, bytes of the memory operand, by which an 8-bit
+ *        displacement is scaled
+ */
+static void vector_op(JitBuffer *b, int map, int w, int opcode, int reg, int vvvv,
+                      int rm, int base, int disp, int scale) {
+    int rm_reg = base < 0 ? rm : base;
+    int disp8;
+
+    if (b->isa == JIT_AVX512) {
+        emit(b, 0x62);
+        emit(b, (~reg >> 3 & 1) << 7 | (base < 0 ? ~rm >> 4 & 1 : 1) << 6 |
+                (~rm_reg >> 3 & 1) << 5 | (~reg >> 4 & 1) << 4 | map);
+        emit(b, w << 7 | (~vvvv & 15) << 3 | 1 << 2 | 1);
+        emit(b, 2 << 5 | (~vvvv >> 4 & 1) << 3);
+    } else {
+        scale = 1;
+        emit(b, 0xc4);
+        emit(b, (~reg >> 3 & 1) << 7 | 1 << 6 | (~rm_reg >> 3 & 1) << 5 | map);
+        emit(b, w << 7 | (~vvvv & 15) << 3 | (b->vector_bytes == 32) << 2 | 1);
+    }
+    emit(b, opcode);
+
+    if (base < 0) {
+        emit(b, 3 << 6 | (reg & 7) << 3 | (rm & 7));
+        return;
+    }
+    disp8 = disp % scale == 0 && disp / scale >= -128 && disp / scale <= 127;
+    if (disp == 0) {
+        emit(b, (reg & 7) << 3 | base);
+    } else if (disp8) {
+        emit(b, 1 << 6 | (reg & 7) << 3 | base);
+        emit(b, disp / scale);
+    } else {
+        emit(b, 2 << 6 | (reg & 7) << 3 | base);
+        emit32(b, disp);
+    }
+}
+
+/* The instructions of the kernels */
+
+static void load(JitBuffer *b, int reg, int base, int disp) {
+    vector_op(b, MAP_0F, b->isa == JIT_AVX512, 0x10, reg, 0, 0, base, disp, b->vector_bytes);
+}
+
+static void store(JitBuffer *b, int reg, int base, int disp) {
+    vector_op(b, MAP_0F, b->isa == JIT_AVX512, 0x11, reg, 0, 0, base, disp, b->vector_bytes);
+}
+
+static void broadcast(JitBuffer *b, int reg, int base, int disp) {
+    vector_op(b, MAP_0F38, b->isa == JIT_AVX512, 0x19, reg, 0, 0, base, disp, 8);
+}
+
+/* acc += x * y */
+static void fmadd(JitBuffer *b, int acc, int x, int y) {
+    vector_op(b, MAP_0F38, 1, 0xb8, acc, x, y, -1, 0, 0);
+}
+
+static void zero(JitBuffer *b, int reg) {
+    // vpxorq with EVEX, as vxorpd on zmm needs AVX512DQ
+    if (b->isa == JIT_AVX512)
+        vector_op(b, MAP_0F, 1, 0xef, reg, reg, reg, -1, 0, 0);
+    else
+        vector_op(b, MAP_0F, 0, 0x57, reg, reg, reg, -1, 0, 0);
+}
+
+/* reg += [base + disp] */
+static void add_memory(JitBuffer *b, int reg, int base, int disp) {
+    vector_op(b, MAP_0F, b->isa == JIT_AVX512, 0x58, reg, reg, 0, base, disp, b->vector_bytes);
+}
+
+/* reg = max( reg, other ) */
+static void max_reg(JitBuffer *b, int reg, int other) {
+    vector_op(b, MAP_0F, b->isa == JIT_AVX512, 0x5f, reg, reg, other, -1, 0, 0);
+}
+
+/* add, sub or cmp of a 64-bit register (rdi, rsi, rdx) and an immediate */
+#define ALU_ADD 0
+#define ALU_SUB 5
+#define ALU_CMP 7
+
+static void alu_imm(JitBuffer *b, int op, int reg, int imm) {
+    emit(b, 0x48);
+    emit(b, 0x81);
+    emit(b, 3 << 6 | op << 3 | reg);
+    emit32(b, imm);
+}
+
+/* Conditions of jcc */
+#define JL  0x8c
+#define JGE 0x8d
+#define JLE 0x8e
+#define JG  0x8f
+
+/* Jump to target, or forward to be patched if target < 0
+   @return: offset of the displacement */
+static int jump(JitBuffer *b, int condition, int target) {
+    emit(b, 0x0f);
+    emit(b, condition);
+    emit32(b, target < 0 ? 0 : target - (b->size + 4));
+    return b->size - 4;
+}
+
+static void patch(JitBuffer *b, int at) {
+    int rel = b->size - (at + 4);
+
+    memcpy(&b->code[at], &rel, 4);
+}
+
+/**
+ * Steps of the k loop: accumulators acc( i,j ) += A( i,p ) * B( p,j )
+ * @param steps: steps of k, with rsi and rdx advanced past them after
+ */
+static void kernel_steps(JitBuffer *b, const JitConfig *cfg, int steps) {
+    int w = b->vector_bytes / 8, mv = cfg->mr / w;
+    int a_reg = mv * cfg->nr, b_reg = a_reg + mv;
+
+    for (int u = 0; u < steps; u++) {
+        for (int i = 0; i < mv; i++)
+            load(b, a_reg + i, RSI, (u * cfg->mr + i * w) * 8);
+        for (int j = 0; j < cfg->nr; j++) {
+            broadcast(b, b_reg, RDX, (u * cfg->nr + j) * 8);
+            for (int i = 0; i < mv; i++)
+                fmadd(b, i + j * mv, a_reg + i, b_reg);
+        }
+    }
+    alu_imm(b, ALU_ADD, RSI, steps * cfg->mr * 8);
+    alu_imm(b, ALU_ADD, RDX, steps * cfg->nr * 8);
+    alu_imm(b, ALU_SUB, RDI, steps);
+}
+
+static void generate(JitBuffer *b, const JitConfig *cfg) {
+    int w = b->vector_bytes / 8, mv = cfg->mr / w;
+    int b_reg = mv * cfg->nr + mv;
+    int loop, skip_main, skip_rest;
+
+    // ldc in bytes: shl r8, 3
+    emit(b, 0x49);
+    emit(b, 0xc1);
+    emit(b, 0xe0);
+    emit(b, 3);
+
+    for (int r = 0; r < mv * cfg->nr; r++)
+        zero(b, r);
+
+    // Unrolled loop while at least unroll steps are left
+    alu_imm(b, ALU_CMP, RDI, cfg->unroll);
+    skip_main = jump(b, JL, -1);
+    loop = b->size;
+    kernel_steps(b, cfg, cfg->unroll);
+    alu_imm(b, ALU_CMP, RDI, cfg->unroll);
+    jump(b, JGE, loop);
+    patch(b, skip_main);
+
+    // The steps left, one at a time
+    alu_imm(b, ALU_CMP, RDI, 0);
+    skip_rest = jump(b, JLE, -1);
+    loop = b->size;
+    kernel_steps(b, cfg, 1);
+    alu_imm(b, ALU_CMP, RDI, 0);
+    jump(b, JG, loop);
+    patch(b, skip_rest);
+
+    // C += acc, then the epilogue, a column at a time
+    if (cfg->epilogue == EPILOGUE_RELU)
+        zero(b, b_reg);
+    for (int j = 0; j < cfg->nr; j++) {
+        for (int i = 0; i < mv; i++) {
+            add_memory(b, i + j * mv, RCX, i * b->vector_bytes);
+            if (cfg->epilogue == EPILOGUE_RELU)
+                max_reg(b, i + j * mv, b_reg);
+            store(b, i + j * mv, RCX, i * b->vector_bytes);
+        }
+        // add rcx, r8
+        emit(b, 0x4c);
+        emit(b, 0x01);
+        emit(b, 0xc1);
+    }
+
+    // vzeroupper, ret
+    emit(b, 0xc5);
+    emit(b, 0xf8);
+    emit(b, 0x77);
+    emit(b, 0xc3);
+}
+#endif
+
+typedef struct {
+    JitConfig cfg;
+    JitKernel kernel;
+} JitEntry;
+
+static JitEntry cache[JIT_CACHE_SIZE];
+static int cache_count = 0;
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Best instruction set the generator has for the host
+ * @return: JIT_AVX512, JIT_AVX2 or JIT_NONE
+ */
+int jit_host_isa() {
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("avx512f"))
+        return JIT_AVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return JIT_AVX2;
+#endif
+    return JIT_NONE;
+}
+
+/**
+ * Kernel configuration for the host: the largest tile whose accumulators,
+ * vectors of A and broadcast of B fit the vector registers. With
+ * JIT_NONE the tile is 4x4, for a compiled kernel.
+ */
+JitConfig jit_host_config() {
+    JitConfig cfg = {4, 4, 4, jit_host_isa(), EPILOGUE_NONE};
+
+    if (cfg.isa == JIT_AVX512) {
+        cfg.mr = 16;                // 2 x 12 accumulators of 8
+        cfg.nr = 12;
+    } else if (cfg.isa == JIT_AVX2) {
+        cfg.mr = 8;                 // 2 x 6 accumulators of 4
+        cfg.nr = 6;
+    }
+    return cfg;
+}
+
+/**
+ * Kernel for a configuration, generated on the first call and cached
+ * @return: the kernel, or NULL if the host cannot run it or the tile does
+ *          not fit the registers
+ */
+JitKernel jit_kernel(const JitConfig *cfg) {
+    JitKernel kernel = NULL;
+
+    pthread_mutex_lock(&cache_lock);
+    for (int e = 0; e < cache_count; e++) {
+        if (memcmp(&cache[e].cfg, cfg, sizeof(JitConfig)) == 0) {
+            kernel = cache[e].kernel;
+            pthread_mutex_unlock(&cache_lock);
+            return kernel;
+        }
+    }
+
+#if defined(__x86_64__)
+    int vector_bytes = cfg->isa == JIT_AVX512 ? 64 : 32;
+    int registers = cfg->isa == JIT_AVX512 ? 32 : 16;
+    int mv = cfg->mr / (vector_bytes / 8);
+
+    if (cfg->isa != JIT_NONE && cfg->isa <= jit_host_isa() &&
+        cfg->mr > 0 && cfg->mr % (vector_bytes / 8) == 0 && cfg->nr > 0 && cfg->unroll > 0 &&
+        mv * cfg->nr + mv + 1 <= registers &&
+        (cfg->epilogue == EPILOGUE_NONE || cfg->epilogue == EPILOGUE_RELU)) {
+        JitBuffer b = {malloc(JIT_MAX_CODE), 0, cfg->isa, vector_bytes};
+        void *code;
+
+        if (b.code == NULL) {
+            fprintf(stderr, "Cannot allocate a JIT buffer\n");
+            exit(1);
+        }
+        generate(&b, cfg);
+
+        code = mmap(NULL, b.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (code == MAP_FAILED) {
+            perror("mmap");
+            exit(1);
+        }
+        memcpy(code, b.code, b.size);
+        if (mprotect(code, b.size, PROT_READ | PROT_EXEC)) {
+            perror("mprotect");
+            exit(1);
+        }
+        free(b.code);
+        kernel = (JitKernel) code;
+    }
+#endif
+
+    if (kernel) {
+        if (cache_count == JIT_CACHE_SIZE) {
+            fprintf(stderr, "More than %d JIT kernels\n", JIT_CACHE_SIZE);
+            exit(1);
+        }
+        cache[cache_count].cfg = *cfg;
+        cache[cache_count].kernel = kernel;
+        cache_count++;
+    }
+    pthread_mutex_unlock(&cache_lock);
+    return kernel;
+}
@@ -0,0 +1,28 @@
+/* Micro-kernels generated at run time for the host, see jit.c */
+
+/* Instruction sets the generator can emit */
+#define JIT_NONE   0                /* no generator: use a compiled kernel */
+#define JIT_AVX2   1                /* 256-bit vectors with FMA, 16 registers */
+#define JIT_AVX512 2                /* 512-bit vectors, 32 registers */
+
+/* Distinct kernels kept */
+#define JIT_CACHE_SIZE 32
+
+/* A kernel: register tile of mr x nr, k loop unrolled unroll times, and
+   epilogue EPILOGUE_NONE or EPILOGUE_RELU of epilogue.h */
+typedef struct {
+    int mr, nr;
+    int unroll;
+    int isa;
+    int epilogue;
+} JitConfig;
+
+/* C( 0:mr-1, 0:nr-1 ) += A * B, then the epilogue, for A packed as k
+   columns of mr rows and B packed as k rows of nr columns, like the
+   panels of PackMatrixA and PackMatrixB. C is column-major with leading
+   dimension ldc. */
+typedef void (*JitKernel)(long k, const double *a, const double *b, double *c, long ldc);
+
+int jit_host_isa();
+JitConfig jit_host_config();
+JitKernel jit_kernel(const JitConfig *cfg);
@@ -0,0 +1,63 @@
+/**
+ * Convert a text matrix (one row per line, whitespace separated) into
+ * the binary matrix format of matfile.h, or write a random matrix when
+ * no input is given.
+ *  usage: make_matfile.x out.mat rows cols [col|row|packa|packb] [input.txt]
+ * Operands saved with packa/packb can be timed without packing by
+ * passing them to compare_matrix_multi.x.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+#include "matfile.h"
+
+int main(int argc, char *argv[]) {
+    int rows, cols, layout = MATFILE_COL_MAJOR;
+    double *a;
+
+    if (argc < 4 || argc > 6) {
+        fprintf(stderr, "usage: %s out.mat rows cols [col|row|packa|packb] [input.txt]\n", argv[0]);
+        exit(1);
+    }
+    rows = atoi(argv[2]);
+    cols = atoi(argv[3]);
+    if (argc > 4) {
+        if (strcmp(argv[4], "row") == 0)
+            layout = MATFILE_ROW_MAJOR;
+        else if (strcmp(argv[4], "packa") == 0)
+            layout = MATFILE_PACKED_A;
+        else if (strcmp(argv[4], "packb") == 0)
+            layout = MATFILE_PACKED_B;
+        else if (strcmp(argv[4], "col") != 0) {
+            fprintf(stderr, "Unknown layout %s\n", argv[4]);
+            exit(1);
+        }
+    }
+
+    a = (double *) malloc((size_t) rows * cols * sizeof(double));
+    if (argc == 6) {
+        FILE *f = fopen(argv[5], "r");
+        if (f == NULL) {
+            perror(argv[5]);
+            exit(1);
+        }
+        for (int i = 0; i < rows; i++) {
+            for (int j = 0; j < cols; j++) {
+                if (fscanf(f, "%lf", &a[(size_t) j * rows + i]) != 1) {
+                    fprintf(stderr, "%s: expected %d x %d numbers\n", argv[5], rows, cols);
+                    exit(1);
+                }
+            }
+        }
+        fclose(f);
+    } else {
+        random_matrix(rows, cols, a, rows);
+    }
+
+    matfile_write(argv[1], rows, cols, layout, a, rows);
+
+    free(a);
+    exit(0);
+}
@@ -0,0 +1,244 @@
+/**
+ * Binary on-disk matrix format.
+ * A file is a MatFileHeader followed, at the next MATFILE_ALIGN boundary,
+ * by the elements. Because the data is page aligned it can be mapped
+ * straight into memory and handed to the engines without a copy.
+ *
+ * Besides plain column-major and row-major data, matrices can be stored
+ * already packed the way MMult_4x4_vecreg_subblock_cache.c packs them:
+ *  - MATFILE_PACKED_A: for every kc block p of columns, the rows are cut
+ *    into 4-row panels, each stored as A( i:i+3, p+q ) for q = 0..pb-1.
+ *    The panel starting at row i of block p begins at element p*m + i*pb.
+ *  - MATFILE_PACKED_B: for every kc block p of rows, the columns are cut
+ *    into 4-column panels, each stored as B( p+q, j:j+3 ) for q = 0..pb-1.
+ *    The panel starting at column j of block p begins at element p*n + j*pb.
+ * Here m and n are rounded up to a multiple of 4 and padding is zero.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <limits.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "matfile.h"
+
+#define A(i, j) a[ (j)*lda + (i) ]
+
+#define min( i, j ) ( (i)<(j) ? (i): (j) )
+#define round_up( i, r ) ( ( (i) + (r) - 1 ) / (r) * (r) )
+
+/**
+ * Fill in a header for a rows x cols matrix of doubles
+ * @param h: header to fill in
+ * @param rows: number of rows
+ * @param cols: number of columns
+ * @param layout: one of the MATFILE_* layouts
+ */
+void matfile_header(MatFileHeader *h, int rows, int cols, int layout) {
+    int64_t elements;
+
+    memset(h, 0, sizeof(MatFileHeader));
+    h->magic = MATFILE_MAGIC;
+    h->version = MATFILE_VERSION;
+    h->rows = rows;
+    h->cols = cols;
+    h->dtype = MATFILE_DOUBLE;
+    h->layout = layout;
+    h->panel = MATFILE_PANEL;
+    h->kc = MATFILE_KC;
+    h->data_offset = round_up((int64_t) sizeof(MatFileHeader), MATFILE_ALIGN);
+
+    if (layout == MATFILE_PACKED_A)
+        elements = (int64_t) round_up(rows, MATFILE_PANEL) * cols;
+    else if (layout == MATFILE_PACKED_B)
+        elements = (int64_t) rows * round_up(cols, MATFILE_PANEL);
+    else
+        elements = (int64_t) rows * cols;
+    h->data_size = elements * sizeof(double);
+}
+
+/**
+ * Copy a column-major m x k matrix into the MATFILE_PACKED_A layout
+ */
+static void pack_a(int m, int k, double *a, int lda, double *a_to) {
+    for (int p = 0; p < k; p += MATFILE_KC) {
+        int pb = min(k - p, MATFILE_KC);
+        for (int i = 0; i < m; i += MATFILE_PANEL) {
+            for (int q = 0; q < pb; q++) {
+                for (int r = 0; r < MATFILE_PANEL; r++) {
+                    *a_to++ = (i + r < m) ? A(i + r, p + q) : 0.0;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Copy a column-major k x n matrix into the MATFILE_PACKED_B layout
+ */
+static void pack_b(int k, int n, double *a, int lda, double *b_to) {
+    for (int p = 0; p < k; p += MATFILE_KC) {
+        int pb = min(k - p, MATFILE_KC);
+        for (int j = 0; j < n; j += MATFILE_PANEL) {
+            for (int q = 0; q < pb; q++) {
+                for (int c = 0; c < MATFILE_PANEL; c++) {
+                    *b_to++ = (j + c < n) ? A(p + q, j + c) : 0.0;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Map the data section of an open matrix file
+ * @param fd: file descriptor
+ * @param h: header of the file
+ * @param writable: map read-write and shared with the file
+ * @return: a newly allocated MatFile
+ */
+static MatFile *map_matfile(int fd, MatFileHeader *h, int writable) {
+    MatFile *mf = malloc(sizeof(MatFile));
+
+    mf->header = *h;
+    mf->map_size = h->data_size;
+    mf->map = mmap(NULL, mf->map_size, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                   MAP_SHARED, fd, h->data_offset);
+    if (mf->map == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+    mf->data = (double *) mf->map;
+    close(fd);
+    return mf;
+}
+
+/**
+ * Create a zero-filled matrix file and map it read-write
+ * @param path: file to create
+ * @param rows: number of rows
+ * @param cols: number of columns
+ * @param layout: one of the MATFILE_* layouts
+ * @return: a newly allocated MatFile
+ */
+MatFile *matfile_create(const char *path, int rows, int cols, int layout) {
+    MatFileHeader h;
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    if (fd < 0) {
+        perror(path);
+        exit(1);
+    }
+    matfile_header(&h, rows, cols, layout);
+    if (pwrite(fd, &h, sizeof(h), 0) != sizeof(h) || ftruncate(fd, h.data_offset + h.data_size)) {
+        perror(path);
+        exit(1);
+    }
+    return map_matfile(fd, &h, 1);
+}
+
+/**
+ * Open a matrix file and check its header against the file: the layout,
+ * the size of the data for the shape and layout, and that the file holds
+ * all of it
+ * @param path: file to open
+ * @param writable: open the file read-write
+ * @param h: filled in with the header of the file
+ * @return: the file descriptor
+ */
+int matfile_fd(const char *path, int writable, MatFileHeader *h) {
+    int fd = open(path, writable ? O_RDWR : O_RDONLY);
+    MatFileHeader expected;
+    struct stat st;
+
+    if (fd < 0 || pread(fd, h, sizeof(MatFileHeader), 0) != sizeof(MatFileHeader) || fstat(fd, &st)) {
+        perror(path);
+        exit(1);
+    }
+    if (h->magic != MATFILE_MAGIC || h->version != MATFILE_VERSION || h->dtype != MATFILE_DOUBLE
+        || h->data_offset % MATFILE_ALIGN != 0 || h->data_offset < (int64_t) sizeof(MatFileHeader)) {
+        fprintf(stderr, "%s: not a version %d matrix file of doubles\n", path, MATFILE_VERSION);
+        exit(1);
+    }
+    if (h->layout < MATFILE_COL_MAJOR || h->layout > MATFILE_PACKED_B) {
+        fprintf(stderr, "%s: not a matrix file, unknown layout %d\n", path, h->layout);
+        exit(1);
+    }
+    if (h->rows < 0 || h->rows > INT_MAX || h->cols < 0 || h->cols > INT_MAX) {
+        fprintf(stderr, "%s: not a matrix file, cannot hold %lld x %lld elements\n",
+                path, (long long) h->rows, (long long) h->cols);
+        exit(1);
+    }
+    if ((h->layout == MATFILE_PACKED_A || h->layout == MATFILE_PACKED_B)
+        && (h->panel != MATFILE_PANEL || h->kc != MATFILE_KC)) {
+        fprintf(stderr, "%s: packed with panel %d and kc %d, expected %d and %d\n",
+                path, h->panel, h->kc, MATFILE_PANEL, MATFILE_KC);
+        exit(1);
+    }
+    matfile_header(&expected, (int) h->rows, (int) h->cols, h->layout);
+    if (h->data_size != expected.data_size) {
+        fprintf(stderr, "%s: not a matrix file, %lld bytes of data for %lld x %lld, expected %lld\n",
+                path, (long long) h->data_size, (long long) h->rows, (long long) h->cols,
+                (long long) expected.data_size);
+        exit(1);
+    }
+    if (st.st_size < h->data_offset + h->data_size) {
+        fprintf(stderr, "%s: not a matrix file, %lld bytes long but its data ends at %lld\n",
+                path, (long long) st.st_size, (long long) (h->data_offset + h->data_size));
+        exit(1);
+    }
+    return fd;
+}
+
+/**
+ * Open a matrix file and map its data without copying it
+ * @param path: file to open
+ * @param writable: allow the data to be modified in place
+ * @return: a newly allocated MatFile
+ */
+MatFile *matfile_open(const char *path, int writable) {
+    MatFileHeader h;
+    int fd = matfile_fd(path, writable, &h);
+
+    return map_matfile(fd, &h, writable);
+}
+
+/**
+ * Unmap a matrix file and free the struct
+ * @param mf: matrix file
+ */
+void matfile_close(MatFile *mf) {
+    munmap(mf->map, mf->map_size);
+    free(mf);
+}
+
+/**
+ * Write a column-major matrix to a file in the given layout
+ * @param path: file to write
+ * @param rows: number of rows
+ * @param cols: number of columns
+ * @param layout: one of the MATFILE_* layouts
+ * @param a: column-major matrix
+ * @param lda: leading dimension of a
+ */
+void matfile_write(const char *path, int rows, int cols, int layout, double *a, int lda) {
+    MatFile *mf = matfile_create(path, rows, cols, layout);
+    double *to = mf->data;
+
+    if (layout == MATFILE_PACKED_A) {
+        pack_a(rows, cols, a, lda, to);
+    } else if (layout == MATFILE_PACKED_B) {
+        pack_b(rows, cols, a, lda, to);
+    } else if (layout == MATFILE_ROW_MAJOR) {
+        for (int i = 0; i < rows; i++)
+            for (int j = 0; j < cols; j++)
+                *to++ = A(i, j);
+    } else {
+        for (int j = 0; j < cols; j++)
+            for (int i = 0; i < rows; i++)
+                *to++ = A(i, j);
+    }
+    matfile_close(mf);
+}
@@ -0,0 +1,46 @@
+#include <stdint.h>
+
+#define MATFILE_MAGIC 0x4d435353    /* "SSCM" */
+#define MATFILE_VERSION 1
+#define MATFILE_ALIGN 4096          /* data starts on a page boundary */
+
+/* Element types */
+#define MATFILE_DOUBLE 1
+
+/* Data layouts */
+#define MATFILE_COL_MAJOR 0
+#define MATFILE_ROW_MAJOR 1
+#define MATFILE_PACKED_A  2         /* PackMatrixA panels, see matfile.c */
+#define MATFILE_PACKED_B  3         /* PackMatrixB panels, see matfile.c */
+
+/* Panel geometry of the packed layouts (matches MMult_4x4_vecreg_subblock_cache.c) */
+#define MATFILE_PANEL 4
+#define MATFILE_KC 128
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    int64_t rows;
+    int64_t cols;
+    int32_t dtype;
+    int32_t layout;
+    int32_t panel;                  /* rows (A) or columns (B) per packed panel */
+    int32_t kc;                     /* depth of a packed block */
+    int64_t data_offset;            /* byte offset of the data, MATFILE_ALIGN aligned */
+    int64_t data_size;              /* bytes of data */
+    uint8_t reserved[16];
+} MatFileHeader;
+
+typedef struct {
+    MatFileHeader header;
+    void *map;
+    size_t map_size;
+    double *data;                   /* points into the mapping, no copy is made */
+} MatFile;
+
+void matfile_header(MatFileHeader *h, int rows, int cols, int layout);
+void matfile_write(const char *path, int rows, int cols, int layout, double *a, int lda);
+MatFile *matfile_create(const char *path, int rows, int cols, int layout);
+int matfile_fd(const char *path, int writable, MatFileHeader *h);
+MatFile *matfile_open(const char *path, int writable);
+void matfile_close(MatFile *mf);
@@ -0,0 +1,123 @@
+/**
+ * Allocation accounting for the benchmark harness.
+ * The harness is linked with -Wl,--wrap for malloc, calloc, realloc,
+ * posix_memalign and free (MEMSTAT_LDFLAGS in the makefile), so every allocation made by
+ * the harness and by the engines linked into it goes through the wrappers
+ * below, which count it before calling the C library. Allocations made
+ * inside the C library itself are not counted.
+ * Sizes are the usable sizes reported by the allocator, so that a free
+ * takes off exactly what its allocation added. The counters are updated
+ * atomically, as the threaded engines allocate from several threads.
+ *
+ * The harness resets the counters before a call of MY_MMult and reads
+ * them after: bytes still live are a leak of the engine, provided it
+ * frees nothing it did not allocate during the call.
+ */
+#include <stdlib.h>
+#include <malloc.h>
+#include <sys/resource.h>
+
+#include "memstat.h"
+
+void *__real_malloc(size_t);
+void *__real_calloc(size_t, size_t);
+void *__real_realloc(void *, size_t);
+int __real_posix_memalign(void **, size_t, size_t);
+void __real_free(void *);
+
+static long allocs, frees, bytes, live, peak;
+
+static void count_alloc(void *p) {
+    long size = (long) malloc_usable_size(p);
+    long now = __atomic_add_fetch(&live, size, __ATOMIC_RELAXED);
+    long high = __atomic_load_n(&peak, __ATOMIC_RELAXED);
+
+    __atomic_add_fetch(&allocs, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&bytes, size, __ATOMIC_RELAXED);
+    while (now > high &&
+           !__atomic_compare_exchange_n(&peak, &high, now, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+static void count_free(void *p) {
+    __atomic_add_fetch(&frees, 1, __ATOMIC_RELAXED);
+    __atomic_sub_fetch(&live, (long) malloc_usable_size(p), __ATOMIC_RELAXED);
+}
+
+void *__wrap_malloc(size_t size) {
+    void *p = __real_malloc(size);
+
+    if (p)
+        count_alloc(p);
+    return p;
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    void *p = __real_calloc(count, size);
+
+    if (p)
+        count_alloc(p);
+    return p;
+}
+
+void *__wrap_realloc(void *old, size_t size) {
+    void *p;
+
+    if (old)
+        count_free(old);
+    p = __real_realloc(old, size);
+    if (p)
+        count_alloc(p);
+    else if (old && size)
+        count_alloc(old);           // the old block is still there
+    return p;
+}
+
+int __wrap_posix_memalign(void **p, size_t alignment, size_t size) {
+    int error = __real_posix_memalign(p, alignment, size);
+
+    if (error == 0)
+        count_alloc(*p);
+    return error;
+}
+
+void __wrap_free(void *p) {
+    if (p)
+        count_free(p);
+    __real_free(p);
+}
+
+/**
+ * Start counting from zero
+ */
+void memstat_reset() {
+    __atomic_store_n(&allocs, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&frees, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&bytes, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&live, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&peak, 0, __ATOMIC_RELAXED);
+}
+
+/**
+ * Counters since the last memstat_reset
+ */
+MemStat memstat_read() {
+    MemStat s = {
+            __atomic_load_n(&allocs, __ATOMIC_RELAXED),
+            __atomic_load_n(&frees, __ATOMIC_RELAXED),
+            __atomic_load_n(&bytes, __ATOMIC_RELAXED),
+            __atomic_load_n(&peak, __ATOMIC_RELAXED),
+            __atomic_load_n(&live, __ATOMIC_RELAXED),
+    };
+
+    return s;
+}
+
+/**
+ * Peak resident set size of the process, in kilobytes
+ */
+long memstat_max_rss() {
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
@@ -0,0 +1,13 @@
+/* Allocation accounting for the benchmark harness, see memstat.c */
+
+typedef struct {
+    long allocs;                    /* allocations made */
+    long frees;                     /* allocations freed */
+    long bytes;                     /* bytes allocated */
+    long peak;                      /* largest number of bytes live at once */
+    long live;                      /* bytes still allocated: leaked */
+} MemStat;
+
+void memstat_reset();
+MemStat memstat_read();
+long memstat_max_rss();
@@ -0,0 +1,216 @@
+/**
+ * Out-of-core matrix multiplication.
+ * The operands live in column-major matrix files (see matfile.h) and only a few
+ * disk tiles are resident at a time. The tile loops follow the mc x kc
+ * blocking of MMult_4x4_vecreg_subblock.c one level further out, and
+ * every resident tile product is handed to gemm, which picks an engine
+ * for its shape: the tiles at the edges of the matrices are rectangular
+ * and of any size.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "outofcore.h"
+#include "matfile.h"
+#include "gemm.h"
+
+/* Disk tile sizes (in elements), multiples of 4 for the 4x4 kernels */
+#define MC_DISK 2048
+#define NC_DISK 2048
+#define KC_DISK 2048
+
+#define min( i, j ) ( (i)<(j) ? (i): (j) )
+
+typedef struct {
+    double *a;
+    double *b;
+} TileBuffer;
+
+typedef struct {
+    int fd_a, fd_b;
+    off_t a_offset, b_offset;
+    int m, k;
+    int i, j, p;
+    int ib, jb, pb;
+    TileBuffer *buf;
+} TileRequest;
+
+/**
+ * Open a column-major matrix file and return its size
+ * @param path: path of the file
+ * @param writable: open the file read-write
+ * @param rows: set to the number of rows
+ * @param cols: set to the number of columns
+ * @param offset: set to the byte offset of the data
+ * @return: the file descriptor
+ */
+static int open_matrix(const char *path, int writable, int *rows, int *cols, off_t *offset) {
+    MatFileHeader h;
+    int fd = matfile_fd(path, writable, &h);
+
+    if (h.layout != MATFILE_COL_MAJOR) {
+        fprintf(stderr, "%s: out-of-core operands must be column-major\n", path);
+        exit(1);
+    }
+    *rows = h.rows;
+    *cols = h.cols;
+    *offset = h.data_offset;
+    return fd;
+}
+
+/**
+ * Read or write a rows x cols tile starting at (i, j) of a column-major
+ * matrix with leading dimension ld stored in fd. Each column of the tile
+ * is contiguous on disk, so this is one pread/pwrite per column, or a
+ * single one when the tile spans whole columns.
+ * @param fd: file descriptor of the matrix
+ * @param base: byte offset of the matrix data in the file
+ * @param ld: leading dimension of the matrix on disk
+ * @param i: first row of the tile
+ * @param j: first column of the tile
+ * @param rows: number of rows in the tile
+ * @param cols: number of columns in the tile
+ * @param buf: column-major tile buffer with leading dimension rows
+ * @param write: 0 to read the tile, 1 to write it back
+ */
+static void transfer_tile(int fd, off_t base, int ld, int i, int j, int rows, int cols,
+                          double *buf, int write) {
+    int chunks = (rows == ld) ? 1 : cols;
+    size_t chunk_bytes = (size_t) rows * sizeof(double) * (cols / chunks);
+
+    for (int q = 0; q < chunks; q++) {
+        char *pntr = (char *) (buf + (size_t) q * rows);
+        off_t offset = base + ((off_t) (j + q) * ld + i) * sizeof(double);
+        size_t done = 0;
+
+        while (done < chunk_bytes) {
+            ssize_t ret = write ? pwrite(fd, pntr + done, chunk_bytes - done, offset + done)
+                                : pread(fd, pntr + done, chunk_bytes - done, offset + done);
+            if (ret <= 0) {
+                perror(write ? "pwrite" : "pread");
+                exit(1);
+            }
+            done += ret;
+        }
+    }
+}
+
+/**
+ * Load the A and B tiles of one step into a tile buffer.
+ * Runs on the prefetch thread while the previous step is computed.
+ * @param r: tile request
+ * @return: NULL
+ */
+static void *load_tiles(void *r) {
+    TileRequest *req = (TileRequest *) r;
+
+    transfer_tile(req->fd_a, req->a_offset, req->m, req->i, req->p, req->ib, req->pb, req->buf->a, 0);
+    transfer_tile(req->fd_b, req->b_offset, req->k, req->p, req->j, req->pb, req->jb, req->buf->b, 0);
+    return NULL;
+}
+
+/**
+ * Fill in the request for step number s of the (j, i, p) tile loop
+ * @param req: request to fill in
+ * @param s: step number
+ * @param m, n, k: matrix sizes
+ */
+static void make_request(TileRequest *req, long s, int m, int n, int k) {
+    long p_steps = (k + KC_DISK - 1) / KC_DISK;
+    long i_steps = (m + MC_DISK - 1) / MC_DISK;
+
+    req->p = (int) (s % p_steps) * KC_DISK;
+    req->i = (int) ((s / p_steps) % i_steps) * MC_DISK;
+    req->j = (int) (s / (p_steps * i_steps)) * NC_DISK;
+    req->pb = min(k - req->p, KC_DISK);
+    req->ib = min(m - req->i, MC_DISK);
+    req->jb = min(n - req->j, NC_DISK);
+}
+
+/**
+ * Compute C = A * B + C where A (m x k), B (k x n) and C (m x n) are
+ * column-major matrix files. A C tile stays resident while
+ * all of its k steps are accumulated; the A and B tiles of the next step
+ * are read on a second thread into the other half of a double buffer.
+ * @param a_path: file holding A
+ * @param b_path: file holding B
+ * @param c_path: file holding C, updated in place
+ */
+void OOC_MMult(const char *a_path, const char *b_path, const char *c_path) {
+    int m, n, k, b_rows, c_rows, c_cols;
+    off_t a_offset, b_offset, c_offset;
+    int fd_a = open_matrix(a_path, 0, &m, &k, &a_offset);
+    int fd_b = open_matrix(b_path, 0, &b_rows, &n, &b_offset);
+    int fd_c = open_matrix(c_path, 1, &c_rows, &c_cols, &c_offset);
+
+    if (b_rows != k || c_rows != m || c_cols != n) {
+        fprintf(stderr, "Mismatched sizes: (%dx%d) * (%dx%d) into (%dx%d)\n",
+                m, k, b_rows, n, c_rows, c_cols);
+        exit(1);
+    }
+
+    TileBuffer buf[2];
+    for (int q = 0; q < 2; q++) {
+        buf[q].a = malloc((size_t) MC_DISK * KC_DISK * sizeof(double));
+        buf[q].b = malloc((size_t) KC_DISK * NC_DISK * sizeof(double));
+    }
+    double *c_tile = malloc((size_t) MC_DISK * NC_DISK * sizeof(double));
+
+    long steps = (long) ((m + MC_DISK - 1) / MC_DISK)
+                 * ((n + NC_DISK - 1) / NC_DISK)
+                 * ((k + KC_DISK - 1) / KC_DISK);
+    TileRequest req[2];
+    pthread_t prefetch;
+
+    req[0].fd_a = req[1].fd_a = fd_a;
+    req[0].fd_b = req[1].fd_b = fd_b;
+    req[0].a_offset = req[1].a_offset = a_offset;
+    req[0].b_offset = req[1].b_offset = b_offset;
+    req[0].m = req[1].m = m;
+    req[0].k = req[1].k = k;
+    req[0].buf = &buf[0];
+    req[1].buf = &buf[1];
+
+    make_request(&req[0], 0, m, n, k);
+    load_tiles(&req[0]);
+
+    for (long s = 0; s < steps; s++) {
+        TileRequest *cur = &req[s % 2];
+        TileRequest *next = &req[(s + 1) % 2];
+
+        // Start reading the next tiles before computing on the current ones
+        if (s + 1 < steps) {
+            make_request(next, s + 1, m, n, k);
+            if (pthread_create(&prefetch, NULL, load_tiles, next)) {
+                fprintf(stderr, "Error creating prefetch thread\n");
+                exit(1);
+            }
+        }
+
+        if (cur->p == 0)
+            transfer_tile(fd_c, c_offset, m, cur->i, cur->j, cur->ib, cur->jb, c_tile, 0);
+
+        gemm(cur->ib, cur->jb, cur->pb, cur->buf->a, cur->ib,
+                 cur->buf->b, cur->pb, c_tile, cur->ib);
+
+        if (cur->p + cur->pb == k)
+            transfer_tile(fd_c, c_offset, m, cur->i, cur->j, cur->ib, cur->jb, c_tile, 1);
+
+        if (s + 1 < steps && pthread_join(prefetch, NULL)) {
+            fprintf(stderr, "Error joining prefetch thread\n");
+            exit(2);
+        }
+    }
+
+    for (int q = 0; q < 2; q++) {
+        free(buf[q].a);
+        free(buf[q].b);
+    }
+    free(c_tile);
+    close(fd_a);
+    close(fd_b);
+    close(fd_c);
+}
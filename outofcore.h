@@ -0,0 +1 @@
+void OOC_MMult(const char *, const char *, const char *);
@@ -0,0 +1,145 @@
+/**
+ * Kernels for narrow products, C += A * B with n <= SKINNY_MAX_N, and the
+ * matrix-vector product y += A * x.
+ * With so few columns every element of A is used at most n times, so the
+ * time goes into reading A and the 4x4 blocking of AddDot4x4 and the
+ * packing of InnerKernel only add traffic. These kernels read A where it
+ * is, once, four columns at a time: for every pair of rows of C the four
+ * columns of A are loaded as vectors and multiplied into each column of
+ * C, as in AddDot1x4 turned on its side. C is walked in blocks of
+ * SKINNY_MB rows, which stay in the cache while the columns of A stream
+ * past, and the blocks are shared out between threads.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <pmmintrin.h>  // SSE3
+
+#include "skinny.h"
+
+#define A(i, j) a[ (j)*lda + (i) ]
+#define B(i, j) b[ (j)*ldb + (i) ]
+#define C(i, j) c[ (j)*ldc + (i) ]
+
+#define min( i, j ) ( (i)<(j) ? (i): (j) )
+
+typedef struct {
+    int m, n, k;
+    double *a, *b, *c;
+    int lda, ldb, ldc;
+} SkinnyTask;
+
+/**
+ * C += A * B for rows row_start..row_end-1 of A and C
+ */
+static void skinny_rows(SkinnyTask *t, int row_start, int row_end) {
+    int n = t->n, k = t->k, lda = t->lda, ldb = t->ldb, ldc = t->ldc;
+    double *a = t->a, *b = t->b, *c = t->c;
+    __m128d b_p[4][SKINNY_MAX_N];
+
+    for (int p = 0; p < k; p += 4) {
+        int kb = min(k - p, 4);
+
+        /* B( p..p+3, j ), each duplicated into a vector; zeros past k */
+        for (int q = 0; q < 4; q++)
+            for (int j = 0; j < n; j++)
+                b_p[q][j] = q < kb ? _mm_loaddup_pd(&B(p + q, j)) : _mm_setzero_pd();
+
+        int i = row_start;
+        for (; i + 1 < row_end; i += 2) {
+            __m128d a_0 = _mm_loadu_pd(&A(i, p));
+            __m128d a_1 = kb > 1 ? _mm_loadu_pd(&A(i, p + 1)) : _mm_setzero_pd();
+            __m128d a_2 = kb > 2 ? _mm_loadu_pd(&A(i, p + 2)) : _mm_setzero_pd();
+            __m128d a_3 = kb > 3 ? _mm_loadu_pd(&A(i, p + 3)) : _mm_setzero_pd();
+
+            for (int j = 0; j < n; j++) {
+                __m128d c_ij = _mm_loadu_pd(&C(i, j));
+
+                c_ij += a_0 * b_p[0][j] + a_1 * b_p[1][j] + a_2 * b_p[2][j] + a_3 * b_p[3][j];
+                _mm_storeu_pd(&C(i, j), c_ij);
+            }
+        }
+        /* The last row when there is an odd number */
+        for (; i < row_end; i++)
+            for (int j = 0; j < n; j++)
+                for (int q = 0; q < kb; q++)
+                    C(i, j) += A(i, p + q) * B(p + q, j);
+    }
+}
+
+typedef struct {
+    SkinnyTask *task;
+    int id, threads;
+} SkinnyThread;
+
+/**
+ * Thread function: every threads-th block of SKINNY_MB rows, from block id
+ * @param arg: SkinnyThread
+ * @return: NULL
+ */
+static void *skinny_blocks(void *arg) {
+    SkinnyThread *t = (SkinnyThread *) arg;
+    int m = t->task->m;
+
+    for (int i = t->id * SKINNY_MB; i < m; i += t->threads * SKINNY_MB)
+        skinny_rows(t->task, i, min(m, i + SKINNY_MB));
+    return NULL;
+}
+
+/**
+ * C += A * B for an n of at most SKINNY_MAX_N, column-major like MY_MMult
+ * @param threads: number of threads to use
+ */
+void Skinny_MMult(int m, int n, int k, double *a, int lda,
+                  double *b, int ldb,
+                  double *c, int ldc, int threads) {
+    SkinnyTask task = {m, n, k, a, b, c, lda, ldb, ldc};
+    int blocks = (m + SKINNY_MB - 1) / SKINNY_MB;
+
+    if (n > SKINNY_MAX_N) {
+        fprintf(stderr, "Skinny_MMult takes at most %d columns, not %d\n", SKINNY_MAX_N, n);
+        exit(1);
+    }
+
+    if ((long) m * k < SKINNY_PARALLEL_MIN)
+        threads = 1;
+    threads = min(threads, blocks);
+    if (threads <= 1) {
+        for (int i = 0; i < m; i += SKINNY_MB)
+            skinny_rows(&task, i, min(m, i + SKINNY_MB));
+        return;
+    }
+
+    pthread_t thread[threads];
+    SkinnyThread args[threads];
+
+    for (int t = 0; t < threads; t++) {
+        args[t].task = &task;
+        args[t].id = t;
+        args[t].threads = threads;
+        if (t > 0 && pthread_create(&thread[t], NULL, skinny_blocks, &args[t])) {
+            fprintf(stderr, "Error creating thread %d\n", t);
+            exit(1);
+        }
+    }
+    skinny_blocks(&args[0]);
+    for (int t = 1; t < threads; t++) {
+        if (pthread_join(thread[t], NULL)) {
+            fprintf(stderr, "Error joining thread %d\n", t);
+            exit(2);
+        }
+    }
+}
+
+/**
+ * y += A * x
+ * @param m, k: size of A
+ * @param a: column-major A
+ * @param lda: leading dimension of a
+ * @param x: k elements
+ * @param y: m elements
+ * @param threads: number of threads to use
+ */
+void Skinny_GEMV(int m, int k, double *a, int lda, double *x, double *y, int threads) {
+    Skinny_MMult(m, 1, k, a, lda, x, k, y, m, threads);
+}
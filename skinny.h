@@ -0,0 +1,11 @@
+/* C += A * B for B and C with few columns, and y += A * x */
+
+/* Widest B the narrow kernel takes */
+#define SKINNY_MAX_N 8
+/* Rows of C kept in the cache while A streams past */
+#define SKINNY_MB 512
+/* Products with fewer elements of A than this run on one thread */
+#define SKINNY_PARALLEL_MIN (256 * 1024)
+
+void Skinny_MMult(int, int, int, double *, int, double *, int, double *, int, int);
+void Skinny_GEMV(int, int, double *, int, double *, double *, int);
@@ -0,0 +1,311 @@
+/**
+ * Sparse x dense multiplication, C += A * B with A sparse and B, C dense
+ * column-major.
+ *
+ * A can be stored as CSR (compressed rows of single elements) or as BSR
+ * (compressed rows of 4x4 blocks). A BSR block is stored like a 4 x 4
+ * panel of PackMatrixA, so the BSR kernel is AddDot4x4 with the 4x4 block
+ * of C kept in registers across all the blocks of a block row.
+ *
+ * Sparse_MMult takes a dense A, measures its density and picks the dense
+ * engine that is linked in (MY_MMult), BSR or CSR.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "sparse.h"
+
+#define A(i, j) a[ (j)*lda + (i) ]
+#define B(i, j) b[ (j)*ldb + (i) ]
+#define C(i, j) c[ (j)*ldc + (i) ]
+
+#define min( i, j ) ( (i)<(j) ? (i): (j) )
+
+void MY_MMult(int, int, int, double *, int, double *, int, double *, int);
+
+/**
+ * Count the nonzeros of a dense matrix
+ * @return: number of nonzero elements
+ */
+static long count_nonzeros(int m, int k, double *a, int lda) {
+    long nnz = 0;
+
+    for (int j = 0; j < k; j++)
+        for (int i = 0; i < m; i++)
+            nnz += (A(i, j) != 0.0);
+    return nnz;
+}
+
+/**
+ * Allocate an array or exit
+ */
+static void *sparse_alloc(size_t size) {
+    void *p;
+
+    if (posix_memalign(&p, 16, size ? size : 1)) {
+        fprintf(stderr, "Cannot allocate %zu bytes for a sparse matrix\n", size);
+        exit(1);
+    }
+    return p;
+}
+
+/**
+ * Convert a dense column-major matrix to CSR
+ * @param m: number of rows
+ * @param k: number of columns
+ * @param a: dense matrix
+ * @param lda: leading dimension of a
+ * @return: newly allocated CSR matrix
+ */
+CSRMatrix *csr_from_dense(int m, int k, double *a, int lda) {
+    CSRMatrix *s = malloc(sizeof(CSRMatrix));
+    int q = 0;
+
+    s->rows = m;
+    s->cols = k;
+    s->nnz = count_nonzeros(m, k, a, lda);
+    s->row_ptr = sparse_alloc((m + 1) * sizeof(int));
+    s->col_idx = sparse_alloc(s->nnz * sizeof(int));
+    s->val = sparse_alloc(s->nnz * sizeof(double));
+
+    for (int i = 0; i < m; i++) {
+        s->row_ptr[i] = q;
+        for (int j = 0; j < k; j++) {
+            if (A(i, j) != 0.0) {
+                s->col_idx[q] = j;
+                s->val[q++] = A(i, j);
+            }
+        }
+    }
+    s->row_ptr[m] = q;
+    return s;
+}
+
+/**
+ * Convert a dense column-major matrix to BSR with BSR_BLOCK x BSR_BLOCK
+ * blocks. Blocks on the bottom and right edges are padded with zeros.
+ * @param m: number of rows
+ * @param k: number of columns
+ * @param a: dense matrix
+ * @param lda: leading dimension of a
+ * @return: newly allocated BSR matrix
+ */
+BSRMatrix *bsr_from_dense(int m, int k, double *a, int lda) {
+    BSRMatrix *s = malloc(sizeof(BSRMatrix));
+    int mb = (m + BSR_BLOCK - 1) / BSR_BLOCK, kb = (k + BSR_BLOCK - 1) / BSR_BLOCK;
+    int q = 0;
+
+    s->rows = m;
+    s->cols = k;
+    s->row_ptr = sparse_alloc((mb + 1) * sizeof(int));
+
+    /* First pass: find the nonzero blocks */
+    s->nnzb = 0;
+    for (int bi = 0; bi < mb; bi++) {
+        s->row_ptr[bi] = s->nnzb;
+        for (int bj = 0; bj < kb; bj++) {
+            int rows = min(m - bi * BSR_BLOCK, BSR_BLOCK), cols = min(k - bj * BSR_BLOCK, BSR_BLOCK);
+            s->nnzb += count_nonzeros(rows, cols, &A(bi * BSR_BLOCK, bj * BSR_BLOCK), lda) > 0;
+        }
+    }
+    s->row_ptr[mb] = s->nnzb;
+
+    /* Second pass: copy them */
+    s->col_idx = sparse_alloc(s->nnzb * sizeof(int));
+    s->val = sparse_alloc((size_t) s->nnzb * BSR_BLOCK * BSR_BLOCK * sizeof(double));
+    for (int bi = 0; bi < mb; bi++) {
+        for (int bj = 0; bj < kb; bj++) {
+            int rows = min(m - bi * BSR_BLOCK, BSR_BLOCK), cols = min(k - bj * BSR_BLOCK, BSR_BLOCK);
+            double *block = &A(bi * BSR_BLOCK, bj * BSR_BLOCK);
+
+            if (count_nonzeros(rows, cols, block, lda) == 0)
+                continue;
+            s->col_idx[q] = bj;
+            for (int j = 0; j < BSR_BLOCK; j++)
+                for (int i = 0; i < BSR_BLOCK; i++)
+                    s->val[(q * BSR_BLOCK + j) * BSR_BLOCK + i] =
+                            (i < rows && j < cols) ? block[j * lda + i] : 0.0;
+            q++;
+        }
+    }
+    return s;
+}
+
+void free_csr(CSRMatrix *s) {
+    free(s->row_ptr);
+    free(s->col_idx);
+    free(s->val);
+    free(s);
+}
+
+void free_bsr(BSRMatrix *s) {
+    free(s->row_ptr);
+    free(s->col_idx);
+    free(s->val);
+    free(s);
+}
+
+/**
+ * C += A * B with A in CSR. Four columns of C are computed at a time, so
+ * every value of A that is loaded is used four times.
+ * @param a: sparse m x k matrix
+ * @param n: number of columns of B and C
+ * @param b: dense k x n matrix
+ * @param ldb: leading dimension of b
+ * @param c: dense m x n matrix
+ * @param ldc: leading dimension of c
+ */
+void CSR_MMult(CSRMatrix *a, int n, double *b, int ldb, double *c, int ldc) {
+    int j = 0;
+
+    for (; j + 4 <= n; j += 4) {
+        double *b0 = &B(0, j), *b1 = &B(0, j + 1), *b2 = &B(0, j + 2), *b3 = &B(0, j + 3);
+
+        for (int i = 0; i < a->rows; i++) {
+            double c0 = 0.0, c1 = 0.0, c2 = 0.0, c3 = 0.0;
+
+            for (int q = a->row_ptr[i]; q < a->row_ptr[i + 1]; q++) {
+                double v = a->val[q];
+                int p = a->col_idx[q];
+
+                c0 += v * b0[p];
+                c1 += v * b1[p];
+                c2 += v * b2[p];
+                c3 += v * b3[p];
+            }
+            C(i, j) += c0;
+            C(i, j + 1) += c1;
+            C(i, j + 2) += c2;
+            C(i, j + 3) += c3;
+        }
+    }
+
+    for (; j < n; j++) {
+        for (int i = 0; i < a->rows; i++) {
+            double c0 = 0.0;
+
+            for (int q = a->row_ptr[i]; q < a->row_ptr[i + 1]; q++)
+                c0 += a->val[q] * B(a->col_idx[q], j);
+            C(i, j) += c0;
+        }
+    }
+}
+
+#include <pmmintrin.h>  // SSE3
+
+typedef union
+{
+    __m128d v;
+    double d[2];
+} v2df_t;
+
+/**
+ * C += A * B with A in BSR. For every block row of A and every 4 columns
+ * of B the 4x4 block of C stays in registers while the blocks of the row
+ * are multiplied in, as in AddDot4x4.
+ * @param a: sparse m x k matrix
+ * @param n: number of columns of B and C
+ * @param b: dense k x n matrix
+ * @param ldb: leading dimension of b
+ * @param c: dense m x n matrix
+ * @param ldc: leading dimension of c
+ */
+void BSR_MMult(BSRMatrix *a, int n, double *b, int ldb, double *c, int ldc) {
+    int mb = (a->rows + BSR_BLOCK - 1) / BSR_BLOCK;
+
+    for (int j = 0; j < n; j += 4) {
+        int nr = min(n - j, 4);
+        /* Columns past the edge of B repeat the first one and are not written back */
+        double *b0 = &B(0, j), *b1 = &B(0, j + min(1, nr - 1)),
+               *b2 = &B(0, j + min(2, nr - 1)), *b3 = &B(0, j + min(3, nr - 1));
+
+        for (int bi = 0; bi < mb; bi++) {
+            int mr = min(a->rows - bi * BSR_BLOCK, BSR_BLOCK);
+            double *cb = &C(bi * BSR_BLOCK, j);
+            v2df_t
+                c_00_c_10_vreg, c_01_c_11_vreg, c_02_c_12_vreg, c_03_c_13_vreg,
+                c_20_c_30_vreg, c_21_c_31_vreg, c_22_c_32_vreg, c_23_c_33_vreg,
+                a_0p_a_1p_vreg, a_2p_a_3p_vreg,
+                b_p0_vreg, b_p1_vreg, b_p2_vreg, b_p3_vreg;
+
+            c_00_c_10_vreg.v = _mm_setzero_pd();
+            c_01_c_11_vreg.v = _mm_setzero_pd();
+            c_02_c_12_vreg.v = _mm_setzero_pd();
+            c_03_c_13_vreg.v = _mm_setzero_pd();
+            c_20_c_30_vreg.v = _mm_setzero_pd();
+            c_21_c_31_vreg.v = _mm_setzero_pd();
+            c_22_c_32_vreg.v = _mm_setzero_pd();
+            c_23_c_33_vreg.v = _mm_setzero_pd();
+
+            for (int q = a->row_ptr[bi]; q < a->row_ptr[bi + 1]; q++) {
+                int p0 = a->col_idx[q] * BSR_BLOCK;
+                int kb = min(a->cols - p0, BSR_BLOCK);
+                double *val = &a->val[q * BSR_BLOCK * BSR_BLOCK];
+
+                for (int p = p0; p < p0 + kb; p++) {
+                    a_0p_a_1p_vreg.v = _mm_load_pd(val);
+                    a_2p_a_3p_vreg.v = _mm_load_pd(val + 2);
+                    val += 4;
+
+                    b_p0_vreg.v = _mm_loaddup_pd(&b0[p]);   /* load and duplicate */
+                    b_p1_vreg.v = _mm_loaddup_pd(&b1[p]);
+                    b_p2_vreg.v = _mm_loaddup_pd(&b2[p]);
+                    b_p3_vreg.v = _mm_loaddup_pd(&b3[p]);
+
+                    c_00_c_10_vreg.v += a_0p_a_1p_vreg.v * b_p0_vreg.v;
+                    c_01_c_11_vreg.v += a_0p_a_1p_vreg.v * b_p1_vreg.v;
+                    c_02_c_12_vreg.v += a_0p_a_1p_vreg.v * b_p2_vreg.v;
+                    c_03_c_13_vreg.v += a_0p_a_1p_vreg.v * b_p3_vreg.v;
+
+                    c_20_c_30_vreg.v += a_2p_a_3p_vreg.v * b_p0_vreg.v;
+                    c_21_c_31_vreg.v += a_2p_a_3p_vreg.v * b_p1_vreg.v;
+                    c_22_c_32_vreg.v += a_2p_a_3p_vreg.v * b_p2_vreg.v;
+                    c_23_c_33_vreg.v += a_2p_a_3p_vreg.v * b_p3_vreg.v;
+                }
+            }
+
+            for (int i = 0; i < mr; i++) {
+                v2df_t *c_0 = (i < 2 ? &c_00_c_10_vreg : &c_20_c_30_vreg);
+                v2df_t *c_1 = (i < 2 ? &c_01_c_11_vreg : &c_21_c_31_vreg);
+                v2df_t *c_2 = (i < 2 ? &c_02_c_12_vreg : &c_22_c_32_vreg);
+                v2df_t *c_3 = (i < 2 ? &c_03_c_13_vreg : &c_23_c_33_vreg);
+
+                cb[i] += c_0->d[i % 2];
+                if (nr > 1) cb[ldc + i] += c_1->d[i % 2];
+                if (nr > 2) cb[2 * ldc + i] += c_2->d[i % 2];
+                if (nr > 3) cb[3 * ldc + i] += c_3->d[i % 2];
+            }
+        }
+    }
+}
+
+/**
+ * C += A * B for a dense A that may be mostly zeros. Uses the dense
+ * engine when more than SPARSE_MAX_DENSITY of A is nonzero, otherwise
+ * BSR when the nonzero 4x4 blocks are at least BSR_MIN_FILL full and CSR
+ * when they are not.
+ */
+void Sparse_MMult(int m, int n, int k, double *a, int lda,
+                  double *b, int ldb,
+                  double *c, int ldc) {
+    long nnz = count_nonzeros(m, k, a, lda);
+    BSRMatrix *bsr;
+    CSRMatrix *csr;
+
+    if (nnz > SPARSE_MAX_DENSITY * m * k) {
+        MY_MMult(m, n, k, a, lda, b, ldb, c, ldc);
+        return;
+    }
+
+    bsr = bsr_from_dense(m, k, a, lda);
+    if (nnz >= BSR_MIN_FILL * bsr->nnzb * BSR_BLOCK * BSR_BLOCK) {
+        BSR_MMult(bsr, n, b, ldb, c, ldc);
+        free_bsr(bsr);
+        return;
+    }
+    free_bsr(bsr);
+
+    csr = csr_from_dense(m, k, a, lda);
+    CSR_MMult(csr, n, b, ldb, c, ldc);
+    free_csr(csr);
+}
@@ -0,0 +1,33 @@
+/* Sparse A operands for C += A * B with dense column-major B and C */
+
+#define BSR_BLOCK 4                 /* BSR blocks are BSR_BLOCK x BSR_BLOCK */
+
+/* Above this fraction of nonzeros Sparse_MMult uses the dense engine */
+#define SPARSE_MAX_DENSITY 0.25
+/* Below this fraction of nonzeros inside the nonzero blocks it uses CSR */
+#define BSR_MIN_FILL 0.5
+
+typedef struct {
+    int rows, cols;
+    int nnz;
+    int *row_ptr;                   /* rows + 1 offsets into col_idx and val */
+    int *col_idx;
+    double *val;
+} CSRMatrix;
+
+typedef struct {
+    int rows, cols;                 /* in elements */
+    int nnzb;                       /* number of stored blocks */
+    int *row_ptr;                   /* block rows + 1 offsets into col_idx */
+    int *col_idx;                   /* block column of every stored block */
+    double *val;                    /* 16 values per block, column-major */
+} BSRMatrix;
+
+CSRMatrix *csr_from_dense(int, int, double *, int);
+BSRMatrix *bsr_from_dense(int, int, double *, int);
+void free_csr(CSRMatrix *);
+void free_bsr(BSRMatrix *);
+
+void CSR_MMult(CSRMatrix *, int, double *, int, double *, int);
+void BSR_MMult(BSRMatrix *, int, double *, int, double *, int);
+void Sparse_MMult(int, int, int, double *, int, double *, int, double *, int);
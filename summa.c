@@ -0,0 +1,179 @@
+/**
+ * SUMMA (Scalable Universal Matrix Multiplication Algorithm) on a pr x pc
+ * grid of processes.
+ * Rank r = I * pc + J owns block (I, J) of every operand when
+ * A is cut into pr x pc blocks of (m / pr) x (k / pc),
+ * B into pr x pc blocks of (k / pr) x (n / pc) and
+ * C into pr x pc blocks of (m / pr) x (n / pc).
+ * The k dimension is walked in panels of at most SUMMA_NB: the process
+ * column that owns the next columns of A broadcasts them along each
+ * process row, the process row that owns the next rows of B broadcasts
+ * them down each process column, and every rank adds the product of the
+ * two panels into its block of C with gemm, which takes the rectangular
+ * mb x w by w x nb panel products of any grid.
+ *
+ * The messages go through a Transport (see transport.h), so the same
+ * code runs on forked processes over shared memory or sockets and on MPI
+ * ranks.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "summa.h"
+#include "gemm.h"
+#include "utils.h"
+
+#define min( i, j ) ( (i)<(j) ? (i): (j) )
+
+/**
+ * Exit with a message unless the grid has pr * pc ranks and cuts the
+ * operands into whole blocks
+ */
+static void check_grid(Transport *t, int pr, int pc, int m, int n, int k) {
+    if (t->size != pr * pc || m % pr || n % pc || k % pr || k % pc) {
+        fprintf(stderr, "Cannot multiply %dx%d by %dx%d on a %dx%d grid of %d ranks\n",
+                m, k, k, n, pr, pc, t->size);
+        exit(1);
+    }
+}
+
+/**
+ * Run SUMMA on the blocks held by this rank
+ * @param t: transport, with pr * pc ranks
+ * @param pr: rows of the process grid
+ * @param pc: columns of the process grid
+ * @param m, n, k: sizes of the whole matrices
+ * @param a: block of A of this rank, column-major with leading dimension m / pr
+ * @param b: block of B of this rank, column-major with leading dimension k / pr
+ * @param c: block of C of this rank, column-major with leading dimension m / pr
+ */
+void SUMMA_local(Transport *t, int pr, int pc, int m, int n, int k,
+                 double *a, double *b, double *c) {
+    int I = t->rank / pc, J = t->rank % pc;
+    int mb = m / pr, nb = n / pc, ka = k / pc, kb = k / pr;
+    int row_group[pc], col_group[pr];
+    double *a_panel = malloc((size_t) mb * SUMMA_NB * sizeof(double));
+    double *b_panel = malloc((size_t) SUMMA_NB * nb * sizeof(double));
+    int w;
+
+    check_grid(t, pr, pc, m, n, k);
+    for (int q = 0; q < pc; q++)
+        row_group[q] = I * pc + q;
+    for (int q = 0; q < pr; q++)
+        col_group[q] = q * pc + J;
+
+    for (int kk = 0; kk < k; kk += w) {
+        /* Owners of the panel, and where it starts in their blocks */
+        int ja = kk / ka, oa = kk % ka;
+        int ib = kk / kb, ob = kk % kb;
+        double *a_p;
+
+        /* The panel must not cross a block boundary of A or of B */
+        w = min(SUMMA_NB, min(ka - oa, kb - ob));
+
+        /* Columns of A are contiguous in the owner's block */
+        a_p = (J == ja) ? &a[(size_t) oa * mb] : a_panel;
+        transport_bcast(t, row_group, pc, I * pc + ja, a_p, (size_t) mb * w * sizeof(double));
+
+        if (I == ib)
+            copy_matrix(w, nb, &b[ob], kb, b_panel, w);
+        transport_bcast(t, col_group, pr, ib * pc + J, b_panel, (size_t) w * nb * sizeof(double));
+
+        gemm(mb, nb, w, a_p, mb, b_panel, w, c, mb);
+    }
+
+    free(a_panel);
+    free(b_panel);
+}
+
+/**
+ * Send block (I, J) of an rows x cols matrix to every rank, or receive
+ * this rank's block, through a contiguous buffer
+ * @param local: this rank's block, leading dimension rows / gr
+ * @param gr, gc: the matrix is cut into gr x gc blocks
+ */
+static void scatter_blocks(Transport *t, int gr, int gc, int rows, int cols,
+                           double *a, int lda, double *local) {
+    int br = rows / gr, bc = cols / gc;
+    size_t bytes = (size_t) br * bc * sizeof(double);
+
+    if (t->rank != 0) {
+        t->recv(t, 0, local, bytes);
+        return;
+    }
+    for (int r = t->size - 1; r >= 0; r--) {
+        copy_matrix(br, bc, &a[(size_t) (r % gc) * bc * lda + (r / gc) * br], lda, local, br);
+        if (r != 0)
+            t->send(t, r, local, bytes);
+    }
+}
+
+/**
+ * Collect the blocks of C on rank 0
+ */
+static void gather_blocks(Transport *t, int gr, int gc, int rows, int cols,
+                          double *c, int ldc, double *local) {
+    int br = rows / gr, bc = cols / gc;
+    size_t bytes = (size_t) br * bc * sizeof(double);
+    double *buf;
+
+    if (t->rank != 0) {
+        t->send(t, 0, local, bytes);
+        return;
+    }
+    buf = malloc(bytes);
+    for (int r = 0; r < t->size; r++) {
+        if (r != 0)
+            t->recv(t, r, buf, bytes);
+        copy_matrix(br, bc, r == 0 ? local : buf, br, &c[(size_t) (r % gc) * bc * ldc + (r / gc) * br], ldc);
+    }
+    free(buf);
+}
+
+/**
+ * C += A * B with the whole matrices on rank 0: scatter the blocks, run
+ * SUMMA and gather C back on rank 0. Every rank of the transport calls
+ * this, the matrix arguments are only used on rank 0.
+ * @param t: transport, with pr * pc ranks
+ * @param pr, pc: process grid
+ * @param m, n, k: sizes; m and n must be multiples of pr and pc, k of both
+ */
+void SUMMA_MMult_transport(Transport *t, int pr, int pc, int m, int n, int k,
+                           double *a, int lda, double *b, int ldb, double *c, int ldc) {
+    double *a_local, *b_local, *c_local;
+
+    check_grid(t, pr, pc, m, n, k);
+
+    a_local = malloc((size_t) (m / pr) * (k / pc) * sizeof(double));
+    b_local = malloc((size_t) (k / pr) * (n / pc) * sizeof(double));
+    c_local = malloc((size_t) (m / pr) * (n / pc) * sizeof(double));
+
+    scatter_blocks(t, pr, pc, m, k, a, lda, a_local);
+    scatter_blocks(t, pr, pc, k, n, b, ldb, b_local);
+    scatter_blocks(t, pr, pc, m, n, c, ldc, c_local);
+
+    SUMMA_local(t, pr, pc, m, n, k, a_local, b_local, c_local);
+
+    gather_blocks(t, pr, pc, m, n, c, ldc, c_local);
+
+    free(a_local);
+    free(b_local);
+    free(c_local);
+}
+
+/**
+ * C += A * B on pr x pc processes forked on this machine
+ * @param kind: TRANSPORT_SHM or TRANSPORT_SOCKET
+ */
+void SUMMA_MMult(int m, int n, int k, double *a, int lda,
+                 double *b, int ldb,
+                 double *c, int ldc, int pr, int pc, int kind) {
+    Transport *t = transport_fork(kind, pr * pc);
+    int rank = t->rank;
+
+    SUMMA_MMult_transport(t, pr, pc, m, n, k, a, lda, b, ldb, c, ldc);
+    transport_close(t);
+    if (rank != 0)
+        _exit(0);
+}
@@ -0,0 +1,11 @@
+/* Distributed C += A * B with SUMMA on a pr x pc grid of processes */
+
+#include "transport.h"
+
+/* Width of the panels broadcast at every step, a multiple of 4 */
+#define SUMMA_NB 256
+
+void SUMMA_local(Transport *, int, int, int, int, int, double *, double *, double *);
+void SUMMA_MMult_transport(Transport *, int, int, int, int, int,
+                           double *, int, double *, int, double *, int);
+void SUMMA_MMult(int, int, int, double *, int, double *, int, double *, int, int, int, int);
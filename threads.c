@@ -0,0 +1,111 @@
+/**
+ * Global budget of compute threads.
+ * Every threaded call takes its threads from one budget, sized to the
+ * number of processors (or THREADS_ENV), before it starts them: a call
+ * that finds the budget spent runs on its own thread alone, so that many
+ * callers at once share the processors instead of each starting a full
+ * set of threads.
+ * The calling thread counts, so a call always gets at least one thread,
+ * even from an empty budget, and the budget may go below zero until it
+ * returns it. A call made while the thread already holds threads, from
+ * an engine calling another, gets the same threads rather than new ones.
+ */
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "threads.h"
+
+#define min( i, j ) ( (i)<(j) ? (i): (j) )
+
+static pthread_mutex_t budget_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t budget_once = PTHREAD_ONCE_INIT;
+static int budget_max, available;
+
+/* Calls of this thread under way, and threads taken by the outermost */
+static __thread int depth, held;
+
+static void budget_init() {
+    char *env = getenv(THREADS_ENV);
+    int threads = env ? atoi(env) : (int) sysconf(_SC_NPROCESSORS_ONLN);
+
+    budget_max = available = threads > 0 ? threads : 1;
+}
+
+/**
+ * Take up to want threads, the calling one included, for a call
+ * @param want: threads the call would use
+ * @return: threads granted, at least 1; release them with threads_release
+ */
+int threads_acquire(int want) {
+    pthread_once(&budget_once, budget_init);
+    if (depth++ > 0)
+        return held;
+
+    pthread_mutex_lock(&budget_lock);
+    held = min(want, available);
+    if (held < 1)
+        held = 1;
+    available -= held;
+    pthread_mutex_unlock(&budget_lock);
+    return held;
+}
+
+/**
+ * Threads held by the calling thread
+ * @return: the threads granted to its outermost call, 0 outside of one
+ */
+int threads_held() {
+    return depth > 0 ? held : 0;
+}
+
+/**
+ * Give back what the outermost call holds beyond keep threads, once it
+ * knows it cannot use them
+ */
+void threads_trim(int keep) {
+    if (depth != 1 || held <= keep || keep < 1)
+        return;
+
+    pthread_mutex_lock(&budget_lock);
+    available += held - keep;
+    pthread_mutex_unlock(&budget_lock);
+    held = keep;
+}
+
+/**
+ * End a call started with threads_acquire; the outermost gives back its
+ * threads
+ */
+void threads_release() {
+    if (--depth > 0)
+        return;
+
+    pthread_mutex_lock(&budget_lock);
+    available += held;
+    pthread_mutex_unlock(&budget_lock);
+    held = 0;
+}
+
+/**
+ * Resize the budget; threads held now are counted against the new size
+ * @param threads: compute threads for all callers together
+ */
+void threads_set_max(int threads) {
+    pthread_once(&budget_once, budget_init);
+    if (threads < 1)
+        threads = 1;
+
+    pthread_mutex_lock(&budget_lock);
+    available += threads - budget_max;
+    budget_max = threads;
+    pthread_mutex_unlock(&budget_lock);
+}
+
+/**
+ * Size of the budget
+ */
+int threads_max() {
+    pthread_once(&budget_once, budget_init);
+    return budget_max;
+}
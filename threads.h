@@ -0,0 +1,12 @@
+/* Budget of compute threads shared by every caller in the process */
+
+/* Size of the budget, if set in the environment; else the number of
+   processors */
+#define THREADS_ENV "CACHEMULTI_THREADS"
+
+int threads_acquire(int);
+int threads_held();
+void threads_trim(int);
+void threads_release();
+void threads_set_max(int);
+int threads_max();
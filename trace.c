@@ -0,0 +1,154 @@
+/**
+ * Execution tracing, for seeing where the time of a multiply goes: which
+ * of the Strassen products straggled, how long the splits and merges of
+ * each level took, and how the blocked engine alternates packing and
+ * kernels.
+ * Instrumented code wraps a span in TRACE_BEGIN and TRACE_END (trace.h).
+ * Each thread records its spans in a ring buffer of its own, so that
+ * recording takes no lock; the buffer of a thread that exits is handed to
+ * the next thread that starts, which shows on the same row of the trace.
+ * At exit all the buffers are written as Chrome trace JSON to TRACE_FILE,
+ * to open in chrome://tracing or https://ui.perfetto.dev:
+ *     make TRACE=1 all && TRACE_FILE=strassen.json ./compare_matrix_multi.x
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "trace.h"
+
+typedef struct {
+    const char *name;
+    const char *arg_name;
+    int arg;
+    double start, end;              /* microseconds */
+} TraceEvent;
+
+typedef struct TraceBuffer {
+    TraceEvent events[TRACE_EVENTS];
+    long count;                     /* events recorded, the ring holds the last ones */
+    int tid;
+    int in_use;
+    struct TraceBuffer *next;
+} TraceBuffer;
+
+static TraceBuffer *buffers = NULL;
+static int buffer_count = 0;
+static pthread_mutex_t buffers_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t buffer_key;
+static pthread_once_t trace_once = PTHREAD_ONCE_INIT;
+static __thread TraceBuffer *buffer = NULL;
+
+/**
+ * Microseconds on the monotonic clock
+ */
+double trace_now() {
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1.0e6 + t.tv_nsec * 1.0e-3;
+}
+
+/**
+ * Key destructor: a thread that exits gives its buffer back
+ * @param b: TraceBuffer of the thread
+ */
+static void release_buffer(void *b) {
+    pthread_mutex_lock(&buffers_lock);
+    ((TraceBuffer *) b)->in_use = 0;
+    pthread_mutex_unlock(&buffers_lock);
+}
+
+static void dump_at_exit() {
+    char *path = getenv("TRACE_FILE");
+
+    trace_dump(path ? path : TRACE_FILE);
+}
+
+static void trace_init() {
+    pthread_key_create(&buffer_key, release_buffer);
+    atexit(dump_at_exit);
+}
+
+/**
+ * Buffer for the calling thread: one given back by a thread that exited,
+ * or a new one
+ */
+static TraceBuffer *acquire_buffer() {
+    TraceBuffer *b;
+
+    pthread_once(&trace_once, trace_init);
+    pthread_mutex_lock(&buffers_lock);
+    for (b = buffers; b != NULL && b->in_use; b = b->next);
+    if (b == NULL) {
+        b = malloc(sizeof(TraceBuffer));
+        if (b == NULL) {
+            fprintf(stderr, "Cannot allocate a trace buffer\n");
+            exit(1);
+        }
+        b->count = 0;
+        b->tid = ++buffer_count;
+        b->next = buffers;
+        buffers = b;
+    }
+    b->in_use = 1;
+    pthread_mutex_unlock(&buffers_lock);
+    pthread_setspecific(buffer_key, b);
+    return b;
+}
+
+/**
+ * Record a span of the calling thread, ending now
+ * @param name: name of the span, a string that outlives the trace
+ * @param arg_name: name of the argument, or NULL for none
+ * @param arg: value of the argument
+ * @param start: trace_now() at the start of the span
+ */
+void trace_event(const char *name, const char *arg_name, int arg, double start) {
+    if (buffer == NULL)
+        buffer = acquire_buffer();
+
+    TraceEvent *e = &buffer->events[buffer->count++ % TRACE_EVENTS];
+    e->name = name;
+    e->arg_name = arg_name;
+    e->arg = arg;
+    e->start = start;
+    e->end = trace_now();
+}
+
+/**
+ * Write every recorded span as Chrome trace JSON. Threads that are still
+ * recording may lose their last spans.
+ * @param path: file to write
+ */
+void trace_dump(const char *path) {
+    FILE *f = fopen(path, "w");
+    int first = 1;
+
+    if (f == NULL) {
+        perror(path);
+        return;
+    }
+    fprintf(f, "{\"traceEvents\":[\n");
+    pthread_mutex_lock(&buffers_lock);
+    for (TraceBuffer *b = buffers; b != NULL; b = b->next) {
+        long oldest = b->count > TRACE_EVENTS ? b->count - TRACE_EVENTS : 0;
+
+        fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                   "\"args\":{\"name\":\"thread %d\"}}", first ? "" : ",\n", b->tid, b->tid);
+        first = 0;
+        for (long i = oldest; i < b->count; i++) {
+            TraceEvent *e = &b->events[i % TRACE_EVENTS];
+
+            fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                    e->name, b->tid, e->start, e->end - e->start);
+            if (e->arg_name)
+                fprintf(f, ",\"args\":{\"%s\":%d}", e->arg_name, e->arg);
+            fprintf(f, "}");
+        }
+    }
+    pthread_mutex_unlock(&buffers_lock);
+    fprintf(f, "\n]}\n");
+    fclose(f);
+}
@@ -0,0 +1,22 @@
+/* Execution tracing of the engines, written as Chrome trace JSON, see trace.c */
+
+/* Events kept per thread; older ones are overwritten */
+#define TRACE_EVENTS (64 * 1024)
+
+/* Trace written at exit, unless TRACE_FILE names another */
+#define TRACE_FILE "trace.json"
+
+/* TRACE_BEGIN(t) starts timing a span in a new variable t, and
+   TRACE_END(t, name, arg_name, arg) records it with one integer argument.
+   Both compile to nothing without -DWITH_TRACE (make TRACE=1). */
+#ifdef WITH_TRACE
+#define TRACE_BEGIN(t) double t = trace_now()
+#define TRACE_END(t, name, arg_name, arg) trace_event(name, arg_name, arg, t)
+#else
+#define TRACE_BEGIN(t)
+#define TRACE_END(t, name, arg_name, arg)
+#endif
+
+double trace_now();
+void trace_event(const char *name, const char *arg_name, int arg, double start);
+void trace_dump(const char *path);
@@ -0,0 +1,337 @@
+/**
+ * Transports for the distributed engines.
+ * Every transport gives each pair of ranks a blocking, in-order byte
+ * stream in both directions, which is all SUMMA needs:
+ *  - TRANSPORT_SHM: a POSIX shared memory object holds a ring buffer for
+ *    every ordered pair of ranks, guarded by a process-shared mutex.
+ *  - TRANSPORT_SOCKET: a Unix domain socket pair for every pair of ranks.
+ *  - TRANSPORT_MPI: MPI_Send / MPI_Recv on MPI_COMM_WORLD.
+ * The shared memory and socket transports are set up for processes on
+ * one machine by transport_fork; MPI ranks are started by mpirun and can
+ * run across nodes.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#ifdef WITH_MPI
+#include <mpi.h>
+#endif
+
+#include "transport.h"
+
+#define CHANNEL_BYTES (256 * 1024)
+
+#define min( i, j ) ( (i)<(j) ? (i): (j) )
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    size_t head, tail;              /* bytes written and read so far */
+    char data[CHANNEL_BYTES];
+} Channel;
+
+typedef struct {
+    Channel *channels;              /* size x size, channels[src * size + dest] */
+    size_t map_size;
+    int *fd;                        /* socket to every other rank */
+    pid_t *children;                /* rank 0 only */
+} ForkState;
+
+static void shm_send(Transport *t, int dest, const void *buf, size_t bytes) {
+    ForkState *s = t->state;
+    Channel *ch = &s->channels[t->rank * t->size + dest];
+    const char *p = buf;
+
+    pthread_mutex_lock(&ch->lock);
+    while (bytes > 0) {
+        size_t n;
+
+        while (ch->head - ch->tail == CHANNEL_BYTES)
+            pthread_cond_wait(&ch->changed, &ch->lock);
+        /* Up to the free space and the end of the ring */
+        n = min(bytes, CHANNEL_BYTES - (ch->head - ch->tail));
+        n = min(n, CHANNEL_BYTES - ch->head % CHANNEL_BYTES);
+        memcpy(&ch->data[ch->head % CHANNEL_BYTES], p, n);
+        ch->head += n;
+        p += n;
+        bytes -= n;
+        pthread_cond_broadcast(&ch->changed);
+    }
+    pthread_mutex_unlock(&ch->lock);
+}
+
+static void shm_recv(Transport *t, int src, void *buf, size_t bytes) {
+    ForkState *s = t->state;
+    Channel *ch = &s->channels[src * t->size + t->rank];
+    char *p = buf;
+
+    pthread_mutex_lock(&ch->lock);
+    while (bytes > 0) {
+        size_t n;
+
+        while (ch->head == ch->tail)
+            pthread_cond_wait(&ch->changed, &ch->lock);
+        n = min(bytes, ch->head - ch->tail);
+        n = min(n, CHANNEL_BYTES - ch->tail % CHANNEL_BYTES);
+        memcpy(p, &ch->data[ch->tail % CHANNEL_BYTES], n);
+        ch->tail += n;
+        p += n;
+        bytes -= n;
+        pthread_cond_broadcast(&ch->changed);
+    }
+    pthread_mutex_unlock(&ch->lock);
+}
+
+static void socket_send(Transport *t, int dest, const void *buf, size_t bytes) {
+    ForkState *s = t->state;
+    const char *p = buf;
+
+    while (bytes > 0) {
+        ssize_t n = write(s->fd[dest], p, bytes);
+
+        if (n <= 0) {
+            perror("write");
+            exit(1);
+        }
+        p += n;
+        bytes -= n;
+    }
+}
+
+static void socket_recv(Transport *t, int src, void *buf, size_t bytes) {
+    ForkState *s = t->state;
+    char *p = buf;
+
+    while (bytes > 0) {
+        ssize_t n = read(s->fd[src], p, bytes);
+
+        if (n <= 0) {
+            perror("read");
+            exit(1);
+        }
+        p += n;
+        bytes -= n;
+    }
+}
+
+/**
+ * Create the shared memory channels of size ranks
+ */
+static void create_channels(ForkState *s, int size) {
+    char name[64];
+    pthread_mutexattr_t mattr;
+    pthread_condattr_t cattr;
+    int fd;
+
+    snprintf(name, sizeof(name), "/sscm_transport_%d", (int) getpid());
+    s->map_size = (size_t) size * size * sizeof(Channel);
+
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0 || ftruncate(fd, s->map_size)) {
+        perror(name);
+        exit(1);
+    }
+    s->channels = mmap(NULL, s->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (s->channels == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+    /* The mapping stays valid in every forked rank */
+    close(fd);
+    shm_unlink(name);
+
+    pthread_mutexattr_init(&mattr);
+    pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_SHARED);
+    pthread_condattr_init(&cattr);
+    pthread_condattr_setpshared(&cattr, PTHREAD_PROCESS_SHARED);
+    for (int q = 0; q < size * size; q++) {
+        pthread_mutex_init(&s->channels[q].lock, &mattr);
+        pthread_cond_init(&s->channels[q].changed, &cattr);
+        s->channels[q].head = s->channels[q].tail = 0;
+    }
+    pthread_mutexattr_destroy(&mattr);
+    pthread_condattr_destroy(&cattr);
+}
+
+/**
+ * Start size ranks on this machine by forking the calling process.
+ * The call returns in every rank: in the caller as rank 0 and in size - 1
+ * new processes as the other ranks, which should _exit once
+ * transport_close has been called.
+ * @param kind: TRANSPORT_SHM or TRANSPORT_SOCKET
+ * @param size: number of ranks
+ * @return: the transport of the rank
+ */
+Transport *transport_fork(int kind, int size) {
+    Transport *t = malloc(sizeof(Transport));
+    ForkState *s = calloc(1, sizeof(ForkState));
+    int (*pairs)[2] = NULL;
+
+    t->kind = kind;
+    t->size = size;
+    t->rank = 0;
+    t->state = s;
+
+    if (kind == TRANSPORT_SHM) {
+        create_channels(s, size);
+        t->send = shm_send;
+        t->recv = shm_recv;
+    } else if (kind == TRANSPORT_SOCKET) {
+        /* pairs[i * size + j] connects i < j, end 0 belongs to i */
+        pairs = malloc((size_t) size * size * sizeof(*pairs));
+        for (int i = 0; i < size; i++) {
+            for (int j = i + 1; j < size; j++) {
+                if (socketpair(AF_UNIX, SOCK_STREAM, 0, pairs[i * size + j])) {
+                    perror("socketpair");
+                    exit(1);
+                }
+            }
+        }
+        t->send = socket_send;
+        t->recv = socket_recv;
+    } else {
+        fprintf(stderr, "Transport %d cannot be forked\n", kind);
+        exit(1);
+    }
+
+    fflush(stdout);
+    s->children = malloc(size * sizeof(pid_t));
+    for (int r = 1; r < size; r++) {
+        pid_t pid = fork();
+
+        if (pid < 0) {
+            perror("fork");
+            exit(1);
+        }
+        if (pid == 0) {
+            t->rank = r;
+            break;
+        }
+        s->children[r] = pid;
+    }
+    if (t->rank != 0) {
+        free(s->children);
+        s->children = NULL;
+    }
+
+    if (kind == TRANSPORT_SOCKET) {
+        /* Keep our end of every pair we are in and close the rest */
+        s->fd = malloc(size * sizeof(int));
+        for (int i = 0; i < size; i++) {
+            for (int j = i + 1; j < size; j++) {
+                if (i == t->rank)
+                    s->fd[j] = pairs[i * size + j][0];
+                else
+                    close(pairs[i * size + j][0]);
+                if (j == t->rank)
+                    s->fd[i] = pairs[i * size + j][1];
+                else
+                    close(pairs[i * size + j][1]);
+            }
+        }
+        free(pairs);
+    }
+    return t;
+}
+
+#ifdef WITH_MPI
+/* MPI counts are ints, so large messages go in pieces */
+#define MPI_CHUNK ((size_t) 1 << 30)
+
+static void mpi_send(Transport *t, int dest, const void *buf, size_t bytes) {
+    for (size_t done = 0; done < bytes; done += MPI_CHUNK)
+        MPI_Send((const char *) buf + done, (int) min(bytes - done, MPI_CHUNK), MPI_BYTE,
+                 dest, 0, MPI_COMM_WORLD);
+}
+
+static void mpi_recv(Transport *t, int src, void *buf, size_t bytes) {
+    for (size_t done = 0; done < bytes; done += MPI_CHUNK)
+        MPI_Recv((char *) buf + done, (int) min(bytes - done, MPI_CHUNK), MPI_BYTE,
+                 src, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+}
+
+/**
+ * Transport over MPI_COMM_WORLD. MPI_Init must have been called.
+ * @return: the transport of this rank
+ */
+Transport *transport_mpi() {
+    Transport *t = malloc(sizeof(Transport));
+
+    t->kind = TRANSPORT_MPI;
+    MPI_Comm_rank(MPI_COMM_WORLD, &t->rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &t->size);
+    t->send = mpi_send;
+    t->recv = mpi_recv;
+    t->state = NULL;
+    return t;
+}
+#endif
+
+/**
+ * Broadcast a buffer from root to the other ranks of a group. Every rank
+ * of the group calls this with the same arguments.
+ * @param t: transport
+ * @param group: ranks in the group
+ * @param count: number of ranks in the group
+ * @param root: rank that holds the data
+ * @param buf: data at the root, received data elsewhere
+ * @param bytes: size of the data
+ */
+void transport_bcast(Transport *t, int *group, int count, int root, void *buf, size_t bytes) {
+    if (t->rank == root) {
+        for (int q = 0; q < count; q++)
+            if (group[q] != root)
+                t->send(t, group[q], buf, bytes);
+    } else {
+        t->recv(t, root, buf, bytes);
+    }
+}
+
+/**
+ * Wait until every rank has reached the barrier
+ */
+void transport_barrier(Transport *t) {
+    char token = 0;
+
+    if (t->rank == 0) {
+        for (int r = 1; r < t->size; r++)
+            t->recv(t, r, &token, 1);
+        for (int r = 1; r < t->size; r++)
+            t->send(t, r, &token, 1);
+    } else {
+        t->send(t, 0, &token, 1);
+        t->recv(t, 0, &token, 1);
+    }
+}
+
+/**
+ * Release a transport. On rank 0 of a forked transport this waits for
+ * the other ranks to exit.
+ */
+void transport_close(Transport *t) {
+    ForkState *s = t->state;
+
+    if (s) {
+        if (s->children) {
+            for (int r = 1; r < t->size; r++)
+                waitpid(s->children[r], NULL, 0);
+            free(s->children);
+        }
+        if (s->channels)
+            munmap(s->channels, s->map_size);
+        if (s->fd) {
+            for (int r = 0; r < t->size; r++)
+                if (r != t->rank)
+                    close(s->fd[r]);
+            free(s->fd);
+        }
+        free(s);
+    }
+    free(t);
+}
@@ -0,0 +1,27 @@
+/* Point-to-point messages between the processes of a distributed engine */
+
+#include <stddef.h>
+
+/* Transports */
+#define TRANSPORT_SHM    0          /* POSIX shared memory ring buffers */
+#define TRANSPORT_SOCKET 1          /* Unix domain sockets */
+#define TRANSPORT_MPI    2          /* MPI_COMM_WORLD, built with -DWITH_MPI */
+
+typedef struct Transport Transport;
+
+struct Transport {
+    int kind;
+    int rank, size;
+    /* Blocking, in-order byte streams between every pair of ranks */
+    void (*send)(Transport *, int, const void *, size_t);
+    void (*recv)(Transport *, int, void *, size_t);
+    void *state;
+};
+
+Transport *transport_fork(int, int);
+#ifdef WITH_MPI
+Transport *transport_mpi();
+#endif
+void transport_bcast(Transport *, int *, int, int, void *, size_t);
+void transport_barrier(Transport *);
+void transport_close(Transport *);
@@ -1,6 +1,9 @@
 #include <sys/time.h>
 #include <time.h>
 #include <stdlib.h>
+#include <math.h>
+
+#include "utils.h"
 
 #define A(i,j) a[ (j)*lda + (i) ]
 #define B(i,j) b[ (j)*ldb + (i) ]
@@ -15,6 +18,46 @@ void copy_matrix( int m, int n, double *a, int lda, double *b, int ldb )
       B( i,j ) = A( i,j );
 }
 
+void copy_matrix_float( int m, int n, float *a, int lda, float *b, int ldb )
+{
+  int i, j;
+
+  for ( j=0; j<n; j++ )
+    for ( i=0; i<m; i++ )
+      B( i,j ) = A( i,j );
+}
+
+void copy_matrix_to_float( int m, int n, double *a, int lda, float *b, int ldb )
+{
+  int i, j;
+
+  for ( j=0; j<n; j++ )
+    for ( i=0; i<m; i++ )
+      B( i,j ) = (float) A( i,j );
+}
+
+void copy_matrix_from_float( int m, int n, float *a, int lda, double *b, int ldb )
+{
+  int i, j;
+
+  for ( j=0; j<n; j++ )
+    for ( i=0; i<m; i++ )
+      B( i,j ) = (double) A( i,j );
+}
+
+void copy_matrix_to_bf16( int m, int n, double *a, int lda, unsigned short *b, int ldb )
+{
+  /* bfloat16 keeps the upper half of a float, rounded to nearest even */
+  int i, j;
+  union { float f; unsigned int u; } x;
+
+  for ( j=0; j<n; j++ )
+    for ( i=0; i<m; i++ ){
+      x.f = (float) A( i,j );
+      B( i,j ) = (unsigned short) ( ( x.u + 0x7fff + ( ( x.u >> 16 ) & 1 ) ) >> 16 );
+    }
+}
+
 double compare_matrices( int m, int n, double *a, int lda, double *b, int ldb )
 {
   int i, j;
@@ -22,7 +65,7 @@ double compare_matrices( int m, int n, double *a, int lda, double *b, int ldb )
 
   for ( j=0; j<n; j++ )
     for ( i=0; i<m; i++ ){
-      diff = abs( A( i,j ) - B( i,j ) );
+      diff = fabs( A( i,j ) - B( i,j ) );
       max_diff = ( diff > max_diff ? diff : max_diff );
     }
 
@@ -39,6 +82,36 @@ void random_matrix( int m, int n, double *a, int lda )
       A( i,j ) = 2.0 * drand48( ) - 1.0;
 }
 
+double *alloc_matrix( int m, int n, int *ld )
+{
+  /* Space for an m x n column-major matrix, aligned to a cache line, with
+     its leading dimension set to PADDED_LD( m ). Free it with free() */
+  double *a;
+
+  *ld = PADDED_LD( m );
+  if ( posix_memalign( (void **) &a, LD_LINE * sizeof( double ),
+                       (size_t) *ld * ( n > 0 ? n : 1 ) * sizeof( double ) ) )
+    abort();
+  return a;
+}
+
+void random_sparse_matrix( int m, int n, double *a, int lda, double density, int block )
+{
+  /* Random matrix in which each block x block tile (each element when
+     block is 1) is kept with probability density and zero otherwise */
+  double drand48();
+  int i, j, ii, jj;
+
+  random_matrix( m, n, a, lda );
+
+  for ( j=0; j<n; j+=block )
+    for ( i=0; i<m; i+=block )
+      if ( drand48( ) >= density )
+        for ( jj=j; jj<j+block && jj<n; jj++ )
+          for ( ii=i; ii<i+block && ii<m; ii++ )
+            A( ii,jj ) = 0.0;
+}
+
 /* Routine for computing C = A * B + C */
 
 void REF_MMult( int m, int n, int k, double *a, int lda,
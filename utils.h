@@ -1,5 +1,20 @@
+/* Leading dimension for columns of n doubles that keeps them off the same
+   cache sets: n rounded up to a cache line, plus one more line when the
+   stride would be a multiple of LD_ALIAS_BYTES, as power-of-two sizes are */
+#define LD_LINE 8
+#define LD_ALIAS_BYTES 2048
+#define PADDED_LD( n ) \
+  ( ( ( (n)+LD_LINE-1 ) & ~( LD_LINE-1 ) ) + \
+    ( ( ( (n)+LD_LINE-1 ) & ~( LD_LINE-1 ) ) % ( LD_ALIAS_BYTES/8 ) == 0 ? LD_LINE : 0 ) )
+
 void REF_MMult(int, int, int, double *, int, double *, int, double *, int );
 void copy_matrix(int, int, double *, int, double *, int );
+void copy_matrix_float(int, int, float *, int, float *, int );
+void copy_matrix_to_float(int, int, double *, int, float *, int );
+void copy_matrix_from_float(int, int, float *, int, double *, int );
+void copy_matrix_to_bf16(int, int, double *, int, unsigned short *, int );
 void random_matrix(int, int, double *, int);
+void random_sparse_matrix(int, int, double *, int, double, int);
 double compare_matrices( int, int, double *, int, double *, int );
+double *alloc_matrix(int, int, int * );
 double dclock();
\ No newline at end of file